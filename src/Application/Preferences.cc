@@ -1,3 +1,5 @@
+#include <iostream>
+
 // qt
 #include <QThread>
 
@@ -126,10 +128,117 @@ void Preferences::set_child_scale( double scale )
   this->settings.setValue( "ChildScale", scale );
 }
 
+//-----------------------------------------------------------------------------
+int Preferences::get_mesh_threads()
+{
+  return this->settings.value( "Meshing/Threads", QThread::idealThreadCount() ).toInt();
+}
+
+//-----------------------------------------------------------------------------
+void Preferences::set_mesh_threads( int threads )
+{
+  this->settings.setValue( "Meshing/Threads", threads );
+}
+
+//-----------------------------------------------------------------------------
+int Preferences::get_meshes_in_flight()
+{
+  return this->settings.value( "Meshing/InFlight", 64 ).toInt();
+}
+
+//-----------------------------------------------------------------------------
+void Preferences::set_meshes_in_flight( int count )
+{
+  this->settings.setValue( "Meshing/InFlight", count );
+}
+
+//-----------------------------------------------------------------------------
+double Preferences::get_mesh_tolerance()
+{
+  return this->settings.value( "Meshing/Tolerance", 0.01 ).toDouble();
+}
+
+//-----------------------------------------------------------------------------
+void Preferences::set_mesh_tolerance( double tolerance )
+{
+  this->settings.setValue( "Meshing/Tolerance", tolerance );
+  emit preferences_changed();
+}
+
+//-----------------------------------------------------------------------------
+int Preferences::get_triangle_budget()
+{
+  return this->settings.value( "Meshing/TriangleBudget", 0 ).toInt();
+}
+
+//-----------------------------------------------------------------------------
+void Preferences::set_triangle_budget( int triangles )
+{
+  this->settings.setValue( "Meshing/TriangleBudget", triangles );
+  emit preferences_changed();
+}
+
+//-----------------------------------------------------------------------------
+bool Preferences::get_union_surface()
+{
+  return this->settings.value( "Meshing/UnionSurface", false ).toBool();
+}
+
+//-----------------------------------------------------------------------------
+void Preferences::set_union_surface( bool enabled )
+{
+  this->settings.setValue( "Meshing/UnionSurface", enabled );
+  emit preferences_changed();
+}
+
+//-----------------------------------------------------------------------------
+double Preferences::get_union_voxel_size()
+{
+  return this->settings.value( "Meshing/VoxelSize", 0.0 ).toDouble();
+}
+
+//-----------------------------------------------------------------------------
+void Preferences::set_union_voxel_size( double voxel_size )
+{
+  this->settings.setValue( "Meshing/VoxelSize", voxel_size );
+  emit preferences_changed();
+}
+
+//-----------------------------------------------------------------------------
+int Preferences::get_union_extraction()
+{
+  int extraction = this->settings.value( "Meshing/UnionExtraction", 0 ).toInt();
+
+#ifndef VIKING_USE_CGAL
+  // the skin surface, saved by a build with USE_CGAL
+  if ( extraction == 2 )
+  {
+    std::cerr << "The skin surface union extraction needs USE_CGAL, using marching cubes\n";
+    extraction = 0;
+  }
+#endif
+
+  return extraction;
+}
+
+//-----------------------------------------------------------------------------
+void Preferences::set_union_extraction( int extraction )
+{
+  this->settings.setValue( "Meshing/UnionExtraction", extraction );
+  emit preferences_changed();
+}
+
 //-----------------------------------------------------------------------------
 void Preferences::restore_defaults()
 {
   this->set_connectome_list( this->default_connectome_nicknames_, this->default_connectomes_ );
   this->set_last_connectome( 0 );
   this->set_child_scale( 1.0 );
+  this->set_mesh_threads( QThread::idealThreadCount() );
+  this->set_meshes_in_flight( 64 );
+  this->set_mesh_tolerance( 0.01 );
+  this->set_triangle_budget( 0 );
+  this->set_union_surface( false );
+  this->set_union_voxel_size( 0 );
+  this->set_union_extraction( 0 );
 }
@@ -42,6 +42,34 @@ public:
   double get_child_scale();
   void set_child_scale( double scale );
 
+  /// worker threads used for mesh generation
+  int get_mesh_threads();
+  void set_mesh_threads( int threads );
+
+  /// maximum number of meshes generated at the same time
+  int get_meshes_in_flight();
+  void set_meshes_in_flight( int count );
+
+  /// largest distance between a tube mesh and the true surface (units of the data)
+  double get_mesh_tolerance();
+  void set_mesh_tolerance( double tolerance );
+
+  /// triangles shared by all structures of a scene, 0 disables decimation
+  int get_triangle_budget();
+  void set_triangle_budget( int triangles );
+
+  /// show the watertight union surface instead of the overlapping tubes
+  bool get_union_surface();
+  void set_union_surface( bool enabled );
+
+  /// grid spacing of the union surface, 0 picks one from each structure's radii
+  double get_union_voxel_size();
+  void set_union_voxel_size( double voxel_size );
+
+  /// surface extraction of the union surface (0: marching cubes, 1: surface nets, 2: CGAL skin surface)
+  int get_union_extraction();
+  void set_union_extraction( int extraction );
+
   /// restore all default values
   void restore_defaults();
 
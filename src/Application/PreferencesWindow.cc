@@ -17,6 +17,10 @@ PreferencesWindow::PreferencesWindow( QWidget* parent /*= 0 */ )
   this->ui_ = new Ui_PreferencesWindow;
   this->ui_->setupUi( this );
 
+#ifdef VIKING_USE_CGAL
+  this->ui_->union_extraction->addItem( "Skin surface (CGAL)" );
+#endif
+
   QPushButton* reset_button = this->ui_->button_box->button( QDialogButtonBox::RestoreDefaults );
   QObject::connect( reset_button, SIGNAL( clicked() ), this, SLOT( restore_defaults() ) );
 
@@ -70,6 +74,16 @@ void PreferencesWindow::set_values_from_preferences()
   this->ui_->connectome_table->resizeColumnsToContents();
   this->ui_->connectome_table->horizontalHeader()->setStretchLastSection( true );
   this->ui_->connectome_table->setSelectionBehavior( QAbstractItemView::SelectRows );
+
+  this->ui_->mesh_threads->setValue( Preferences::Instance().get_mesh_threads() );
+  this->ui_->meshes_in_flight->setValue( Preferences::Instance().get_meshes_in_flight() );
+  this->ui_->mesh_tolerance->setValue( Preferences::Instance().get_mesh_tolerance() );
+  this->ui_->triangle_budget->setValue( Preferences::Instance().get_triangle_budget() );
+  this->ui_->union_surface->setChecked( Preferences::Instance().get_union_surface() );
+  this->ui_->union_voxel_size->setValue( Preferences::Instance().get_union_voxel_size() );
+  this->ui_->union_voxel_size->setEnabled( Preferences::Instance().get_union_surface() );
+  this->ui_->union_extraction->setCurrentIndex( Preferences::Instance().get_union_extraction() );
+  this->ui_->union_extraction->setEnabled( Preferences::Instance().get_union_surface() );
 }
 
 //-----------------------------------------------------------------------------
@@ -124,3 +138,62 @@ void PreferencesWindow::on_delete_connectome_button_clicked()
   Preferences::Instance().set_connectome_list( nicknames, connectome_list );
   this->set_values_from_preferences();
 }
+
+//-----------------------------------------------------------------------------
+void PreferencesWindow::on_mesh_threads_valueChanged( int value )
+{
+  Preferences::Instance().set_mesh_threads( value );
+}
+
+//-----------------------------------------------------------------------------
+void PreferencesWindow::on_meshes_in_flight_valueChanged( int value )
+{
+  Preferences::Instance().set_meshes_in_flight( value );
+}
+
+//-----------------------------------------------------------------------------
+void PreferencesWindow::on_mesh_tolerance_editingFinished()
+{
+  if ( this->ui_->mesh_tolerance->value() != Preferences::Instance().get_mesh_tolerance() )
+  {
+    Preferences::Instance().set_mesh_tolerance( this->ui_->mesh_tolerance->value() );
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PreferencesWindow::on_triangle_budget_editingFinished()
+{
+  if ( this->ui_->triangle_budget->value() != Preferences::Instance().get_triangle_budget() )
+  {
+    Preferences::Instance().set_triangle_budget( this->ui_->triangle_budget->value() );
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PreferencesWindow::on_union_surface_toggled( bool checked )
+{
+  this->ui_->union_voxel_size->setEnabled( checked );
+  this->ui_->union_extraction->setEnabled( checked );
+  if ( checked != Preferences::Instance().get_union_surface() )
+  {
+    Preferences::Instance().set_union_surface( checked );
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PreferencesWindow::on_union_voxel_size_editingFinished()
+{
+  if ( this->ui_->union_voxel_size->value() != Preferences::Instance().get_union_voxel_size() )
+  {
+    Preferences::Instance().set_union_voxel_size( this->ui_->union_voxel_size->value() );
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PreferencesWindow::on_union_extraction_currentIndexChanged( int index )
+{
+  if ( index != Preferences::Instance().get_union_extraction() )
+  {
+    Preferences::Instance().set_union_extraction( index );
+  }
+}
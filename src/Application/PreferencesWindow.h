@@ -25,6 +25,14 @@ public Q_SLOTS:
   void on_add_connectome_button_clicked();
   void on_delete_connectome_button_clicked();
 
+  void on_mesh_threads_valueChanged( int value );
+  void on_meshes_in_flight_valueChanged( int value );
+  void on_mesh_tolerance_editingFinished();
+  void on_triangle_budget_editingFinished();
+  void on_union_surface_toggled( bool checked );
+  void on_union_voxel_size_editingFinished();
+  void on_union_extraction_currentIndexChanged( int index );
+
   void restore_defaults();
 
 private:
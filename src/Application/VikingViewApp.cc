@@ -1,4 +1,5 @@
 // std
+#include <algorithm>
 #include <iostream>
 
 // qt
@@ -10,9 +11,13 @@
 #include <QProgressDialog>
 #include <QXmlStreamWriter>
 #include <QDateTime>
+#include <QTextStream>
+#include <QElapsedTimer>
 
 // vtk
 #include <vtkRenderWindow.h>
+#include <vtkPolyData.h>
+#include <vtkQuadricDecimation.h>
 
 // viking
 #include <Application/VikingViewApp.h>
@@ -21,8 +26,15 @@
 //#include <Data/PointSampler.h>
 //#include <Data/AlphaShape.h>
 #include <Data/Downloader.h>
+#include <Data/CapsuleBVH.h>
 #include <Data/Structure.h>
+#include <Data/SkeletonMesher.h>
+#include <Data/UnionMesher.h>
+#ifdef VIKING_USE_CGAL
+#include <Data/SkinMesher.h>
+#endif
 #include <Visualization/Viewer.h>
+#include <Visualization/customQuadricDecimation.h>
 
 // ui
 #include <ui_VikingViewApp.h>
@@ -30,6 +42,8 @@
 //---------------------------------------------------------------------------
 VikingViewApp::VikingViewApp( int argc, char** argv )
 {
+  this->viewer_ = NULL;
+
   this->ui_ = new Ui_VikingViewApp;
   this->ui_->setupUi( this );
 
@@ -190,16 +204,190 @@ void VikingViewApp::export_dae( QString filename )
   xml->writeEndDocument();
 }
 
+//---------------------------------------------------------------------------
+void VikingViewApp::export_csv( QString filename )
+{
+  std::cerr << "exporting csv to \"" << filename.toStdString() << "\"\n";
+
+  QFile file( filename );
+
+  if ( !file.open( QIODevice::WriteOnly | QIODevice::Text ) )
+  {
+    QMessageBox::warning( 0, "Read only", "The file is in read only mode" );
+    return;
+  }
+
+  QTextStream stream( &file );
+
+  stream << "Cell,Structure,Type,Volume,Surface area,Center X,Center Y,Center Z,"
+         << Morphometrics::get_csv_header() << "\n";
+
+  foreach( QSharedPointer<Cell> cell, this->cells_ ) {
+    foreach( QSharedPointer<Structure> structure, cell->structures->values() ) {
+
+      const GeometryProperties &geometry = structure->get_geometry_properties();
+
+      stream << cell->id << "," << structure->get_id() << "," << structure->get_type() << ","
+             << geometry.volume << "," << geometry.surface_area << ","
+             << geometry.center_of_mass[0] << "," << geometry.center_of_mass[1] << ","
+             << geometry.center_of_mass[2] << ","
+             << structure->get_morphometrics().get_csv_string() << "\n";
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+void VikingViewApp::export_contacts( QString filename, double distance )
+{
+  std::cerr << "exporting contacts closer than " << distance << " to \"" << filename.toStdString() << "\"\n";
+
+  QElapsedTimer timer;
+  timer.start();
+
+  CapsuleBVH bvh;
+  bvh.build( this->cells_ );
+
+  std::cerr << "Built hierarchy over " << bvh.get_num_capsules() << " capsules in "
+            << timer.restart() / 1000.0 << " seconds\n";
+
+  std::vector<ContactSite> contacts = bvh.find_contacts( distance );
+
+  std::cerr << "Found " << contacts.size() << " contacts in " << timer.elapsed() / 1000.0 << " seconds\n";
+
+  if ( !CapsuleBVH::write_csv( contacts, filename ) )
+  {
+    QMessageBox::warning( 0, "Read only", "The file is in read only mode" );
+  }
+}
+
+//---------------------------------------------------------------------------
+void VikingViewApp::benchmark_meshers()
+{
+  std::cerr << "benchmarking meshers (tolerance " << Preferences::Instance().get_mesh_tolerance()
+            << ", voxel size " << Preferences::Instance().get_union_voxel_size() << ")\n";
+
+  QElapsedTimer timer;
+
+  foreach( QSharedPointer<Cell> cell, this->cells_ ) {
+    foreach( QSharedPointer<Structure> structure, cell->structures->values() ) {
+
+      const SkeletonGraph &graph = structure->get_skeleton_graph();
+
+      std::cerr << "structure " << structure->get_id() << ":\n";
+
+      timer.start();
+      SkeletonMesher tube_mesher;
+      tube_mesher.set_tolerance( Preferences::Instance().get_mesh_tolerance() );
+      MeshBuffer tubes = tube_mesher.generate( graph );
+      std::cerr << "  tubes: " << tubes.get_num_triangles() << " triangles in "
+                << timer.restart() / 1000.0 << " seconds\n";
+
+      UnionMesher union_mesher;
+      union_mesher.set_voxel_size( Preferences::Instance().get_union_voxel_size() );
+
+      union_mesher.set_extraction( UnionMesher::MARCHING_CUBES );
+      vtkSmartPointer<vtkPolyData> marching_cubes = union_mesher.generate( graph );
+      std::cerr << "  union, marching cubes: " << marching_cubes->GetNumberOfPolys() << " triangles in "
+                << timer.restart() / 1000.0 << " seconds (voxel size " << union_mesher.get_stats().voxel_size << ")\n";
+
+      union_mesher.set_extraction( UnionMesher::SURFACE_NETS );
+      vtkSmartPointer<vtkPolyData> surface_nets = union_mesher.generate( graph );
+      std::cerr << "  union, surface nets: " << surface_nets->GetNumberOfPolys() << " triangles in "
+                << timer.restart() / 1000.0 << " seconds\n";
+
+#ifdef VIKING_USE_CGAL
+      SkinMesher skin_mesher;
+      vtkSmartPointer<vtkPolyData> skin = skin_mesher.generate( structure.data() );
+      const SkinMeshStats &stats = skin_mesher.get_stats();
+      std::cerr << "  skin surface: " << skin->GetNumberOfPolys() << " triangles in "
+                << timer.restart() / 1000.0 << " seconds (" << stats.num_balls << " balls, sampling "
+                << stats.sample_time << "s, sequential mesh " << stats.mesh_time << "s)\n";
+#endif
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+void VikingViewApp::benchmark_decimation()
+{
+  std::cerr << "benchmarking decimation of the tube meshes to a tenth of their triangles ("
+            << QThread::idealThreadCount() << " threads)\n";
+#ifndef __AVX2__
+  std::cerr << "built without USE_AVX2, the AVX2 runs take the scalar path\n";
+#endif
+
+  QElapsedTimer timer;
+
+  foreach( QSharedPointer<Cell> cell, this->cells_ ) {
+    foreach( QSharedPointer<Structure> structure, cell->structures->values() ) {
+
+      SkeletonMesher mesher;
+      mesher.set_tolerance( Preferences::Instance().get_mesh_tolerance() );
+      vtkSmartPointer<vtkPolyData> tubes =
+        SkeletonMesher::create_polydata( mesher.generate( structure->get_skeleton_graph() ) );
+
+      std::cerr << "structure " << structure->get_id() << ": " << tubes->GetNumberOfPolys() << " triangles\n";
+
+      // the initial edge costs alone, no reduction leaves out the collapses
+      const char* cost_names[4] = { "scalar, serial", "AVX2, serial", "scalar, parallel", "AVX2, parallel" };
+      for ( int i = 0; i < 4; i++ )
+      {
+        vtkSmartPointer<customQuadricDecimation> decimation = vtkSmartPointer<customQuadricDecimation>::New();
+        decimation->SetInputData( tubes );
+        decimation->SetTargetReduction( 0.0 );
+        decimation->SetVectorizedCosts( i % 2 );
+        decimation->SetParallelCosts( i / 2 );
+        decimation->Update();
+        std::cerr << "  edge costs, " << cost_names[i] << ": " << decimation->GetCostTime() << " seconds\n";
+      }
+
+      // the whole filter in one pass, and split over the threads (only meshes of 10000 triangles per thread)
+      int partitions[2] = { 1, QThread::idealThreadCount() };
+      for ( int i = 0; i < 2; i++ )
+      {
+        vtkSmartPointer<customQuadricDecimation> decimation = vtkSmartPointer<customQuadricDecimation>::New();
+        decimation->SetInputData( tubes );
+        decimation->SetTargetReduction( 0.9 );
+        decimation->SetNumberOfPartitions( partitions[i] );
+        timer.start();
+        decimation->Update();
+        double seconds = timer.elapsed() / 1000.0;
+        std::cerr << "  decimation, " << partitions[i] << " partitions: " << seconds
+                  << " seconds (quadrics " << decimation->GetQuadricTime() << "s, costs "
+                  << decimation->GetCostTime() << "s, collapses " << decimation->GetCollapseTime() << "s), "
+                  << decimation->GetOutput()->GetNumberOfPolys() << " triangles, "
+                  << decimation->GetNumberOfEdgeCollapses() << " collapses, "
+                  << decimation->GetCollapseRate() << "/s collapsing, "
+                  << decimation->GetNumberOfEdgeCollapses() / std::max( seconds, 0.001 ) << "/s overall\n";
+      }
+
+      // the filter this one derives from, with vtkPriorityQueue and vtkEdgeTable; it does not count its
+      // collapses, but each removes one point
+      vtkSmartPointer<vtkQuadricDecimation> baseline = vtkSmartPointer<vtkQuadricDecimation>::New();
+      baseline->SetInputData( tubes );
+      baseline->SetTargetReduction( 0.9 );
+      timer.start();
+      baseline->Update();
+      double seconds = timer.elapsed() / 1000.0;
+      vtkIdType collapses = tubes->GetNumberOfPoints() - baseline->GetOutput()->GetNumberOfPoints();
+      std::cerr << "  vtkQuadricDecimation: " << seconds << " seconds, "
+                << baseline->GetOutput()->GetNumberOfPolys() << " triangles, " << collapses << " collapses, "
+                << collapses / std::max( seconds, 0.001 ) << "/s overall\n";
+    }
+  }
+}
+
 //---------------------------------------------------------------------------
 void VikingViewApp::update_table()
 {
   this->ui_->table_widget->clear();
 
-  this->ui_->table_widget->setRowCount( this->structures_.size() );
-  this->ui_->table_widget->setColumnCount( 3 );
+  this->ui_->table_widget->setRowCount( this->cells_.size() );
+  this->ui_->table_widget->setColumnCount( 9 );
 
   QStringList table_header;
-  table_header << "Id" << "Volume" << "Center of mass";
+  table_header << "Id" << "Volume" << "Surface area" << "Center of mass" << "Cable length"
+               << "Branch points" << "Tips" << "Strahler order" << "Max path length";
   this->ui_->table_widget->setHorizontalHeaderLabels( table_header );
 
   this->ui_->table_widget->verticalHeader()->setVisible( false );
@@ -210,11 +398,38 @@ void VikingViewApp::update_table()
     QTableWidgetItem* new_item = new QTableWidgetItem( QString::number( this->cells_[i]->id ) );
     this->ui_->table_widget->setItem( i, 0, new_item );
 
-    //new_item = new QTableWidgetItem( QString::number( this->structures_[i]->get_volume() ) );
-    //this->ui_->table_widget->setItem( i, 1, new_item );
+    // the cell's own structure shares the cell id, the rest are child structures
+    QSharedPointer<Structure> structure = this->cells_[i]->structures->value( this->cells_[i]->id );
+    if ( !structure )
+    {
+      continue;
+    }
+
+    new_item = new QTableWidgetItem( QString::number( structure->get_volume() ) );
+    this->ui_->table_widget->setItem( i, 1, new_item );
+
+    new_item = new QTableWidgetItem( QString::number( structure->get_surface_area() ) );
+    this->ui_->table_widget->setItem( i, 2, new_item );
+
+    new_item = new QTableWidgetItem( structure->get_center_of_mass_string() );
+    this->ui_->table_widget->setItem( i, 3, new_item );
 
-    //new_item = new QTableWidgetItem( this->structures_[i]->get_center_of_mass_string() );
-    //this->ui_->table_widget->setItem( i, 2, new_item );
+    const Morphometrics &metrics = structure->get_morphometrics();
+
+    new_item = new QTableWidgetItem( QString::number( metrics.cable_length ) );
+    this->ui_->table_widget->setItem( i, 4, new_item );
+
+    new_item = new QTableWidgetItem( QString::number( metrics.num_branch_points ) );
+    this->ui_->table_widget->setItem( i, 5, new_item );
+
+    new_item = new QTableWidgetItem( QString::number( metrics.num_tips ) );
+    this->ui_->table_widget->setItem( i, 6, new_item );
+
+    new_item = new QTableWidgetItem( QString::number( metrics.strahler_order ) );
+    this->ui_->table_widget->setItem( i, 7, new_item );
+
+    new_item = new QTableWidgetItem( QString::number( metrics.max_path_length ) );
+    this->ui_->table_widget->setItem( i, 8, new_item );
   }
 
   this->ui_->table_widget->resizeColumnsToContents();
@@ -243,6 +458,36 @@ void VikingViewApp::on_action_quit_triggered()
   this->close();
 }
 
+//---------------------------------------------------------------------------
+void VikingViewApp::on_action_export_metrics_triggered()
+{
+  QString filename = QFileDialog::getSaveFileName( this, "Export Metrics", QString(), "CSV files (*.csv)" );
+  if ( filename.isEmpty() )
+  {
+    return;
+  }
+  this->export_csv( filename );
+}
+
+//---------------------------------------------------------------------------
+void VikingViewApp::on_action_export_contacts_triggered()
+{
+  bool ok = false;
+  double distance = QInputDialog::getDouble( this, "Export Contacts", "Maximum distance:",
+                                             0.1, 0, 100, 3, &ok );
+  if ( !ok )
+  {
+    return;
+  }
+
+  QString filename = QFileDialog::getSaveFileName( this, "Export Contacts", QString(), "CSV files (*.csv)" );
+  if ( filename.isEmpty() )
+  {
+    return;
+  }
+  this->export_contacts( filename, distance );
+}
+
 //---------------------------------------------------------------------------
 void VikingViewApp::on_action_preferences_triggered()
 {
@@ -298,6 +543,17 @@ void VikingViewApp::on_preferences_changed()
   this->ui_->connectome_combo->setCurrentIndex( last_connectome );
 
   this->ui_->child_scale->setValue( Preferences::Instance().get_child_scale() );
+
+  // regenerate the meshes when the tessellation tolerance, triangle budget or surface type changed
+  if ( this->viewer_ &&
+       ( this->viewer_->get_mesh_tolerance() != Preferences::Instance().get_mesh_tolerance() ||
+         this->viewer_->get_triangle_budget() != Preferences::Instance().get_triangle_budget() ||
+         this->viewer_->get_union_surface() != Preferences::Instance().get_union_surface() ||
+         this->viewer_->get_union_voxel_size() != Preferences::Instance().get_union_voxel_size() ||
+         this->viewer_->get_union_extraction() != Preferences::Instance().get_union_extraction() ) )
+  {
+    this->viewer_->display_cells( this->cells_, false );
+  }
 }
 
 //---------------------------------------------------------------------------
@@ -35,11 +35,27 @@ public:
 
   void export_dae( QString filename );
 
+  /// write volume, surface area and morphometrics of every loaded structure
+  void export_csv( QString filename );
+
+  /// write the places where two loaded cells come closer than 'distance'
+  void export_contacts( QString filename, double distance );
+
+  /// mesh every loaded structure with each mesher and log triangle counts and times
+  void benchmark_meshers();
+
+  /// decimate the tube mesh of every loaded structure with the cost stage scalar or AVX2, serial or
+  /// parallel, and the whole filter in one pass or partitioned, and log the times and collapse rates
+  /// against vtkQuadricDecimation
+  void benchmark_decimation();
+
   virtual void closeEvent( QCloseEvent* event );
 
 public Q_SLOTS:
 
   void on_action_quit_triggered();
+  void on_action_export_metrics_triggered();
+  void on_action_export_contacts_triggered();
   void on_action_preferences_triggered();
 
   void on_add_button_clicked();
@@ -1,51 +1,41 @@
 #include <Data/AlphaShape.h>
+#include <Data/AlphaShapeFacets.h>
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/Delaunay_triangulation_3.h>
+#include <CGAL/Triangulation_vertex_base_with_info_3.h>
 #include <CGAL/Alpha_shape_3.h>
-#include <fstream>
 #include <list>
 #include <cassert>
 
 #include <vtkSmartPointer.h>
-#include <vtkCellArray.h>
-#include <vtkTriangle.h>
-#include <vtkPoints.h>
 #include <vtkPolyData.h>
-
-#include <vtkPolyDataWriter.h>
-
-//#include <vtkXMLPolyDataWriter.h>
-
-#include <vtkDataSetWriter.h>
+#include <vtkTimerLog.h>
 
 typedef CGAL::Exact_predicates_inexact_constructions_kernel Gt;
 typedef CGAL::Tag_true Alpha_cmp_tag;
 
+// the int info is the output index of the vertex (see extract_alpha_shape_facets)
+typedef CGAL::Triangulation_vertex_base_with_info_3<int, Gt> Info_vb;
+typedef CGAL::Alpha_shape_vertex_base_3<Gt, Info_vb, Alpha_cmp_tag> Vb;
+typedef CGAL::Alpha_shape_cell_base_3<Gt, CGAL::Default, Alpha_cmp_tag> Fb;
 
-//typedef CGAL::Alpha_shape_vertex_base_3<Gt> Vb;
-//typedef CGAL::Alpha_shape_cell_base_3<Gt> Fb;
-
-typedef CGAL::Alpha_shape_vertex_base_3<Gt,CGAL::Default,Alpha_cmp_tag> Vb;
-typedef CGAL::Alpha_shape_cell_base_3<Gt,CGAL::Default,Alpha_cmp_tag> Fb;
-
+#ifdef CGAL_LINKED_WITH_TBB
+typedef CGAL::Triangulation_data_structure_3<Vb, Fb, CGAL::Parallel_tag> Tds;
+#else
 typedef CGAL::Triangulation_data_structure_3<Vb, Fb> Tds;
-//typedef CGAL::Delaunay_triangulation_3<Gt,Tds,CGAL::Fast_location> Triangulation_3;
+#endif
 typedef CGAL::Delaunay_triangulation_3<Gt, Tds> Triangulation_3;
 
-
-//typedef CGAL::Alpha_shape_3<Triangulation_3> Alpha_shape_3;
-typedef CGAL::Alpha_shape_3<Triangulation_3,Alpha_cmp_tag> Alpha_shape_3;
+typedef CGAL::Alpha_shape_3<Triangulation_3, Alpha_cmp_tag> Alpha_shape_3;
 typedef Gt::Point_3 Point;
 typedef Alpha_shape_3::Alpha_iterator Alpha_iterator;
 
-
-
-
-
 //-----------------------------------------------------------------------------
 AlphaShape::AlphaShape()
-{}
+{
+  this->alpha_ = 0.5;
+}
 
 //-----------------------------------------------------------------------------
 AlphaShape::~AlphaShape()
@@ -54,13 +44,28 @@ AlphaShape::~AlphaShape()
 //-----------------------------------------------------------------------------
 vtkSmartPointer<vtkPolyData> AlphaShape::get_mesh()
 {
-  // compute alpha shape
-  Alpha_shape_3 as( this->points_.begin(), this->points_.end() );
+  double start_time = vtkTimerLog::GetUniversalTime();
+
+  // with a lock grid over the points the range insertion runs in parallel
+#ifdef CGAL_LINKED_WITH_TBB
+  CGAL::Bbox_3 box = this->points_.empty() ? CGAL::Bbox_3( 0, 0, 0, 0, 0, 0 ) : this->points_[0].bbox();
+  for ( size_t i = 1; i < this->points_.size(); i++ )
+  {
+    box = box + this->points_[i].bbox();
+  }
+  Triangulation_3::Lock_data_structure locking( box, 50 );
+  Triangulation_3 triangulation( Gt(), &locking );
+#else
+  Triangulation_3 triangulation;
+#endif
+  triangulation.insert( this->points_.begin(), this->points_.end() );
+
+  // compute alpha shape, takes over the triangulation
+  Alpha_shape_3 as( triangulation );
   std::cout << "Alpha shape computed in REGULARIZED mode by default"
             << std::endl;
 
-  float alpha = -1;
-  alpha = 0.50;
+  double alpha = this->alpha_;
   if ( alpha != -1 )
   {
     std::cout << "Using Alpha = " << alpha << "\n";
@@ -77,106 +82,39 @@ vtkSmartPointer<vtkPolyData> AlphaShape::get_mesh()
     assert( as.number_of_solid_components() == 1 );
   }
 
-  vtkSmartPointer<vtkPolyData> poly_data = vtkSmartPointer<vtkPolyData>::New();
+  double triangulation_time = vtkTimerLog::GetUniversalTime() - start_time;
+  start_time = vtkTimerLog::GetUniversalTime();
 
-  vtkSmartPointer<vtkPoints> vtk_pts = vtkSmartPointer<vtkPoints>::New();
-  vtkSmartPointer<vtkCellArray> vtk_triangles = vtkSmartPointer<vtkCellArray>::New();
+  MeshBuffer mesh;
+  extract_alpha_shape_facets( as, mesh );
+  vtkSmartPointer<vtkPolyData> polydata = SkeletonMesher::create_polydata( mesh );
 
-  /// collect all regular facets
-  std::vector<Alpha_shape_3::Facet> facets;
-  as.get_alpha_shape_facets( std::back_inserter( facets ), Alpha_shape_3::REGULAR );
+  std::cerr << "Created polydata with " << mesh.get_num_points() << " points, " << mesh.get_num_triangles()
+            << " triangles (triangulation " << triangulation_time << "s, extraction "
+            << vtkTimerLog::GetUniversalTime() - start_time << "s)\n";
 
-  std::stringstream pts;
-  std::stringstream ind;
-
-  std::map<Alpha_shape_3::Vertex_handle, int> vertex_map;
-
-  std::size_t nbf = facets.size();
-  int vertex_index = 0;
+  return polydata;
+}
 
-  for ( std::size_t i = 0; i < nbf; ++i )
+//-----------------------------------------------------------------------------
+void AlphaShape::set_points( const std::vector<double> &points )
+{
+  this->points_.clear();
+  this->points_.reserve( points.size() / 3 );
+  for ( size_t i = 0; i + 2 < points.size(); i += 3 )
   {
-
-    Alpha_shape_3::Facet f = facets[i];
-
-    //if ( as.classify( facets[i].first )==Alpha_shape_3::EXTERIOR )
-    {
-
-      //To have a consistent orientation of the facet, always consider an exterior cell
-      if ( as.classify( facets[i].first ) != Alpha_shape_3::EXTERIOR )
-      {
-        facets[i] = as.mirror_facet( facets[i] );
-      }
-      CGAL_assertion( as.classify( facets[i].first ) == Alpha_shape_3::EXTERIOR );
-
-      int indices[3] = {
-        ( facets[i].second + 1 ) % 4,
-        ( facets[i].second + 2 ) % 4,
-        ( facets[i].second + 3 ) % 4,
-      };
-
-      /// according to the encoding of vertex indices, this is needed to get
-      /// a consistent orientation
-      if ( facets[i].second % 2 == 0 ) { std::swap( indices[0], indices[1] ); }
-
-      pts <<
-        facets[i].first->vertex( indices[0] )->point() << "\n" <<
-        facets[i].first->vertex( indices[1] )->point() << "\n" <<
-        facets[i].first->vertex( indices[2] )->point() << "\n";
-
-      ind << "3 " << 3 * i << " " << 3 * i + 1 << " " << 3 * i + 2 << "\n";
-
-      for ( int index = 0; index < 3; index++ )
-
-      {
-        if ( vertex_map.find( facets[i].first->vertex( indices[index] ) ) == vertex_map.end() )
-        {
-          // not found
-          vertex_map[facets[i].first->vertex( indices[index] ) ] = vertex_index++;
-
-          Point p = facets[i].first->vertex( indices[index] )->point();
-          vtk_pts->InsertNextPoint( p.x(), p.y(), p.z() );
-        }
-      }
-
-      // Create a triangle
-      vtkSmartPointer<vtkTriangle> triangle =
-        vtkSmartPointer<vtkTriangle>::New();
-      triangle->GetPointIds()->SetId( 0, vertex_map[facets[i].first->vertex( indices[0] ) ] );
-      triangle->GetPointIds()->SetId( 1, vertex_map[facets[i].first->vertex( indices[1] ) ] );
-      triangle->GetPointIds()->SetId( 2, vertex_map[facets[i].first->vertex( indices[2] ) ] );
-
-      // Add the triangle to a cell array
-      vtk_triangles->InsertNextCell( triangle );
-    }
+    this->points_.push_back( Point( points[i], points[i + 1], points[i + 2] ) );
   }
+}
 
-/*
-   std::ofstream os("Z:\\Users\\amorris\\file.OFF");
-
-   os << "OFF "<< 3*nbf << " " << nbf << " 0\n";
-   os << pts.str();
-   os << ind.str();
-  */ 
-
-  std::cerr << "Created polydata with " << vertex_index << " points, " << vtk_triangles->GetNumberOfCells() << " triangles\n";
-
-  vtkSmartPointer<vtkPolyData> polydata =
-    vtkSmartPointer<vtkPolyData>::New();
-  polydata->SetPoints( vtk_pts );
-  polydata->SetPolys( vtk_triangles );
-
-/*
-   vtkSmartPointer<vtkPolyDataWriter> writer4 = vtkSmartPointer<vtkPolyDataWriter>::New();
-   writer4->SetFileName( "C:\\Users\\amorris\\file.vtk" );
-   writer4->SetInputData( polydata );
-   writer4->Write();
- */
-  return polydata;
+//-----------------------------------------------------------------------------
+void AlphaShape::set_alpha( double alpha )
+{
+  this->alpha_ = alpha;
 }
 
 //-----------------------------------------------------------------------------
-void AlphaShape::set_points( std::list<Point> points )
+double AlphaShape::get_alpha() const
 {
-  this->points_ = points;
+  return this->alpha_;
 }
@@ -1,6 +1,8 @@
 #ifndef VIKING_DATA_ALPHASHAPE_H
 #define VIKING_DATA_ALPHASHAPE_H
 
+#include <vector>
+
 #include <vtkSmartPointer.h>
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
@@ -16,13 +18,20 @@ public:
   AlphaShape();
   ~AlphaShape();
 
-  void set_points( std::list<Point> points );
+  /// points to triangulate, xyz per point (see PointSampler::sample_points)
+  void set_points( const std::vector<double> &points );
+
+  /// squared radius of the empty balls that carve the shape, -1 for the smallest giving one component
+  void set_alpha( double alpha );
+  double get_alpha() const;
 
   vtkSmartPointer<vtkPolyData> get_mesh();
 
 private:
 
-  std::list <Point> points_;
+  std::vector<Point> points_;
+
+  double alpha_;
 };
 
 #endif /* VIKING_DATA_ALPHASHAPE_H */
@@ -0,0 +1,67 @@
+#ifndef VIKING_DATA_ALPHASHAPEFACETS_H
+#define VIKING_DATA_ALPHASHAPEFACETS_H
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include <Data/SkeletonMesher.h>
+
+//! Regular facets of a CGAL alpha shape (Alpha_shape_3 or Fixed_alpha_shape_3) into a MeshBuffer
+/*!
+ * The vertex base must carry an int info field.  It is used as the output
+ * index: cleared to -1 first and set the first time a facet uses the vertex,
+ * so only vertices on the surface are written and no map from handles to
+ * indices is needed.  Facets are always read from their exterior cell, which
+ * orients them consistently outwards.  Normals are the area weighted
+ * averages of the facet normals (MeshBuffer::compute_normals).
+ */
+template <class Shape>
+void extract_alpha_shape_facets( Shape &shape, MeshBuffer &mesh )
+{
+  std::vector<typename Shape::Facet> facets;
+  shape.get_alpha_shape_facets( std::back_inserter( facets ), Shape::REGULAR );
+
+  for ( typename Shape::Finite_vertices_iterator it = shape.finite_vertices_begin();
+        it != shape.finite_vertices_end(); ++it )
+  {
+    it->info() = -1;
+  }
+
+  mesh.clear();
+  mesh.triangles.resize( 3 * facets.size() );
+
+  for ( size_t i = 0; i < facets.size(); i++ )
+  {
+    typename Shape::Facet facet = facets[i];
+    if ( shape.classify( facet.first ) != Shape::EXTERIOR )
+    {
+      facet = shape.mirror_facet( facet );
+    }
+
+    int indices[3] = { ( facet.second + 1 ) % 4, ( facet.second + 2 ) % 4, ( facet.second + 3 ) % 4 };
+
+    // according to the encoding of vertex indices, this is needed to get a consistent orientation
+    if ( facet.second % 2 == 0 )
+    {
+      std::swap( indices[0], indices[1] );
+    }
+
+    for ( int k = 0; k < 3; k++ )
+    {
+      typename Shape::Vertex_handle vertex = facet.first->vertex( indices[k] );
+      if ( vertex->info() < 0 )
+      {
+        vertex->info() = mesh.get_num_points();
+        mesh.points.push_back( CGAL::to_double( vertex->point().x() ) );
+        mesh.points.push_back( CGAL::to_double( vertex->point().y() ) );
+        mesh.points.push_back( CGAL::to_double( vertex->point().z() ) );
+      }
+      mesh.triangles[3 * i + k] = vertex->info();
+    }
+  }
+
+  mesh.compute_normals();
+}
+
+#endif /* VIKING_DATA_ALPHASHAPEFACETS_H */
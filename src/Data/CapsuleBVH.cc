@@ -0,0 +1,652 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include <Data/CapsuleBVH.h>
+#include <Data/SkeletonGraph.h>
+
+namespace
+{
+const int LEAF_SIZE = 4;
+
+//! orders capsules by the center of their axis along one coordinate
+class CapsuleCompare
+{
+public:
+  CapsuleCompare( int axis ) : axis_( axis ) {}
+
+  bool operator()( const Capsule &a, const Capsule &b ) const
+  {
+    return ( a.a[this->axis_] + a.b[this->axis_] ) < ( b.a[this->axis_] + b.b[this->axis_] );
+  }
+
+private:
+  int axis_;
+};
+}
+
+//-----------------------------------------------------------------------------
+CapsuleBVH::CapsuleBVH()
+{}
+
+//-----------------------------------------------------------------------------
+void CapsuleBVH::clear()
+{
+  this->capsules_.clear();
+  this->nodes_.clear();
+}
+
+//-----------------------------------------------------------------------------
+void CapsuleBVH::build( const QList< QSharedPointer<Cell> > &cells )
+{
+  std::vector<Capsule> capsules;
+
+  foreach( QSharedPointer<Cell> cell, cells ) {
+    foreach( QSharedPointer<Structure> structure, cell->structures->values() ) {
+      CapsuleBVH::collect_capsules( structure->get_skeleton_graph(), cell->id, structure->get_id(), capsules );
+    }
+  }
+
+  this->build( capsules );
+}
+
+//-----------------------------------------------------------------------------
+void CapsuleBVH::collect_capsules( const SkeletonGraph &graph, int cell_id, int structure_id,
+                                   std::vector<Capsule> &capsules )
+{
+  for ( int i = 0; i < graph.get_num_nodes(); i++ )
+  {
+    Capsule capsule;
+    capsule.cell_id = cell_id;
+    capsule.structure_id = structure_id;
+    capsule.node_a = graph.get_id( i );
+    capsule.radius_a = graph.get_radius( i );
+    const double* pa = graph.get_position( i );
+
+    // an isolated node is a sphere
+    int degree = graph.get_degree( i );
+    for ( int n = ( degree == 0 ? -1 : 0 ); n < degree; n++ )
+    {
+      int j = ( n == -1 ) ? i : graph.get_neighbor( i, n );
+      if ( j < i )
+      {
+        continue; // each link once
+      }
+
+      const double* pb = graph.get_position( j );
+      for ( int k = 0; k < 3; k++ )
+      {
+        capsule.a[k] = pa[k];
+        capsule.b[k] = pb[k];
+      }
+      capsule.radius_b = graph.get_radius( j );
+      capsule.node_b = graph.get_id( j );
+      capsules.push_back( capsule );
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void CapsuleBVH::build( const std::vector<Capsule> &capsules )
+{
+  this->clear();
+  this->capsules_ = capsules;
+
+  if ( this->capsules_.empty() )
+  {
+    return;
+  }
+
+  this->nodes_.reserve( 2 * ( this->capsules_.size() / LEAF_SIZE + 1 ) );
+
+  // top down split at the median of the longest axis, children always come after their parent
+  std::vector<int> stack;
+  BVHNode root;
+  root.left = -1;
+  root.right = -1;
+  root.first = 0;
+  root.count = (int)this->capsules_.size();
+  this->nodes_.push_back( root );
+  stack.push_back( 0 );
+
+  while ( !stack.empty() )
+  {
+    int index = stack.back();
+    stack.pop_back();
+
+    int first = this->nodes_[index].first;
+    int count = this->nodes_[index].count;
+
+    if ( count <= LEAF_SIZE )
+    {
+      continue;
+    }
+
+    double lower[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+    double upper[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+    for ( int i = first; i < first + count; i++ )
+    {
+      const Capsule &capsule = this->capsules_[i];
+      for ( int k = 0; k < 3; k++ )
+      {
+        double center = capsule.a[k] + capsule.b[k];
+        lower[k] = std::min( lower[k], center );
+        upper[k] = std::max( upper[k], center );
+      }
+    }
+
+    int axis = 0;
+    for ( int k = 1; k < 3; k++ )
+    {
+      if ( upper[k] - lower[k] > upper[axis] - lower[axis] )
+      {
+        axis = k;
+      }
+    }
+
+    int half = count / 2;
+    std::nth_element( this->capsules_.begin() + first, this->capsules_.begin() + first + half,
+                      this->capsules_.begin() + first + count, CapsuleCompare( axis ) );
+
+    BVHNode child;
+    child.left = -1;
+    child.right = -1;
+
+    child.first = first;
+    child.count = half;
+    this->nodes_[index].left = (int)this->nodes_.size();
+    this->nodes_.push_back( child );
+
+    child.first = first + half;
+    child.count = count - half;
+    this->nodes_[index].right = (int)this->nodes_.size();
+    this->nodes_.push_back( child );
+
+    stack.push_back( this->nodes_[index].left );
+    stack.push_back( this->nodes_[index].right );
+  }
+
+  // bounds and cell ids bottom up
+  for ( int index = (int)this->nodes_.size() - 1; index >= 0; index-- )
+  {
+    BVHNode &node = this->nodes_[index];
+
+    if ( node.left == -1 )
+    {
+      for ( int k = 0; k < 3; k++ )
+      {
+        node.bounds[2 * k] = DBL_MAX;
+        node.bounds[2 * k + 1] = -DBL_MAX;
+      }
+      node.cell_id = this->capsules_[node.first].cell_id;
+
+      for ( int i = node.first; i < node.first + node.count; i++ )
+      {
+        const Capsule &capsule = this->capsules_[i];
+        double radius = std::max( capsule.radius_a, capsule.radius_b );
+        for ( int k = 0; k < 3; k++ )
+        {
+          node.bounds[2 * k] = std::min( node.bounds[2 * k], std::min( capsule.a[k], capsule.b[k] ) - radius );
+          node.bounds[2 * k + 1] = std::max( node.bounds[2 * k + 1], std::max( capsule.a[k], capsule.b[k] ) + radius );
+        }
+        if ( capsule.cell_id != node.cell_id )
+        {
+          node.cell_id = -1;
+        }
+      }
+    }
+    else
+    {
+      const BVHNode &left = this->nodes_[node.left];
+      const BVHNode &right = this->nodes_[node.right];
+      for ( int k = 0; k < 3; k++ )
+      {
+        node.bounds[2 * k] = std::min( left.bounds[2 * k], right.bounds[2 * k] );
+        node.bounds[2 * k + 1] = std::max( left.bounds[2 * k + 1], right.bounds[2 * k + 1] );
+      }
+      node.cell_id = ( left.cell_id == right.cell_id ) ? left.cell_id : -1;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void CapsuleBVH::find_capsules( const double* bounds, std::vector<int> &result ) const
+{
+  result.clear();
+
+  if ( this->nodes_.empty() )
+  {
+    return;
+  }
+
+  int stack[64];
+  int top = 0;
+  stack[top++] = 0;
+
+  while ( top > 0 )
+  {
+    const BVHNode &node = this->nodes_[stack[--top]];
+
+    if ( CapsuleBVH::box_distance( node.bounds, bounds ) > 0 )
+    {
+      continue;
+    }
+
+    if ( node.left == -1 )
+    {
+      for ( int i = node.first; i < node.first + node.count; i++ )
+      {
+        const Capsule &capsule = this->capsules_[i];
+        double radius = std::max( capsule.radius_a, capsule.radius_b );
+        bool overlap = true;
+        for ( int k = 0; k < 3 && overlap; k++ )
+        {
+          overlap = std::min( capsule.a[k], capsule.b[k] ) - radius <= bounds[2 * k + 1] &&
+                    std::max( capsule.a[k], capsule.b[k] ) + radius >= bounds[2 * k];
+        }
+        if ( overlap )
+        {
+          result.push_back( i );
+        }
+      }
+    }
+    else
+    {
+      // median splits keep the depth near log2 of the leaf count
+      stack[top++] = node.left;
+      stack[top++] = node.right;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::vector<ContactSite> CapsuleBVH::find_contacts( double threshold ) const
+{
+  std::vector<ContactSite> contacts;
+
+  if ( this->nodes_.empty() )
+  {
+    return contacts;
+  }
+
+  // expand the top of the traversal into enough independent pairs to keep all threads busy
+  int target = 16 * QThread::idealThreadCount();
+
+  std::vector<std::pair<int, int> > pairs;
+  pairs.push_back( std::make_pair( 0, 0 ) );
+
+  bool expanded = true;
+  while ( expanded && (int)pairs.size() < target )
+  {
+    expanded = false;
+    std::vector<std::pair<int, int> > next;
+
+    for ( unsigned int i = 0; i < pairs.size(); i++ )
+    {
+      int a = pairs[i].first;
+      int b = pairs[i].second;
+      const BVHNode &node_a = this->nodes_[a];
+      const BVHNode &node_b = this->nodes_[b];
+
+      if ( node_a.cell_id != -1 && node_a.cell_id == node_b.cell_id )
+      {
+        continue;
+      }
+
+      if ( a == b )
+      {
+        if ( this->is_leaf( a ) )
+        {
+          next.push_back( pairs[i] );
+        }
+        else
+        {
+          next.push_back( std::make_pair( node_a.left, node_a.left ) );
+          next.push_back( std::make_pair( node_a.right, node_a.right ) );
+          next.push_back( std::make_pair( node_a.left, node_a.right ) );
+          expanded = true;
+        }
+        continue;
+      }
+
+      if ( CapsuleBVH::box_distance( node_a.bounds, node_b.bounds ) > threshold )
+      {
+        continue;
+      }
+
+      if ( this->is_leaf( a ) && this->is_leaf( b ) )
+      {
+        next.push_back( pairs[i] );
+      }
+      else if ( this->is_leaf( a ) )
+      {
+        next.push_back( std::make_pair( a, node_b.left ) );
+        next.push_back( std::make_pair( a, node_b.right ) );
+        expanded = true;
+      }
+      else if ( this->is_leaf( b ) )
+      {
+        next.push_back( std::make_pair( node_a.left, b ) );
+        next.push_back( std::make_pair( node_a.right, b ) );
+        expanded = true;
+      }
+      else
+      {
+        next.push_back( std::make_pair( node_a.left, node_b.left ) );
+        next.push_back( std::make_pair( node_a.left, node_b.right ) );
+        next.push_back( std::make_pair( node_a.right, node_b.left ) );
+        next.push_back( std::make_pair( node_a.right, node_b.right ) );
+        expanded = true;
+      }
+    }
+
+    pairs.swap( next );
+  }
+
+  std::vector<ContactTask> tasks( pairs.size() );
+  for ( unsigned int i = 0; i < pairs.size(); i++ )
+  {
+    tasks[i].bvh = this;
+    tasks[i].node_a = pairs[i].first;
+    tasks[i].node_b = pairs[i].second;
+    tasks[i].threshold = threshold;
+  }
+
+  QtConcurrent::blockingMap( tasks, CapsuleBVH::run_task );
+
+  for ( unsigned int i = 0; i < tasks.size(); i++ )
+  {
+    contacts.insert( contacts.end(), tasks[i].contacts.begin(), tasks[i].contacts.end() );
+  }
+
+  return contacts;
+}
+
+//-----------------------------------------------------------------------------
+void CapsuleBVH::run_task( ContactTask &task )
+{
+  task.bvh->query_pair( task.node_a, task.node_b, task.threshold, task.contacts );
+}
+
+//-----------------------------------------------------------------------------
+void CapsuleBVH::query_pair( int a, int b, double threshold, std::vector<ContactSite> &contacts ) const
+{
+  const BVHNode &node_a = this->nodes_[a];
+  const BVHNode &node_b = this->nodes_[b];
+
+  // everything below belongs to one cell
+  if ( node_a.cell_id != -1 && node_a.cell_id == node_b.cell_id )
+  {
+    return;
+  }
+
+  if ( a == b )
+  {
+    if ( this->is_leaf( a ) )
+    {
+      for ( int i = node_a.first; i < node_a.first + node_a.count; i++ )
+      {
+        for ( int j = i + 1; j < node_a.first + node_a.count; j++ )
+        {
+          this->test_capsules( i, j, threshold, contacts );
+        }
+      }
+    }
+    else
+    {
+      this->query_pair( node_a.left, node_a.left, threshold, contacts );
+      this->query_pair( node_a.right, node_a.right, threshold, contacts );
+      this->query_pair( node_a.left, node_a.right, threshold, contacts );
+    }
+    return;
+  }
+
+  if ( CapsuleBVH::box_distance( node_a.bounds, node_b.bounds ) > threshold )
+  {
+    return;
+  }
+
+  if ( this->is_leaf( a ) && this->is_leaf( b ) )
+  {
+    for ( int i = node_a.first; i < node_a.first + node_a.count; i++ )
+    {
+      for ( int j = node_b.first; j < node_b.first + node_b.count; j++ )
+      {
+        this->test_capsules( i, j, threshold, contacts );
+      }
+    }
+    return;
+  }
+
+  // descend into the larger box
+  double extent_a = 0, extent_b = 0;
+  for ( int k = 0; k < 3; k++ )
+  {
+    extent_a = std::max( extent_a, node_a.bounds[2 * k + 1] - node_a.bounds[2 * k] );
+    extent_b = std::max( extent_b, node_b.bounds[2 * k + 1] - node_b.bounds[2 * k] );
+  }
+
+  if ( this->is_leaf( b ) || ( !this->is_leaf( a ) && extent_a >= extent_b ) )
+  {
+    this->query_pair( node_a.left, b, threshold, contacts );
+    this->query_pair( node_a.right, b, threshold, contacts );
+  }
+  else
+  {
+    this->query_pair( a, node_b.left, threshold, contacts );
+    this->query_pair( a, node_b.right, threshold, contacts );
+  }
+}
+
+//-----------------------------------------------------------------------------
+void CapsuleBVH::test_capsules( int a, int b, double threshold, std::vector<ContactSite> &contacts ) const
+{
+  const Capsule &capsule_a = this->capsules_[a];
+  const Capsule &capsule_b = this->capsules_[b];
+
+  if ( capsule_a.cell_id == capsule_b.cell_id )
+  {
+    return;
+  }
+
+  double position[3];
+  double distance = CapsuleBVH::capsule_distance( capsule_a, capsule_b, position );
+  if ( distance > threshold )
+  {
+    return;
+  }
+
+  // order each pair by cell id so results do not depend on the traversal
+  const Capsule &first = ( capsule_a.cell_id < capsule_b.cell_id ) ? capsule_a : capsule_b;
+  const Capsule &second = ( capsule_a.cell_id < capsule_b.cell_id ) ? capsule_b : capsule_a;
+
+  ContactSite site;
+  site.cell_a = first.cell_id;
+  site.cell_b = second.cell_id;
+  site.structure_a = first.structure_id;
+  site.structure_b = second.structure_id;
+  site.node_a[0] = first.node_a;
+  site.node_a[1] = first.node_b;
+  site.node_b[0] = second.node_a;
+  site.node_b[1] = second.node_b;
+  site.distance = distance;
+  for ( int k = 0; k < 3; k++ )
+  {
+    site.position[k] = position[k];
+  }
+  contacts.push_back( site );
+}
+
+//-----------------------------------------------------------------------------
+double CapsuleBVH::box_distance( const double* a, const double* b )
+{
+  double d2 = 0;
+  for ( int k = 0; k < 3; k++ )
+  {
+    double gap = std::max( a[2 * k] - b[2 * k + 1], b[2 * k] - a[2 * k + 1] );
+    if ( gap > 0 )
+    {
+      d2 += gap * gap;
+    }
+  }
+  return sqrt( d2 );
+}
+
+//-----------------------------------------------------------------------------
+double CapsuleBVH::capsule_distance( const Capsule &a, const Capsule &b, double* position )
+{
+  // closest points between the two axes (Ericson, Real-Time Collision Detection 5.1.9)
+  double d1[3], d2[3], r[3];
+  for ( int k = 0; k < 3; k++ )
+  {
+    d1[k] = a.b[k] - a.a[k];
+    d2[k] = b.b[k] - b.a[k];
+    r[k] = a.a[k] - b.a[k];
+  }
+
+  double aa = d1[0] * d1[0] + d1[1] * d1[1] + d1[2] * d1[2];
+  double ee = d2[0] * d2[0] + d2[1] * d2[1] + d2[2] * d2[2];
+  double ff = d2[0] * r[0] + d2[1] * r[1] + d2[2] * r[2];
+
+  double s = 0, t = 0;
+  const double epsilon = 1e-12;
+
+  if ( aa <= epsilon && ee <= epsilon )
+  {
+    s = 0;
+    t = 0;
+  }
+  else if ( aa <= epsilon )
+  {
+    s = 0;
+    t = std::max( 0.0, std::min( 1.0, ff / ee ) );
+  }
+  else
+  {
+    double cc = d1[0] * r[0] + d1[1] * r[1] + d1[2] * r[2];
+    if ( ee <= epsilon )
+    {
+      t = 0;
+      s = std::max( 0.0, std::min( 1.0, -cc / aa ) );
+    }
+    else
+    {
+      double bb = d1[0] * d2[0] + d1[1] * d2[1] + d1[2] * d2[2];
+      double denom = aa * ee - bb * bb;
+
+      if ( denom > epsilon )
+      {
+        s = std::max( 0.0, std::min( 1.0, ( bb * ff - cc * ee ) / denom ) );
+      }
+      else
+      {
+        s = 0;
+      }
+
+      t = ( bb * s + ff ) / ee;
+
+      if ( t < 0 )
+      {
+        t = 0;
+        s = std::max( 0.0, std::min( 1.0, -cc / aa ) );
+      }
+      else if ( t > 1 )
+      {
+        t = 1;
+        s = std::max( 0.0, std::min( 1.0, ( bb - cc ) / aa ) );
+      }
+    }
+  }
+
+  // With tapering radii the smallest gap is not exactly at the closest axis points.
+  // The gap is convex in (s, t), so refine by alternately minimizing along each axis.
+  for ( int iteration = 0; iteration < 8; iteration++ )
+  {
+    double pa[3], pb[3];
+    for ( int k = 0; k < 3; k++ )
+    {
+      pb[k] = b.a[k] + d2[k] * t;
+    }
+    if ( aa > epsilon )
+    {
+      s = CapsuleBVH::minimize_gap( a.a, d1, pb, a.radius_b - a.radius_a );
+    }
+    for ( int k = 0; k < 3; k++ )
+    {
+      pa[k] = a.a[k] + d1[k] * s;
+    }
+    if ( ee > epsilon )
+    {
+      t = CapsuleBVH::minimize_gap( b.a, d2, pa, b.radius_b - b.radius_a );
+    }
+  }
+
+  double distance2 = 0;
+  for ( int k = 0; k < 3; k++ )
+  {
+    double pa = a.a[k] + d1[k] * s;
+    double pb = b.a[k] + d2[k] * t;
+    position[k] = 0.5 * ( pa + pb );
+    distance2 += ( pa - pb ) * ( pa - pb );
+  }
+
+  double radius_a = a.radius_a + ( a.radius_b - a.radius_a ) * s;
+  double radius_b = b.radius_a + ( b.radius_b - b.radius_a ) * t;
+
+  return sqrt( distance2 ) - radius_a - radius_b;
+}
+
+//-----------------------------------------------------------------------------
+double CapsuleBVH::minimize_gap( const double* origin, const double* direction, const double* point, double slope )
+{
+  // minimize |origin + s * direction - point| - slope * s over s in [0, 1]
+  double w[3] = { origin[0] - point[0], origin[1] - point[1], origin[2] - point[2] };
+  double length2 = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+  double wd = w[0] * direction[0] + w[1] * direction[1] + w[2] * direction[2];
+  double w2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+
+  double slope2 = slope * slope;
+  if ( slope2 >= length2 )
+  {
+    // the radius grows faster than the distance, one of the ends wins
+    return slope > 0 ? 1.0 : 0.0;
+  }
+
+  // squared distance of the point from the line, and the foot of the perpendicular
+  double line_distance2 = std::max( 0.0, w2 - wd * wd / length2 );
+  double foot = -wd / length2;
+
+  double u = slope * sqrt( line_distance2 ) / ( sqrt( length2 ) * sqrt( length2 - slope2 ) );
+
+  return std::max( 0.0, std::min( 1.0, foot + u ) );
+}
+
+//-----------------------------------------------------------------------------
+bool CapsuleBVH::write_csv( const std::vector<ContactSite> &contacts, QString filename )
+{
+  QFile file( filename );
+  if ( !file.open( QIODevice::WriteOnly | QIODevice::Text ) )
+  {
+    std::cerr << "unable to open \"" << filename.toStdString() << "\" for writing\n";
+    return false;
+  }
+
+  QTextStream stream( &file );
+  stream << "Cell A,Structure A,Node A1,Node A2,Cell B,Structure B,Node B1,Node B2,Distance,X,Y,Z\n";
+
+  for ( unsigned int i = 0; i < contacts.size(); i++ )
+  {
+    const ContactSite &site = contacts[i];
+    stream << site.cell_a << "," << site.structure_a << "," << site.node_a[0] << "," << site.node_a[1] << ","
+           << site.cell_b << "," << site.structure_b << "," << site.node_b[0] << "," << site.node_b[1] << ","
+           << site.distance << "," << site.position[0] << "," << site.position[1] << "," << site.position[2] << "\n";
+  }
+
+  return true;
+}
@@ -0,0 +1,124 @@
+#ifndef VIKING_DATA_CAPSULEBVH_H
+#define VIKING_DATA_CAPSULEBVH_H
+
+#include <vector>
+
+#include <Data/Structure.h>
+
+class SkeletonGraph;
+
+//! A link between two nodes swept with linearly varying radius
+class Capsule
+{
+public:
+  double a[3], b[3];
+  double radius_a, radius_b;
+
+  /// cell the capsule belongs to, capsules of the same cell are never tested against each other
+  int cell_id;
+  int structure_id;
+  long node_a, node_b;
+};
+
+//! Place where two cells come within the query distance
+class ContactSite
+{
+public:
+  int cell_a, cell_b;
+  int structure_a, structure_b;
+
+  /// link on each side (node ids)
+  long node_a[2], node_b[2];
+
+  /// surface to surface distance, negative where the capsules overlap
+  double distance;
+
+  /// midpoint between the closest points on the two capsule axes
+  double position[3];
+};
+
+//! Bounding volume hierarchy over the capsules of many structures
+/*!
+ * Each leaf holds a few capsules, each inner node the box around its two
+ * children.  Contacts are found with a dual tree traversal of the hierarchy
+ * against itself: pairs of boxes further apart than the threshold are skipped
+ * together with everything below them.  The top of the traversal is expanded
+ * into independent node pairs that are processed in parallel.
+ */
+class CapsuleBVH
+{
+
+public:
+  CapsuleBVH();
+
+  /// add the capsules of every structure of every cell
+  void build( const QList< QSharedPointer<Cell> > &cells );
+
+  void build( const std::vector<Capsule> &capsules );
+
+  void clear();
+
+  /// one capsule per link of a skeleton, a sphere for every isolated node
+  static void collect_capsules( const SkeletonGraph &graph, int cell_id, int structure_id,
+                                std::vector<Capsule> &capsules );
+
+  int get_num_capsules() const { return (int)this->capsules_.size(); }
+
+  /// capsules are reordered by build(), indices refer to that order
+  const Capsule& get_capsule( int index ) const { return this->capsules_[index]; }
+
+  /// indices of the capsules whose bounding box overlaps the box (xmin, xmax, ymin, ...)
+  void find_capsules( const double* bounds, std::vector<int> &result ) const;
+
+  /// contact sites between different cells closer than 'threshold' (surface to surface)
+  std::vector<ContactSite> find_contacts( double threshold ) const;
+
+  /// write contact sites as comma separated values
+  static bool write_csv( const std::vector<ContactSite> &contacts, QString filename );
+
+private:
+
+  class BVHNode
+  {
+  public:
+    double bounds[6];
+
+    /// cell of all capsules below this node, -1 if they come from several cells
+    int cell_id;
+
+    /// children for inner nodes, -1 for leaves
+    int left, right;
+
+    /// range in capsules_ for leaves
+    int first, count;
+  };
+
+  class ContactTask
+  {
+  public:
+    const CapsuleBVH* bvh;
+    int node_a, node_b;
+    double threshold;
+    std::vector<ContactSite> contacts;
+  };
+
+  static void run_task( ContactTask &task );
+
+  void query_pair( int node_a, int node_b, double threshold, std::vector<ContactSite> &contacts ) const;
+
+  void test_capsules( int a, int b, double threshold, std::vector<ContactSite> &contacts ) const;
+
+  bool is_leaf( int node ) const { return this->nodes_[node].left == -1; }
+
+  static double box_distance( const double* a, const double* b );
+
+  static double capsule_distance( const Capsule &a, const Capsule &b, double* position );
+
+  /// parameter along a tapered axis with the smallest gap to a point
+  static double minimize_gap( const double* origin, const double* direction, const double* point, double slope );
+
+  std::vector<Capsule> capsules_;
+  std::vector<BVHNode> nodes_;
+};
+
+#endif /* VIKING_DATA_CAPSULEBVH_H */
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPointData.h>
+
+#include <Data/CompactMesh.h>
+#include <Data/SkeletonMesher.h>
+
+//-----------------------------------------------------------------------------
+MeshMemoryStats::MeshMemoryStats()
+{
+  this->compact_bytes = 0;
+  this->live_vtk_bytes = 0;
+  this->old_vtk_bytes = 0;
+}
+
+//-----------------------------------------------------------------------------
+CompactMesh::CompactMesh()
+{}
+
+//-----------------------------------------------------------------------------
+QSharedPointer<CompactMesh> CompactMesh::create_mesh( const MeshBuffer &mesh )
+{
+  QSharedPointer<CompactMesh> compact = QSharedPointer<CompactMesh>( new CompactMesh() );
+  compact->resize( mesh.get_num_points(), mesh.get_num_triangles() );
+  compact->write( mesh, 0, 0 );
+  return compact;
+}
+
+//-----------------------------------------------------------------------------
+QSharedPointer<CompactMesh> CompactMesh::create_mesh( vtkPolyData* poly_data )
+{
+  MeshBuffer mesh;
+  mesh.resize( poly_data->GetNumberOfPoints(), 0 );
+
+  for ( int i = 0; i < mesh.get_num_points(); i++ )
+  {
+    poly_data->GetPoint( i, &mesh.points[3 * i] );
+  }
+
+  // polygons are split into fans
+  vtkIdType npts;
+  vtkIdType* pts;
+  vtkCellArray* polys = poly_data->GetPolys();
+  for ( polys->InitTraversal(); polys->GetNextCell( npts, pts ); )
+  {
+    for ( int j = 1; j + 1 < npts; j++ )
+    {
+      mesh.triangles.push_back( (int)pts[0] );
+      mesh.triangles.push_back( (int)pts[j] );
+      mesh.triangles.push_back( (int)pts[j + 1] );
+    }
+  }
+
+  vtkDataArray* normals = poly_data->GetPointData()->GetNormals();
+  if ( normals )
+  {
+    double normal[3];
+    for ( int i = 0; i < mesh.get_num_points(); i++ )
+    {
+      normals->GetTuple( i, normal );
+      mesh.normals[3 * i] = (float)normal[0];
+      mesh.normals[3 * i + 1] = (float)normal[1];
+      mesh.normals[3 * i + 2] = (float)normal[2];
+    }
+  }
+  else
+  {
+    mesh.compute_normals();
+  }
+
+  return CompactMesh::create_mesh( mesh );
+}
+
+//-----------------------------------------------------------------------------
+void CompactMesh::resize( int num_points, int num_triangles )
+{
+  this->points_.resize( 3 * num_points );
+  this->normals_.resize( num_points );
+  this->triangles_.resize( 3 * num_triangles );
+}
+
+//-----------------------------------------------------------------------------
+void CompactMesh::write( const MeshBuffer &mesh, int first_point, int first_triangle )
+{
+  int num_points = mesh.get_num_points();
+  for ( int i = 0; i < 3 * num_points; i++ )
+  {
+    this->points_[3 * first_point + i] = (float)mesh.points[i];
+  }
+
+  for ( int i = 0; i < num_points; i++ )
+  {
+    this->normals_[first_point + i] = CompactMesh::encode_normal( &mesh.normals[3 * i] );
+  }
+
+  int num_indices = (int)mesh.triangles.size();
+  for ( int i = 0; i < num_indices; i++ )
+  {
+    this->triangles_[3 * first_triangle + i] = (unsigned int)( mesh.triangles[i] + first_point );
+  }
+}
+
+//-----------------------------------------------------------------------------
+void CompactMesh::copy( const CompactMesh &source, int source_point, int num_points, int source_triangle,
+                        int num_triangles, int first_point, int first_triangle )
+{
+  if ( num_points > 0 )
+  {
+    memcpy( &this->points_[3 * first_point], &source.points_[3 * source_point], sizeof( float ) * 3 * num_points );
+    memcpy( &this->normals_[first_point], &source.normals_[source_point], sizeof( unsigned int ) * num_points );
+  }
+
+  unsigned int shift = (unsigned int)( first_point - source_point );
+  const unsigned int* triangles = &source.triangles_[3 * source_triangle];
+  for ( int i = 0; i < 3 * num_triangles; i++ )
+  {
+    // wraps around for pieces that move to a lower index, which unsigned arithmetic undoes
+    this->triangles_[3 * first_triangle + i] = triangles[i] + shift;
+  }
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> CompactMesh::get_poly_data()
+{
+  if ( this->poly_data_ )
+  {
+    return this->poly_data_.GetPointer();
+  }
+
+  int num_points = this->get_num_points();
+  int num_triangles = this->get_num_triangles();
+
+  vtkSmartPointer<vtkFloatArray> point_array = vtkSmartPointer<vtkFloatArray>::New();
+  point_array->SetNumberOfComponents( 3 );
+  point_array->SetNumberOfTuples( num_points );
+
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetData( point_array );
+
+  vtkSmartPointer<vtkFloatArray> normals = vtkSmartPointer<vtkFloatArray>::New();
+  normals->SetName( "Normals" );
+  normals->SetNumberOfComponents( 3 );
+  normals->SetNumberOfTuples( num_points );
+
+  vtkSmartPointer<vtkIdTypeArray> cell_array = vtkSmartPointer<vtkIdTypeArray>::New();
+  cell_array->SetNumberOfTuples( 4 * num_triangles );
+  vtkIdType* cells = cell_array->GetPointer( 0 );
+  for ( int i = 0; i < num_triangles; i++ )
+  {
+    cells[4 * i] = 3;
+    cells[4 * i + 1] = this->triangles_[3 * i];
+    cells[4 * i + 2] = this->triangles_[3 * i + 1];
+    cells[4 * i + 3] = this->triangles_[3 * i + 2];
+  }
+
+  vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+  polys->SetCells( num_triangles, cell_array );
+
+  vtkSmartPointer<vtkPolyData> poly_data = vtkSmartPointer<vtkPolyData>::New();
+  poly_data->SetPoints( points );
+  poly_data->GetPointData()->SetNormals( normals );
+  poly_data->SetPolys( polys );
+
+  this->poly_data_ = poly_data;
+  this->update_poly_data( 0, num_points );
+
+  return poly_data;
+}
+
+//-----------------------------------------------------------------------------
+void CompactMesh::update_poly_data( int first_point, int num_points )
+{
+  if ( !this->poly_data_ || num_points == 0 )
+  {
+    return;
+  }
+
+  vtkFloatArray* points = vtkFloatArray::SafeDownCast( this->poly_data_->GetPoints()->GetData() );
+  vtkFloatArray* normals = vtkFloatArray::SafeDownCast( this->poly_data_->GetPointData()->GetNormals() );
+
+  memcpy( points->GetPointer( 3 * first_point ), &this->points_[3 * first_point],
+          sizeof( float ) * 3 * num_points );
+
+  float* normal = normals->GetPointer( 3 * first_point );
+  for ( int i = 0; i < num_points; i++ )
+  {
+    CompactMesh::decode_normal( this->normals_[first_point + i], normal + 3 * i );
+  }
+
+  points->Modified();
+  normals->Modified();
+  this->poly_data_->Modified();
+}
+
+//-----------------------------------------------------------------------------
+size_t CompactMesh::get_memory_size() const
+{
+  return sizeof( float ) * this->points_.capacity() + sizeof( unsigned int ) * this->normals_.capacity()
+         + sizeof( unsigned int ) * this->triangles_.capacity();
+}
+
+//-----------------------------------------------------------------------------
+size_t CompactMesh::get_vtk_memory_size() const
+{
+  // (3, a, b, c) per triangle in the cell array
+  return ( 3 * sizeof( double ) + 3 * sizeof( float ) ) * this->get_num_points()
+         + 4 * sizeof( vtkIdType ) * this->get_num_triangles();
+}
+
+//-----------------------------------------------------------------------------
+size_t CompactMesh::get_live_memory_size() const
+{
+  if ( !this->poly_data_ )
+  {
+    return 0;
+  }
+
+  // in kibibytes
+  return (size_t)this->poly_data_->GetActualMemorySize() * 1024;
+}
+
+//-----------------------------------------------------------------------------
+unsigned int CompactMesh::encode_normal( const float* normal )
+{
+  // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper one
+  // (a zero normal comes out as +z)
+  double length = fabs( normal[0] ) + fabs( normal[1] ) + fabs( normal[2] );
+  double u = length > 0 ? normal[0] / length : 0;
+  double v = length > 0 ? normal[1] / length : 0;
+  if ( normal[2] < 0 )
+  {
+    double folded_u = ( 1.0 - fabs( v ) ) * ( u < 0 ? -1.0 : 1.0 );
+    double folded_v = ( 1.0 - fabs( u ) ) * ( v < 0 ? -1.0 : 1.0 );
+    u = folded_u;
+    v = folded_v;
+  }
+
+  unsigned int a = (unsigned int)floor( ( u * 0.5 + 0.5 ) * 65535.0 + 0.5 );
+  unsigned int b = (unsigned int)floor( ( v * 0.5 + 0.5 ) * 65535.0 + 0.5 );
+  return a | ( b << 16 );
+}
+
+//-----------------------------------------------------------------------------
+void CompactMesh::decode_normal( unsigned int code, float* normal )
+{
+  double u = ( code & 0xffff ) / 65535.0 * 2.0 - 1.0;
+  double v = ( code >> 16 ) / 65535.0 * 2.0 - 1.0;
+  double w = 1.0 - fabs( u ) - fabs( v );
+  if ( w < 0 )
+  {
+    double unfolded_u = ( 1.0 - fabs( v ) ) * ( u < 0 ? -1.0 : 1.0 );
+    double unfolded_v = ( 1.0 - fabs( u ) ) * ( v < 0 ? -1.0 : 1.0 );
+    u = unfolded_u;
+    v = unfolded_v;
+  }
+
+  double length = sqrt( u * u + v * v + w * w );
+  normal[0] = (float)( u / length );
+  normal[1] = (float)( v / length );
+  normal[2] = (float)( w / length );
+}
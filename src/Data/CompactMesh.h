@@ -0,0 +1,98 @@
+#ifndef VIKING_DATA_COMPACTMESH_H
+#define VIKING_DATA_COMPACTMESH_H
+
+#include <vector>
+#include <cstddef>
+
+#include <QSharedPointer>
+
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
+class vtkPolyData;
+class MeshBuffer;
+
+//! Memory held by the cached meshes of a structure
+class MeshMemoryStats
+{
+public:
+  MeshMemoryStats();
+
+  /// bytes of the compact meshes, including the full resolution tubes kept for patching
+  size_t compact_bytes;
+
+  /// bytes of the VTK copies alive for rendering, and of the line mesh, which is only kept as VTK
+  size_t live_vtk_bytes;
+
+  /// what the same meshes took when they were cached as vtkPolyData (double points, float normals,
+  /// vtkIdType cells)
+  size_t old_vtk_bytes;
+};
+
+//! Triangle mesh kept in a compact form for display, converted to VTK when it is rendered
+/*!
+ * Points are stored as floats, normals oct encoded into two 16 bit values
+ * (one 32 bit word per point, within a few hundredths of a degree) and
+ * triangles as 32 bit indices: 16 bytes per point and 12 per triangle
+ * against 36 and 32 for a vtkPolyData with double points and vtkIdType
+ * cells.  A mesh on display also has its VTK copy (24 bytes per point and
+ * 32 per triangle), 40 and 44 in all, so the saving comes from meshes that
+ * are cached but not displayed, such as the full resolution tubes behind a
+ * decimated mesh.
+ *
+ * get_poly_data() builds a vtkPolyData (float points, float normals) and
+ * remembers it with a weak pointer, so the same object is handed out while
+ * a mapper holds it and the memory goes away with the mapper.  Points and
+ * normals of a range rewritten in place can be pushed into that poly data
+ * with update_poly_data().
+ *
+ * write() and copy() fill disjoint ranges and can run in parallel.
+ */
+class CompactMesh
+{
+
+public:
+  CompactMesh();
+
+  /// encode a mesh buffer, or the triangles of a poly data (with its point normals if it has them)
+  static QSharedPointer<CompactMesh> create_mesh( const MeshBuffer &mesh );
+  static QSharedPointer<CompactMesh> create_mesh( vtkPolyData* poly_data );
+
+  void resize( int num_points, int num_triangles );
+
+  int get_num_points() const { return (int)this->points_.size() / 3; }
+  int get_num_triangles() const { return (int)this->triangles_.size() / 3; }
+
+  /// encode a mesh buffer into the ranges starting at the given point and triangle
+  void write( const MeshBuffer &mesh, int first_point, int first_triangle );
+
+  /// copy ranges of another compact mesh, moving the point indices along with the points
+  void copy( const CompactMesh &source, int source_point, int num_points, int source_triangle, int num_triangles,
+             int first_point, int first_triangle );
+
+  /// the mesh as VTK arrays, the same object as long as something else holds it
+  vtkSmartPointer<vtkPolyData> get_poly_data();
+
+  /// rewrite the points and normals of a range in the poly data handed out by get_poly_data, if it is still alive
+  void update_poly_data( int first_point, int num_points );
+
+  /// bytes of the compact arrays, and of the same mesh as a double precision vtkPolyData
+  size_t get_memory_size() const;
+  size_t get_vtk_memory_size() const;
+
+  /// bytes of the poly data handed out by get_poly_data, 0 once nothing holds it
+  size_t get_live_memory_size() const;
+
+  static unsigned int encode_normal( const float* normal );
+  static void decode_normal( unsigned int code, float* normal );
+
+private:
+
+  std::vector<float> points_;
+  std::vector<unsigned int> normals_;
+  std::vector<unsigned int> triangles_;
+
+  vtkWeakPointer<vtkPolyData> poly_data_;
+};
+
+#endif /* VIKING_DATA_COMPACTMESH_H */
@@ -0,0 +1,97 @@
+#include <algorithm>
+
+#include <Data/EdgeTable.h>
+
+//-----------------------------------------------------------------------------
+EdgeTable::EdgeTable()
+{
+  this->shift_ = 64;
+}
+
+//-----------------------------------------------------------------------------
+void EdgeTable::initialize( vtkIdType num_edges )
+{
+  this->end_points_.clear();
+  this->end_points_.reserve( 2 * num_edges );
+
+  // power of two, at most half full
+  int bits = 4;
+  while ( ( (vtkIdType)1 << bits ) < 2 * num_edges )
+  {
+    bits++;
+  }
+
+  this->slots_.assign( (size_t)1 << bits, -1 );
+  this->keys_.assign( (size_t)1 << bits, 0 );
+  this->shift_ = 64 - bits;
+}
+
+//-----------------------------------------------------------------------------
+unsigned long long EdgeTable::make_key( vtkIdType a, vtkIdType b )
+{
+  // unique for point ids below 2^32
+  unsigned long long lo = (unsigned long long)std::min( a, b );
+  unsigned long long hi = (unsigned long long)std::max( a, b );
+  return ( hi << 32 ) | lo;
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType EdgeTable::find_slot( unsigned long long key ) const
+{
+  // Fibonacci hashing, linear probing
+  size_t mask = this->slots_.size() - 1;
+  size_t slot = (size_t)( ( key * 0x9E3779B97F4A7C15ULL ) >> this->shift_ );
+
+  while ( this->slots_[slot] != -1 && this->keys_[slot] != key )
+  {
+    slot = ( slot + 1 ) & mask;
+  }
+
+  return slot;
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType EdgeTable::find_edge( vtkIdType a, vtkIdType b ) const
+{
+  if ( this->slots_.empty() )
+  {
+    return -1;
+  }
+
+  return this->slots_[this->find_slot( EdgeTable::make_key( a, b ) )];
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType EdgeTable::insert_edge( vtkIdType a, vtkIdType b )
+{
+  if ( 2 * ( this->get_num_edges() + 1 ) > (vtkIdType)this->slots_.size() )
+  {
+    this->grow();
+  }
+
+  vtkIdType id = this->get_num_edges();
+  this->end_points_.push_back( a );
+  this->end_points_.push_back( b );
+
+  unsigned long long key = EdgeTable::make_key( a, b );
+  vtkIdType slot = this->find_slot( key );
+  this->slots_[slot] = id;
+  this->keys_[slot] = key;
+
+  return id;
+}
+
+//-----------------------------------------------------------------------------
+void EdgeTable::grow()
+{
+  std::vector<vtkIdType> end_points;
+  end_points.swap( this->end_points_ );
+
+  vtkIdType num_edges = end_points.size() / 2;
+  this->initialize( std::max( (vtkIdType)8, 2 * num_edges ) );
+
+  for ( vtkIdType i = 0; i < num_edges; i++ )
+  {
+    this->insert_edge( end_points[2 * i], end_points[2 * i + 1] );
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef VIKING_DATA_EDGETABLE_H
+#define VIKING_DATA_EDGETABLE_H
+
+#include <vector>
+
+#include <vtkType.h>
+
+//! Edges of a triangle mesh with sequential ids and constant time lookup
+/*!
+ * Edges are numbered in the order they are inserted and keep the end points
+ * in that order. Lookup goes through an open addressing hash table keyed by
+ * the sorted vertex pair, probed linearly, so an edge can be found from
+ * either direction. Edges are never removed.
+ */
+class EdgeTable
+{
+
+public:
+  EdgeTable();
+
+  /// remove all edges and size the table for the expected number of edges
+  void initialize( vtkIdType num_edges );
+
+  /// id of the edge between two points, -1 if there is none
+  vtkIdType find_edge( vtkIdType a, vtkIdType b ) const;
+
+  /// add an edge (it must not exist yet) and return its id
+  vtkIdType insert_edge( vtkIdType a, vtkIdType b );
+
+  vtkIdType get_num_edges() const { return (vtkIdType)this->end_points_.size() / 2; }
+
+  /// end point 0 or 1 of an edge, in the order given to insert_edge
+  vtkIdType get_end_point( vtkIdType edge, int end ) const { return this->end_points_[2 * edge + end]; }
+
+  /// end points of all edges, two per edge
+  const vtkIdType* get_end_points() const { return &this->end_points_[0]; }
+
+private:
+
+  static unsigned long long make_key( vtkIdType a, vtkIdType b );
+
+  vtkIdType find_slot( unsigned long long key ) const;
+
+  void grow();
+
+  std::vector<vtkIdType> end_points_;
+
+  /// hash slots holding edge ids, -1 for empty
+  std::vector<vtkIdType> slots_;
+  std::vector<unsigned long long> keys_;
+  int shift_;
+};
+
+#endif /* VIKING_DATA_EDGETABLE_H */
@@ -1,6 +1,8 @@
 #ifndef VIKING_DATA_FIXEDALPHASHAPE_H
 #define VIKING_DATA_FIXEDALPHASHAPE_H
 
+#include <vector>
+
 #include <vtkSmartPointer.h>
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
@@ -16,13 +18,14 @@ public:
   FixedAlphaShape();
   ~FixedAlphaShape();
 
-  void set_points( std::list<Point> points );
+  /// points to triangulate, xyz per point (see PointSampler::sample_points)
+  void set_points( const std::vector<double> &points );
 
   vtkSmartPointer<vtkPolyData> get_mesh();
 
 private:
 
-  std::list <Point> points_;
+  std::vector<Point> points_;
 };
 
 #endif /* VIKING_DATA_FIXEDALPHASHAPE_H */
@@ -0,0 +1,634 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <QHash>
+
+#include <vtkPolyData.h>
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkTimerLog.h>
+
+#include <Data/MeshRepair.h>
+#include <Data/EdgeTable.h>
+
+//-----------------------------------------------------------------------------
+MeshRepairStats::MeshRepairStats()
+{
+  this->welded_points = 0;
+  this->degenerate_triangles = 0;
+  this->non_manifold_edges = 0;
+  this->removed_edges = 0;
+  this->removed_triangles = 0;
+  this->non_manifold_vertices = 0;
+  this->split_vertices = 0;
+  this->repair_time = 0;
+}
+
+//-----------------------------------------------------------------------------
+MeshRepair::MeshRepair()
+{
+  this->weld_tolerance_ = 0;
+  this->split_edges_ = true;
+}
+
+//-----------------------------------------------------------------------------
+void MeshRepair::set_weld_tolerance( double tolerance )
+{
+  this->weld_tolerance_ = tolerance;
+}
+
+//-----------------------------------------------------------------------------
+void MeshRepair::set_split_edges( bool split )
+{
+  this->split_edges_ = split;
+}
+
+//-----------------------------------------------------------------------------
+const MeshRepairStats& MeshRepair::get_stats() const
+{
+  return this->stats_;
+}
+
+//-----------------------------------------------------------------------------
+void MeshRepair::repair( MeshBuffer &mesh )
+{
+  this->stats_ = MeshRepairStats();
+
+  double start_time = vtkTimerLog::GetUniversalTime();
+
+  if ( this->weld_tolerance_ > 0 )
+  {
+    this->weld_points( mesh );
+  }
+
+  this->remove_degenerate_triangles( mesh );
+
+  // removing the triangles of an edge can leave a neighboring edge unpaired, so pair again until nothing changes
+  std::vector<int> partners;
+  std::vector<SplitEdge> split_edges;
+  bool first_pass = true;
+  while ( !this->pair_edges( mesh, partners, split_edges, first_pass ) )
+  {
+    first_pass = false;
+  }
+
+  this->split_vertices( mesh, partners, split_edges );
+  this->remove_unused_points( mesh );
+
+  this->stats_.repair_time = vtkTimerLog::GetUniversalTime() - start_time;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> MeshRepair::repair( vtkPolyData* poly_data )
+{
+  MeshBuffer mesh;
+
+  int num_points = poly_data->GetNumberOfPoints();
+  mesh.points.resize( 3 * num_points );
+  for ( int i = 0; i < num_points; i++ )
+  {
+    poly_data->GetPoint( i, &mesh.points[3 * i] );
+  }
+
+  vtkDataArray* normals = poly_data->GetPointData()->GetNormals();
+  if ( normals )
+  {
+    mesh.normals.resize( 3 * num_points );
+    for ( int i = 0; i < num_points; i++ )
+    {
+      double normal[3];
+      normals->GetTuple( i, normal );
+      for ( int k = 0; k < 3; k++ )
+      {
+        mesh.normals[3 * i + k] = (float)normal[k];
+      }
+    }
+  }
+
+  mesh.triangles.reserve( 3 * poly_data->GetNumberOfPolys() );
+  vtkCellArray* polys = poly_data->GetPolys();
+  vtkIdType num_ids;
+  vtkIdType* ids;
+  for ( polys->InitTraversal(); polys->GetNextCell( num_ids, ids ); )
+  {
+    for ( vtkIdType k = 2; k < num_ids; k++ )
+    {
+      mesh.triangles.push_back( (int)ids[0] );
+      mesh.triangles.push_back( (int)ids[k - 1] );
+      mesh.triangles.push_back( (int)ids[k] );
+    }
+  }
+
+  this->repair( mesh );
+
+  if ( !normals )
+  {
+    mesh.compute_normals();
+  }
+
+  return SkeletonMesher::create_polydata( mesh );
+}
+
+//-----------------------------------------------------------------------------
+unsigned long long MeshRepair::make_cell_key( long long x, long long y, long long z )
+{
+  // 21 bits per axis; cells that wrap onto the same key only cost a distance test
+  return ( (unsigned long long)( x & 0x1fffff ) << 42 ) | ( (unsigned long long)( y & 0x1fffff ) << 21 ) |
+         (unsigned long long)( z & 0x1fffff );
+}
+
+//-----------------------------------------------------------------------------
+void MeshRepair::weld_points( MeshBuffer &mesh )
+{
+  int num_points = mesh.get_num_points();
+  double h = this->weld_tolerance_;
+
+  // points that were kept, chained per grid cell of the tolerance's size
+  QHash<unsigned long long, int> cells;
+  cells.reserve( num_points );
+  std::vector<int> next( num_points, -1 );
+  std::vector<int> remap( num_points );
+
+  for ( int i = 0; i < num_points; i++ )
+  {
+    const double* p = &mesh.points[3 * i];
+    long long cell[3];
+    for ( int k = 0; k < 3; k++ )
+    {
+      cell[k] = (long long)floor( p[k] / h );
+    }
+
+    // a point within the tolerance is in this cell or one of its neighbors
+    int match = -1;
+    for ( int dz = -1; dz <= 1 && match < 0; dz++ )
+    {
+      for ( int dy = -1; dy <= 1 && match < 0; dy++ )
+      {
+        for ( int dx = -1; dx <= 1 && match < 0; dx++ )
+        {
+          int j = cells.value( MeshRepair::make_cell_key( cell[0] + dx, cell[1] + dy, cell[2] + dz ), -1 );
+          for (; j >= 0; j = next[j] )
+          {
+            const double* q = &mesh.points[3 * j];
+            double dist2 = ( p[0] - q[0] ) * ( p[0] - q[0] ) + ( p[1] - q[1] ) * ( p[1] - q[1] ) +
+                           ( p[2] - q[2] ) * ( p[2] - q[2] );
+            if ( dist2 <= h * h )
+            {
+              match = j;
+              break;
+            }
+          }
+        }
+      }
+    }
+
+    if ( match >= 0 )
+    {
+      remap[i] = match;
+      this->stats_.welded_points++;
+    }
+    else
+    {
+      remap[i] = i;
+      unsigned long long key = MeshRepair::make_cell_key( cell[0], cell[1], cell[2] );
+      next[i] = cells.value( key, -1 );
+      cells[key] = i;
+    }
+  }
+
+  for ( size_t i = 0; i < mesh.triangles.size(); i++ )
+  {
+    mesh.triangles[i] = remap[mesh.triangles[i]];
+  }
+}
+
+//-----------------------------------------------------------------------------
+void MeshRepair::remove_degenerate_triangles( MeshBuffer &mesh )
+{
+  std::vector<int> &triangles = mesh.triangles;
+  size_t count = 0;
+  for ( size_t i = 0; i < triangles.size(); i += 3 )
+  {
+    int a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+    if ( a == b || b == c || c == a )
+    {
+      this->stats_.degenerate_triangles++;
+      continue;
+    }
+    triangles[count++] = a;
+    triangles[count++] = b;
+    triangles[count++] = c;
+  }
+  triangles.resize( count );
+}
+
+//-----------------------------------------------------------------------------
+bool MeshRepair::pair_edges( MeshBuffer &mesh, std::vector<int> &partners, std::vector<SplitEdge> &split_edges,
+                             bool first_pass )
+{
+  std::vector<int> &triangles = mesh.triangles;
+  int num_corners = (int)triangles.size();
+
+  // corner c of a triangle starts the edge to the next corner of the same triangle
+  EdgeTable edges;
+  edges.initialize( num_corners / 2 + 1 );
+  std::vector<int> corner_edges( num_corners );
+  for ( int c = 0; c < num_corners; c++ )
+  {
+    int a = triangles[c];
+    int b = triangles[MeshRepair::next_corner( c )];
+    vtkIdType edge = edges.find_edge( a, b );
+    if ( edge < 0 )
+    {
+      edge = edges.insert_edge( a, b );
+    }
+    corner_edges[c] = (int)edge;
+  }
+
+  // corners of each edge, by a counting sort on the edge id
+  int num_edges = (int)edges.get_num_edges();
+  std::vector<int> first( num_edges + 1, 0 );
+  for ( int c = 0; c < num_corners; c++ )
+  {
+    first[corner_edges[c] + 1]++;
+  }
+  for ( int e = 0; e < num_edges; e++ )
+  {
+    first[e + 1] += first[e];
+  }
+  std::vector<int> edge_corners( num_corners );
+  std::vector<int> fill( first.begin(), first.end() - 1 );
+  for ( int c = 0; c < num_corners; c++ )
+  {
+    edge_corners[fill[corner_edges[c]]++] = c;
+  }
+
+  partners.assign( num_corners, -1 );
+  split_edges.clear();
+  std::vector<char> removed;
+
+  for ( int e = 0; e < num_edges; e++ )
+  {
+    const int* corners = &edge_corners[first[e]];
+    int count = first[e + 1] - first[e];
+
+    if ( count == 2 )
+    {
+      partners[corners[0]] = corners[1];
+      partners[corners[1]] = corners[0];
+    }
+    else if ( count > 2 )
+    {
+      if ( first_pass )
+      {
+        this->stats_.non_manifold_edges++;
+      }
+
+      SplitEdge split_edge;
+      split_edge.a = (int)edges.get_end_point( e, 0 );
+      split_edge.b = (int)edges.get_end_point( e, 1 );
+      split_edge.corners.assign( corners, corners + count );
+      split_edge.shift = 0;
+
+      if ( this->split_edges_ && MeshRepair::pair_around_edge( mesh, split_edge, partners ) )
+      {
+        split_edges.push_back( split_edge );
+        continue;
+      }
+
+      if ( removed.empty() )
+      {
+        removed.resize( num_corners / 3, 0 );
+      }
+      for ( int i = 0; i < count; i++ )
+      {
+        removed[corners[i] / 3] = 1;
+      }
+      this->stats_.removed_edges++;
+    }
+  }
+
+  if ( removed.empty() )
+  {
+    return true;
+  }
+
+  size_t count = 0;
+  for ( size_t t = 0; t < removed.size(); t++ )
+  {
+    if ( removed[t] )
+    {
+      this->stats_.removed_triangles++;
+      continue;
+    }
+    for ( int k = 0; k < 3; k++ )
+    {
+      triangles[count++] = triangles[3 * t + k];
+    }
+  }
+  triangles.resize( count );
+
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+bool MeshRepair::pair_around_edge( const MeshBuffer &mesh, const SplitEdge &edge, std::vector<int> &partners )
+{
+  int a = edge.a;
+  int b = edge.b;
+  const int* corners = &edge.corners[0];
+  int count = (int)edge.corners.size();
+
+  // an odd count cannot pair up opposite directions
+  if ( count % 2 != 0 )
+  {
+    return false;
+  }
+
+  const double* pa = &mesh.points[3 * a];
+  const double* pb = &mesh.points[3 * b];
+  double axis[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+  double length = sqrt( axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] );
+  if ( length <= 0 )
+  {
+    return false;
+  }
+  for ( int k = 0; k < 3; k++ )
+  {
+    axis[k] /= length;
+  }
+
+  // angle of each triangle's third point around the edge, measured from the first triangle
+  double u[3] = { 0, 0, 0 };
+  double v[3] = { 0, 0, 0 };
+  std::vector<std::pair<double, int> > around( count );
+  for ( int i = 0; i < count; i++ )
+  {
+    int c = corners[i];
+    int third = mesh.triangles[MeshRepair::next_corner( MeshRepair::next_corner( c ) )];
+    const double* p = &mesh.points[3 * third];
+    double w[3] = { p[0] - pa[0], p[1] - pa[1], p[2] - pa[2] };
+    double along = w[0] * axis[0] + w[1] * axis[1] + w[2] * axis[2];
+    for ( int k = 0; k < 3; k++ )
+    {
+      w[k] -= along * axis[k];
+    }
+
+    if ( i == 0 )
+    {
+      double w_length = sqrt( w[0] * w[0] + w[1] * w[1] + w[2] * w[2] );
+      if ( w_length <= 0 )
+      {
+        return false;
+      }
+      for ( int k = 0; k < 3; k++ )
+      {
+        u[k] = w[k] / w_length;
+      }
+      v[0] = axis[1] * u[2] - axis[2] * u[1];
+      v[1] = axis[2] * u[0] - axis[0] * u[2];
+      v[2] = axis[0] * u[1] - axis[1] * u[0];
+    }
+
+    double x = w[0] * u[0] + w[1] * u[1] + w[2] * u[2];
+    double y = w[0] * v[0] + w[1] * v[1] + w[2] * v[2];
+    around[i] = std::make_pair( atan2( y, x ), c );
+  }
+
+  std::sort( around.begin(), around.end() );
+
+  std::vector<int> forward;
+  std::vector<int> backward;
+  bool alternating = true;
+  for ( int i = 0; i < count; i++ )
+  {
+    bool is_forward = mesh.triangles[around[i].second] == a;
+    if ( is_forward == ( mesh.triangles[around[( i + 1 ) % count].second] == a ) )
+    {
+      alternating = false;
+    }
+    ( is_forward ? forward : backward ).push_back( i );
+  }
+
+  // without a consistent orientation there is no pairing that keeps it
+  if ( forward.size() != backward.size() )
+  {
+    return false;
+  }
+
+  // the outside of a triangle running a to b lies at larger angles, up to the next triangle (running b to a), and
+  // pairing those two keeps the interiors joined; sheets folded over near the edge do not alternate, but any
+  // pairing of opposite directions keeps them manifold.  A shift moves on to the next pairing.
+  int num_pairs = (int)forward.size();
+  int offset = ( alternating && forward[0] != 0 ) ? 1 : 0;
+  for ( int i = 0; i < num_pairs; i++ )
+  {
+    int c = around[forward[i]].second;
+    int d = around[backward[( i + offset + edge.shift ) % num_pairs]].second;
+    partners[c] = d;
+    partners[d] = c;
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+int MeshRepair::find_root( std::vector<int> &parents, int i )
+{
+  while ( parents[i] != i )
+  {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+//-----------------------------------------------------------------------------
+void MeshRepair::join_fans( const std::vector<int> &triangles, const std::vector<int> &partners,
+                            std::vector<int> &parents )
+{
+  // join the corners at either end of every paired edge, each set is then one fan around its vertex
+  int num_corners = (int)triangles.size();
+  parents.resize( num_corners );
+  for ( int c = 0; c < num_corners; c++ )
+  {
+    parents[c] = c;
+  }
+
+  for ( int c = 0; c < num_corners; c++ )
+  {
+    int partner = partners[c];
+    if ( partner < c )
+    {
+      continue;
+    }
+
+    int ends[2] = { c, MeshRepair::next_corner( c ) };
+    int first = partner - partner % 3;
+    for ( int i = 0; i < 2; i++ )
+    {
+      for ( int k = 0; k < 3; k++ )
+      {
+        if ( triangles[first + k] == triangles[ends[i]] )
+        {
+          int root_a = MeshRepair::find_root( parents, ends[i] );
+          int root_b = MeshRepair::find_root( parents, first + k );
+          parents[std::max( root_a, root_b )] = std::min( root_a, root_b );
+          break;
+        }
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool MeshRepair::fans_collide( const std::vector<int> &triangles, const SplitEdge &edge, std::vector<int> &parents )
+{
+  // a corner running a to b stands for its pair; two pairs collide if they share the fan at a and the fan at b
+  std::vector<int> forward;
+  for ( size_t i = 0; i < edge.corners.size(); i++ )
+  {
+    if ( triangles[edge.corners[i]] == edge.a )
+    {
+      forward.push_back( edge.corners[i] );
+    }
+  }
+
+  for ( size_t i = 0; i < forward.size(); i++ )
+  {
+    for ( size_t j = i + 1; j < forward.size(); j++ )
+    {
+      if ( MeshRepair::find_root( parents, forward[i] ) == MeshRepair::find_root( parents, forward[j] ) &&
+           MeshRepair::find_root( parents, MeshRepair::next_corner( forward[i] ) ) ==
+           MeshRepair::find_root( parents, MeshRepair::next_corner( forward[j] ) ) )
+      {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+void MeshRepair::split_vertices( MeshBuffer &mesh, std::vector<int> &partners, std::vector<SplitEdge> &split_edges )
+{
+  std::vector<int> &triangles = mesh.triangles;
+  int num_corners = (int)triangles.size();
+
+  // a pairing can leave two pairs in one fan at both ends, which no vertex split separates; those edges try the
+  // next pairing
+  std::vector<int> parents;
+  for ( int attempt = 0;; attempt++ )
+  {
+    MeshRepair::join_fans( triangles, partners, parents );
+
+    bool changed = false;
+    for ( size_t i = 0; i < split_edges.size() && attempt < MeshRepair::MAX_PAIRING_ATTEMPTS; i++ )
+    {
+      if ( MeshRepair::fans_collide( triangles, split_edges[i], parents ) )
+      {
+        split_edges[i].shift++;
+        MeshRepair::pair_around_edge( mesh, split_edges[i], partners );
+        changed = true;
+      }
+    }
+
+    if ( !changed )
+    {
+      break;
+    }
+  }
+
+  // the first fan seen keeps the vertex, every other fan gets a copy
+  int num_points = mesh.get_num_points();
+  std::vector<int> vertex_roots( num_points, -1 );
+  std::vector<int> root_vertices( num_corners, -1 );
+  std::vector<char> split( num_points, 0 );
+  bool has_normals = !mesh.normals.empty();
+
+  for ( int c = 0; c < num_corners; c++ )
+  {
+    int root = MeshRepair::find_root( parents, c );
+    int vertex = triangles[c];
+
+    if ( root_vertices[root] < 0 )
+    {
+      if ( vertex_roots[vertex] < 0 )
+      {
+        vertex_roots[vertex] = root;
+        root_vertices[root] = vertex;
+      }
+      else
+      {
+        root_vertices[root] = mesh.get_num_points();
+        for ( int k = 0; k < 3; k++ )
+        {
+          double coordinate = mesh.points[3 * vertex + k];
+          mesh.points.push_back( coordinate );
+        }
+        if ( has_normals )
+        {
+          for ( int k = 0; k < 3; k++ )
+          {
+            float normal = mesh.normals[3 * vertex + k];
+            mesh.normals.push_back( normal );
+          }
+        }
+
+        this->stats_.split_vertices++;
+        if ( !split[vertex] )
+        {
+          split[vertex] = 1;
+          this->stats_.non_manifold_vertices++;
+        }
+      }
+    }
+
+    triangles[c] = root_vertices[root];
+  }
+}
+
+//-----------------------------------------------------------------------------
+void MeshRepair::remove_unused_points( MeshBuffer &mesh )
+{
+  int num_points = mesh.get_num_points();
+  std::vector<int> remap( num_points, -1 );
+  for ( size_t i = 0; i < mesh.triangles.size(); i++ )
+  {
+    remap[mesh.triangles[i]] = 0;
+  }
+
+  bool has_normals = !mesh.normals.empty();
+  int count = 0;
+  for ( int i = 0; i < num_points; i++ )
+  {
+    if ( remap[i] < 0 )
+    {
+      continue;
+    }
+    remap[i] = count;
+    for ( int k = 0; k < 3; k++ )
+    {
+      mesh.points[3 * count + k] = mesh.points[3 * i + k];
+      if ( has_normals )
+      {
+        mesh.normals[3 * count + k] = mesh.normals[3 * i + k];
+      }
+    }
+    count++;
+  }
+
+  mesh.points.resize( 3 * count );
+  if ( has_normals )
+  {
+    mesh.normals.resize( 3 * count );
+  }
+
+  for ( size_t i = 0; i < mesh.triangles.size(); i++ )
+  {
+    mesh.triangles[i] = remap[mesh.triangles[i]];
+  }
+}
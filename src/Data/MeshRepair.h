@@ -0,0 +1,128 @@
+#ifndef VIKING_DATA_MESHREPAIR_H
+#define VIKING_DATA_MESHREPAIR_H
+
+#include <vector>
+
+#include <vtkSmartPointer.h>
+
+#include <Data/SkeletonMesher.h>
+
+class vtkPolyData;
+
+//! What the last repair found and changed
+class MeshRepairStats
+{
+public:
+  MeshRepairStats();
+
+  /// points merged into a nearby point before the repair
+  int welded_points;
+
+  /// triangles with a repeated corner, dropped
+  int degenerate_triangles;
+
+  /// edges with more than two triangles, and how many of them had their triangles removed
+  int non_manifold_edges;
+  int removed_edges;
+  int removed_triangles;
+
+  /// vertices where separate fans of triangles meet, and the copies added to split them
+  int non_manifold_vertices;
+  int split_vertices;
+
+  double repair_time;
+};
+
+//! Removes or splits the non-manifold edges and vertices of a triangle mesh in linear time
+/*!
+ * Points within the weld tolerance are merged first, through a hash of the
+ * grid cell each point falls in, so only the 27 cells around a point are
+ * searched.  Triangles that collapse to a line are dropped.
+ *
+ * Edges are collected in an EdgeTable and the triangles around each edge
+ * listed with a counting sort.  An edge with more than two triangles is a
+ * non-manifold edge.  On a consistently oriented surface the triangles
+ * around it alternate in direction when sorted by angle around the edge,
+ * and pairing each one with its neighbor across the outside wedge separates
+ * the sheets without losing a triangle; the interiors stay joined along the
+ * edge.  Sheets folded over near the edge are paired by direction alone.
+ * Edges with more triangles in one direction than the other (or all of
+ * them, if splitting is off) lose their triangles instead, as the old
+ * cleanup of the alpha shape did.
+ *
+ * The corners of triangles paired across an edge are joined with union find;
+ * a vertex whose corners end up in more than one set is where several fans
+ * touch, and every fan but the first gets its own copy of the vertex.  If
+ * two pairs around an edge end up in the same fans at both ends, the edge
+ * tries its next pairing.  Points no triangle uses are dropped at the end.
+ */
+class MeshRepair
+{
+
+public:
+  MeshRepair();
+
+  /// merge points closer than this before the repair (0: no welding)
+  void set_weld_tolerance( double tolerance );
+
+  /// pair up the triangles around a non-manifold edge instead of removing them
+  void set_split_edges( bool split );
+
+  void repair( MeshBuffer &mesh );
+
+  /// repair the polygons of a poly data (triangulated as fans), keeps point normals if it has them
+  vtkSmartPointer<vtkPolyData> repair( vtkPolyData* poly_data );
+
+  const MeshRepairStats& get_stats() const;
+
+private:
+
+  //! the triangle corners around a non-manifold edge that is split, and which of their pairings is used
+  class SplitEdge
+  {
+  public:
+    int a;
+    int b;
+    std::vector<int> corners;
+    int shift;
+  };
+
+  /// times the pairing of colliding edges is changed before the vertices are split anyway
+  static const int MAX_PAIRING_ATTEMPTS = 3;
+
+  void weld_points( MeshBuffer &mesh );
+
+  void remove_degenerate_triangles( MeshBuffer &mesh );
+
+  /// pair the triangle corners across every edge, returns false if triangles had to be removed
+  bool pair_edges( MeshBuffer &mesh, std::vector<int> &partners, std::vector<SplitEdge> &split_edges,
+                   bool first_pass );
+
+  void split_vertices( MeshBuffer &mesh, std::vector<int> &partners, std::vector<SplitEdge> &split_edges );
+
+  void remove_unused_points( MeshBuffer &mesh );
+
+  /// pair the corners around a non-manifold edge by their angle, false if the directions do not balance
+  static bool pair_around_edge( const MeshBuffer &mesh, const SplitEdge &edge, std::vector<int> &partners );
+
+  /// union find over the corners, joined across every paired edge
+  static void join_fans( const std::vector<int> &triangles, const std::vector<int> &partners,
+                         std::vector<int> &parents );
+
+  /// whether two pairs around the edge still share a fan at both ends
+  static bool fans_collide( const std::vector<int> &triangles, const SplitEdge &edge, std::vector<int> &parents );
+
+  static unsigned long long make_cell_key( long long x, long long y, long long z );
+
+  static int find_root( std::vector<int> &parents, int i );
+
+  /// the corner after c in its triangle
+  static int next_corner( int c ) { return c % 3 == 2 ? c - 2 : c + 1; }
+
+  double weld_tolerance_;
+  bool split_edges_;
+
+  MeshRepairStats stats_;
+};
+
+#endif /* VIKING_DATA_MESHREPAIR_H */
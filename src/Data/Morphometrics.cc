@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+#include <Data/Morphometrics.h>
+#include <Data/SkeletonGraph.h>
+
+//-----------------------------------------------------------------------------
+Morphometrics::Morphometrics()
+{
+  this->cable_length = 0;
+  this->num_branch_points = 0;
+  this->num_tips = 0;
+  this->strahler_order = 0;
+  this->root_id = -1;
+  this->max_path_length = 0;
+  this->mean_path_length = 0;
+  for ( int i = 0; i < 6; i++ )
+  {
+    this->bounds[i] = 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int Morphometrics::find_root( const SkeletonGraph &graph )
+{
+  int root = -1;
+  double max_radius = -DBL_MAX;
+  for ( int i = 0; i < graph.get_num_nodes(); i++ )
+  {
+    if ( graph.get_radius( i ) > max_radius )
+    {
+      max_radius = graph.get_radius( i );
+      root = i;
+    }
+  }
+  return root;
+}
+
+//-----------------------------------------------------------------------------
+Morphometrics Morphometrics::compute( const SkeletonGraph &graph )
+{
+  Morphometrics metrics;
+
+  int num_nodes = graph.get_num_nodes();
+  if ( num_nodes == 0 )
+  {
+    return metrics;
+  }
+
+  int root = Morphometrics::find_root( graph );
+  metrics.root_id = graph.get_id( root );
+
+  std::vector<int> parent( num_nodes, -2 ); // -2: not visited, -1: root of a component
+  std::vector<double> path( num_nodes, 0 );
+  std::vector<int> order;
+  order.reserve( num_nodes );
+
+  std::vector<int> stack;
+  stack.reserve( num_nodes );
+
+  for ( int i = 0; i < 6; i += 2 )
+  {
+    metrics.bounds[i] = DBL_MAX;
+    metrics.bounds[i + 1] = -DBL_MAX;
+  }
+
+  // depth first traversal from the root (and from any disconnected remainder)
+  for ( int start = -1; start < num_nodes; start++ )
+  {
+    int seed = ( start == -1 ) ? root : start;
+    if ( parent[seed] != -2 )
+    {
+      continue;
+    }
+
+    parent[seed] = -1;
+    stack.push_back( seed );
+
+    while ( !stack.empty() )
+    {
+      int node = stack.back();
+      stack.pop_back();
+      order.push_back( node );
+
+      int degree = graph.get_degree( node );
+      if ( degree > 2 )
+      {
+        metrics.num_branch_points++;
+      }
+      if ( degree == 1 && node != root )
+      {
+        metrics.num_tips++;
+      }
+
+      const double* p = graph.get_position( node );
+      double r = graph.get_radius( node );
+      for ( int k = 0; k < 3; k++ )
+      {
+        metrics.bounds[2 * k] = std::min( metrics.bounds[2 * k], p[k] - r );
+        metrics.bounds[2 * k + 1] = std::max( metrics.bounds[2 * k + 1], p[k] + r );
+      }
+
+      for ( int n = 0; n < degree; n++ )
+      {
+        int other = graph.get_neighbor( node, n );
+        double length = graph.distance( node, other );
+
+        // every link is seen from both ends, count it once
+        if ( other > node )
+        {
+          metrics.cable_length += length;
+        }
+
+        if ( parent[other] == -2 )
+        {
+          parent[other] = node;
+          path[other] = path[node] + length;
+          stack.push_back( other );
+        }
+      }
+    }
+  }
+
+  // Strahler order, children before parents
+  std::vector<int> max_child_order( num_nodes, 0 );
+  std::vector<int> max_child_count( num_nodes, 0 );
+  double path_sum = 0;
+
+  for ( int i = num_nodes - 1; i >= 0; i-- )
+  {
+    int node = order[i];
+
+    int strahler = 1;
+    if ( max_child_order[node] > 0 )
+    {
+      strahler = max_child_order[node] + ( max_child_count[node] > 1 ? 1 : 0 );
+    }
+
+    int p = parent[node];
+    if ( p >= 0 )
+    {
+      if ( strahler > max_child_order[p] )
+      {
+        max_child_order[p] = strahler;
+        max_child_count[p] = 1;
+      }
+      else if ( strahler == max_child_order[p] )
+      {
+        max_child_count[p]++;
+      }
+    }
+    else
+    {
+      metrics.strahler_order = std::max( metrics.strahler_order, strahler );
+    }
+
+    metrics.max_path_length = std::max( metrics.max_path_length, path[node] );
+    path_sum += path[node];
+  }
+
+  metrics.mean_path_length = path_sum / num_nodes;
+
+  return metrics;
+}
+
+//-----------------------------------------------------------------------------
+QString Morphometrics::get_csv_header()
+{
+  return "Cable length,Branch points,Tips,Strahler order,Root,Max path length,Mean path length,"
+         "Min X,Max X,Min Y,Max Y,Min Z,Max Z";
+}
+
+//-----------------------------------------------------------------------------
+QString Morphometrics::get_csv_string() const
+{
+  QString str = QString::number( this->cable_length ) + ","
+                + QString::number( this->num_branch_points ) + ","
+                + QString::number( this->num_tips ) + ","
+                + QString::number( this->strahler_order ) + ","
+                + QString::number( this->root_id ) + ","
+                + QString::number( this->max_path_length ) + ","
+                + QString::number( this->mean_path_length );
+
+  for ( int i = 0; i < 6; i++ )
+  {
+    str = str + "," + QString::number( this->bounds[i] );
+  }
+
+  return str;
+}
@@ -0,0 +1,46 @@
+#ifndef VIKING_DATA_MORPHOMETRICS_H
+#define VIKING_DATA_MORPHOMETRICS_H
+
+#include <QString>
+
+class SkeletonGraph;
+
+//! Morphometric measurements of one structure
+class Morphometrics
+{
+public:
+  Morphometrics();
+
+  /// total length of all links
+  double cable_length;
+
+  /// nodes with more than two links
+  int num_branch_points;
+
+  /// end nodes, not counting the root
+  int num_tips;
+
+  /// Strahler order at the root
+  int strahler_order;
+
+  /// node the path lengths are measured from (the soma, i.e. the largest radius)
+  long root_id;
+
+  /// path length along the skeleton from the root
+  double max_path_length;
+  double mean_path_length;
+
+  /// xmin, xmax, ymin, ymax, zmin, zmax including node radii
+  double bounds[6];
+
+  /// build from the skeleton in a single depth first traversal
+  static Morphometrics compute( const SkeletonGraph &graph );
+
+  /// index of the node used as the root (largest radius)
+  static int find_root( const SkeletonGraph &graph );
+
+  static QString get_csv_header();
+  QString get_csv_string() const;
+};
+
+#endif /* VIKING_DATA_MORPHOMETRICS_H */
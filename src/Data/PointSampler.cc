@@ -1,14 +1,36 @@
-#include <QSharedPointer.h>
+#include <algorithm>
+#include <cmath>
+
+#include <QSharedPointer>
+#include <QtConcurrentMap>
 
 #include <Data/PointSampler.h>
 #include <Data/Structure.h>
 
 #include <vtkMath.h>
+#include <vtkTimerLog.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+PointSampleStats::PointSampleStats()
+{
+  this->num_links = 0;
+  this->num_spheres = 0;
+  this->num_points = 0;
+  this->sample_time = 0;
+}
 
 //-----------------------------------------------------------------------------
 PointSampler::PointSampler( Structure* structure )
 {
   this->structure_ = structure;
+  this->ball_spacing_ = 0.5;
+  this->min_ball_spacing_ = 0;
+  this->point_spacing_ = 0.25;
+  this->min_point_spacing_ = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -16,155 +38,16 @@ PointSampler::~PointSampler()
 {}
 
 //-----------------------------------------------------------------------------
-std::list<Point> PointSampler::sample_points()
+void PointSampler::sample_points( std::vector<double> &points )
 {
+  this->stats_ = PointSampleStats();
+  double start_time = vtkTimerLog::GetUniversalTime();
 
-  int num_radii = 1;
-  int num_pts_circle = 50;
-  int num_pts_line = 20;
-
-/*
-   int num_radii = 1;
-   int num_pts_circle = 5;
-   int num_pts_line = 2;
- */
   NodeMap node_map = this->structure_->get_node_map();
 
-  std::list<Point> points;
-
-  // spheres
-  for ( NodeMap::iterator it = node_map.begin(); it != node_map.end(); ++it )
-  {
-
-    QSharedPointer<Node> n = it.value();
-
-    if ( n->linked_nodes.size() != 1 )
-    {
-      continue;
-    }
-
-    // PointSampler::sample_sphere( n.radius, n.x, n.y, n.z, points );
-  }
-
-  // cylinders
-
-  //std::ofstream out;
-  //out.open( "C:\\Users\\amorris\\points.out" );
-
-/*
-   foreach( Link link, this->structure_->get_links() ) {
-
-    if ( node_map.find( link.a ) == node_map.end() || node_map.find( link.b ) == node_map.end() )
-    {
-      continue;
-    }
-
-    Node n1 = node_map[link.a];
-    Node n2 = node_map[link.b];
-
-    double p1[3], p2[3];
-
-    p1[0] = n1.x;
-    p1[1] = n1.y;
-    p1[2] = n1.z;
-    p2[0] = n2.x;
-    p2[1] = n2.y;
-    p2[2] = n2.z;
-
-    double vec[3];
-    vec[0] = p1[0] - p2[0];
-    vec[1] = p1[1] - p2[1];
-    vec[2] = p1[2] - p2[2];
-
-    double squared_distance = vtkMath::Distance2BetweenPoints( p1, p2 );
-    double distance = sqrt( squared_distance );
-
-    int this_num_points = ( num_pts_line * distance );
-    if ( this_num_points <= 3 )
-    {
-      this_num_points = 3;
-    }
-
-    vtkMath::Normalize( vec );
-
-    double other[3];
-    other[0] = 0.25;
-    other[1] = 0.25;
-    other[2] = 0.15;
-
-    double u[3];
-    vtkMath::Cross( vec, other, u );
-    vtkMath::Normalize( u );
-
-    double v[3];
-    vtkMath::Cross( vec, u, v );
-
-    double this_num_circle = num_pts_circle;
-    double this_num_radii = num_radii;
-
-    double avg_overall_radius = ( n1.radius + n2.radius ) / 2.0;
-
-    this_num_radii = 3 * avg_overall_radius;
-    if ( this_num_radii < 1 )
-    {
-      this_num_radii = 1;
-    }
-    else
-    {
-      //std::cerr << "rad = " << this_num_radii << "\n";
-    }
-
-    this_num_radii = (int)this_num_radii;
-
-    for ( double r = 1; r <= this_num_radii; r++ )
-    {
-      double n1_radius = n1.radius * ( r / this_num_radii );
-      double n2_radius = n2.radius * ( r / this_num_radii );
-
-      double avg_radius = ( n1_radius + n2_radius ) / 2.0;
-      this_num_circle = num_pts_circle * avg_radius;
-      if ( this_num_circle < 3 )
-      {
-        this_num_circle = 3;
-      }
-
-      for ( double i = 0; i < this_num_circle; i++ )
-      {
-        double theta = (double)i * 2 * M_PI / this_num_circle;
-
-        double circ1_x = n1.x + n1_radius * cos( theta ) * u[0] + n1_radius * sin( theta ) * v[0];
-        double circ1_y = n1.y + n1_radius * cos( theta ) * u[1] + n1_radius * sin( theta ) * v[1];
-        double circ1_z = n1.z + n1_radius * cos( theta ) * u[2] + n1_radius * sin( theta ) * v[2];
-
-        double circ2_x = n2.x + n2_radius * cos( theta ) * u[0] + n2_radius * sin( theta ) * v[0];
-        double circ2_y = n2.y + n2_radius * cos( theta ) * u[1] + n2_radius * sin( theta ) * v[1];
-        double circ2_z = n2.z + n2_radius * cos( theta ) * u[2] + n2_radius * sin( theta ) * v[2];
-
-        for ( double j = 0; j < this_num_points; j++ )
-        {
-          double ratio = j / ( (double)this_num_points - 1 );
-          double inv_ratio = 1 - ratio;
-
-          double this_x = circ1_x * ratio + circ2_x * inv_ratio;
-          double this_y = circ1_y * ratio + circ2_y * inv_ratio;
-          double this_z = circ1_z * ratio + circ2_z * inv_ratio;
-
-          Point p( this_x, this_y, this_z );
-          //points.push_back( p );
-
-          //PointSampler::sample_sphere( 1.0, this_x, this_y, this_z, points );
-
-          if ( this_x == 0 )
-          {
-            std::cerr << "oh no, break!\n";
-          }
-        }
-      }
-    }
-   }
- */
-
-  int sphere_count = 0;
+  // first pass: samples per link, and a table for every sphere size that comes up
+  std::vector<SampleTask> tasks;
+  size_t num_points = 0;
 
   foreach( Link link, this->structure_->get_links() ) {
 
@@ -176,135 +59,184 @@ std::list<Point> PointSampler::sample_points()
     QSharedPointer<Node> n1 = node_map[link.a];
     QSharedPointer<Node> n2 = node_map[link.b];
 
-    double p1[3], p2[3];
-
-    p1[0] = n1->x;
-    p1[1] = n1->y;
-    p1[2] = n1->z;
-    p2[0] = n2->x;
-    p2[1] = n2->y;
-    p2[2] = n2->z;
-
-    double vec[3];
-    vec[0] = p1[0] - p2[0];
-    vec[1] = p1[1] - p2[1];
-    vec[2] = p1[2] - p2[2];
-
-    double squared_distance = vtkMath::Distance2BetweenPoints( p1, p2 );
-    double distance = sqrt( squared_distance );
-
-    double num_steps = (int)( distance * num_pts_line );
-
-    if ( num_steps < 3 )
+    SampleTask task;
+    task.sampler = this;
+    task.a[0] = n1->x;
+    task.a[1] = n1->y;
+    task.a[2] = n1->z;
+    task.b[0] = n2->x;
+    task.b[1] = n2->y;
+    task.b[2] = n2->z;
+    task.radius_a = n1->radius;
+    task.radius_b = n2->radius;
+    task.num_steps = this->get_num_steps( task.a, task.b, task.radius_a, task.radius_b );
+    task.first_point = num_points;
+
+    for ( int step = 0; step < task.num_steps; step++ )
     {
-      num_steps = 3;
+      double ratio = (double)step / ( task.num_steps - 1 );
+      int samples = this->get_num_samples( task.radius_a * ratio + task.radius_b * ( 1 - ratio ) );
+      this->build_table( samples );
+      num_points += samples;
     }
+    this->stats_.num_spheres += task.num_steps;
 
-    for ( int step = 0; step < num_steps; step++ )
-    {
-      double ratio = (double)step / ( num_steps - 1 );
-      double inv_ratio = 1 - ratio;
-
-      double radius = ( n1->radius * ratio ) + ( n2->radius * inv_ratio );
-
-      double this_x = n1->x * ratio + n2->x * inv_ratio;
-      double this_y = n1->y * ratio + n2->y * inv_ratio;
-      double this_z = n1->z * ratio + n2->z * inv_ratio;
-
-      PointSampler::sample_sphere( radius, this_x, this_y, this_z, points );
-      sphere_count++;
-
-      //Point p( this_x, this_y, this_z );
-      //points.push_back( p );
-    }
+    tasks.push_back( task );
   }
 
-  std::ofstream out;
-  out.open( "Z:\\shared\\points.asc" );
-  for ( std::list<Point>::iterator it = points.begin(); it != points.end(); ++it )
+  // second pass: every link writes its own range
+  points.resize( 3 * num_points );
+  for ( size_t i = 0; i < tasks.size(); i++ )
   {
-    out << ( *it ).x() << " " << ( *it ).y() << " " << ( *it ).z() << "\n";
+    tasks[i].points = points.empty() ? NULL : &points[0];
   }
 
-  out.close();
+  QtConcurrent::blockingMap( tasks, PointSampler::sample_link );
 
-  std::cerr << "Sampled " << points.size() << " points\n";
-
-  std::cerr << "Created " << sphere_count << " spheres\n";
-
-  return points;
+  this->stats_.num_links = (int)tasks.size();
+  this->stats_.num_points = (int)num_points;
+  this->stats_.sample_time = vtkTimerLog::GetUniversalTime() - start_time;
 }
 
 //-----------------------------------------------------------------------------
-void PointSampler::sample_sphere( double radius, double ox, double oy, double oz, std::list<Point> &points )
+void PointSampler::set_point_spacing( double spacing, double min_spacing )
 {
+  this->point_spacing_ = spacing;
+  this->min_point_spacing_ = min_spacing;
+}
 
-  int rnd = 1;
+//-----------------------------------------------------------------------------
+int PointSampler::get_num_samples( double radius ) const
+{
+  // about one sample per spacing^2 of sphere area, a multiple of four for the vector loop
+  double spacing = std::max( this->point_spacing_ * radius, this->min_point_spacing_ );
+  double area = 4.0 * M_PI * radius * radius;
+  int samples = (int)ceil( area / std::max( spacing * spacing, 1e-12 ) );
+  samples = std::max( MIN_SAMPLES, std::min( MAX_SAMPLES, samples ) );
+  return ( samples + 3 ) & ~3;
+}
 
-  int samples = 100 * radius;
-  //int samples = 10 * radius;
+//-----------------------------------------------------------------------------
+int PointSampler::get_num_steps( const double* a, const double* b, double radius_a, double radius_b ) const
+{
+  // balls a fixed fraction of the local radius apart: the dents between two balls of radius r
+  // a distance s * r apart are r * ( 1 - sqrt( 1 - s * s / 4 ) ) deep, whatever the scale
+  double distance = sqrt( vtkMath::Distance2BetweenPoints( a, b ) );
+  // (the floor, when set, trades that bound for fewer balls on thin links)
+  double spacing = std::max( this->ball_spacing_ * std::min( radius_a, radius_b ), this->min_ball_spacing_ );
+  spacing = std::max( spacing, 1e-6 );
+  return std::max( 3, (int)ceil( distance / spacing ) + 1 );
+}
 
-  if ( samples < 10 )
+//-----------------------------------------------------------------------------
+void PointSampler::build_table( int samples )
+{
+  // tables are indexed by the sample count, a multiple of four
+  size_t slot = samples / 4;
+  if ( slot < this->tables_.size() && !this->tables_[slot].empty() )
   {
-    samples = 10;
+    return;
+  }
+  if ( slot >= this->tables_.size() )
+  {
+    this->tables_.resize( slot + 1 );
   }
 
-  double offset = 2.0 / (double)samples;
+  // Fibonacci sphere: evenly spaced heights, a golden angle turn between samples
+  std::vector<double> &table = this->tables_[slot];
+  table.resize( 3 * samples );
 
+  double offset = 2.0 / samples;
   double increment = M_PI * ( 3.0 - sqrt( 5.0 ) );
 
   for ( int i = 0; i < samples; i++ )
   {
-    double y = ( ( i * offset ) - 1 ) + ( offset / 2 );
-    double r = sqrt( 1 - pow( y, 2 ) );
-
-    double phi = ( ( i + rnd ) % samples ) * increment;
-
-    double x = cos( phi ) * r;
-    double z = sin( phi ) * r;
+    double y = ( i * offset - 1 ) + offset / 2;
+    double r = sqrt( std::max( 0.0, 1 - y * y ) );
+    double phi = ( ( i + 1 ) % samples ) * increment;
 
-    Point p( ox + ( x * radius ), oy + ( y * radius ), oz + ( z * radius ) );
-    points.push_back( p );
+    table[3 * i] = cos( phi ) * r;
+    table[3 * i + 1] = y;
+    table[3 * i + 2] = sin( phi ) * r;
   }
 }
 
 //-----------------------------------------------------------------------------
-std::list<Weighted_point> PointSampler::collect_spheres()
+void PointSampler::sample_link( SampleTask &task )
 {
+  const PointSampler* self = task.sampler;
+  double* out = task.points + 3 * task.first_point;
 
-  int num_radii = 1;
-  int num_pts_circle = 50;
-  int num_pts_line = 20;
+  for ( int step = 0; step < task.num_steps; step++ )
+  {
+    double ratio = (double)step / ( task.num_steps - 1 );
+    double radius = task.radius_a * ratio + task.radius_b * ( 1 - ratio );
+    double center[3];
+    for ( int k = 0; k < 3; k++ )
+    {
+      center[k] = task.a[k] * ratio + task.b[k] * ( 1 - ratio );
+    }
 
-/*
-   int num_radii = 1;
-   int num_pts_circle = 5;
-   int num_pts_line = 2;
- */
-  NodeMap node_map = this->structure_->get_node_map();
+    int samples = self->get_num_samples( radius );
+    PointSampler::sample_sphere( center, radius, self->tables_[samples / 4], samples, out );
+    out += 3 * samples;
+  }
+}
 
-  std::list<Weighted_point> points;
+//-----------------------------------------------------------------------------
+void PointSampler::sample_sphere( const double* center, double radius, const std::vector<double> &table,
+                                  int samples, double* out )
+{
+  const double* direction = &table[0];
+  int i = 0;
 
-  // spheres
-  for ( NodeMap::iterator it = node_map.begin(); it != node_map.end(); ++it )
+#ifdef __AVX2__
+  // four points (twelve coordinates) at a time, the center repeating every three lanes
+  const __m256d scale = _mm256_set1_pd( radius );
+  const __m256d c0 = _mm256_setr_pd( center[0], center[1], center[2], center[0] );
+  const __m256d c1 = _mm256_setr_pd( center[1], center[2], center[0], center[1] );
+  const __m256d c2 = _mm256_setr_pd( center[2], center[0], center[1], center[2] );
+
+  for ( ; i + 4 <= samples; i += 4 )
   {
+    const double* d = direction + 3 * i;
+    double* o = out + 3 * i;
+    _mm256_storeu_pd( o, _mm256_add_pd( c0, _mm256_mul_pd( scale, _mm256_loadu_pd( d ) ) ) );
+    _mm256_storeu_pd( o + 4, _mm256_add_pd( c1, _mm256_mul_pd( scale, _mm256_loadu_pd( d + 4 ) ) ) );
+    _mm256_storeu_pd( o + 8, _mm256_add_pd( c2, _mm256_mul_pd( scale, _mm256_loadu_pd( d + 8 ) ) ) );
+  }
+#endif
 
-    QSharedPointer<Node> n = it.value();
+  for ( ; i < samples; i++ )
+  {
+    out[3 * i] = center[0] + radius * direction[3 * i];
+    out[3 * i + 1] = center[1] + radius * direction[3 * i + 1];
+    out[3 * i + 2] = center[2] + radius * direction[3 * i + 2];
+  }
+}
 
-    if ( n->linked_nodes.size() != 1 )
-    {
-      continue;
-    }
+//-----------------------------------------------------------------------------
+void PointSampler::set_ball_spacing( double spacing, double min_spacing )
+{
+  this->ball_spacing_ = spacing;
+  this->min_ball_spacing_ = min_spacing;
+}
 
-    // PointSampler::sample_sphere( n.radius, n.x, n.y, n.z, points );
-  }
+//-----------------------------------------------------------------------------
+const PointSampleStats& PointSampler::get_stats() const
+{
+  return this->stats_;
+}
 
-  // cylinders
+//-----------------------------------------------------------------------------
+std::list<Weighted_point> PointSampler::collect_spheres()
+{
+  this->stats_ = PointSampleStats();
+  double start_time = vtkTimerLog::GetUniversalTime();
 
-  //std::ofstream out;
-  //out.open( "C:\\Users\\amorris\\points.out" );
+  NodeMap node_map = this->structure_->get_node_map();
 
-  int sphere_count = 0;
+  std::list<Weighted_point> points;
 
   foreach( Link link, this->structure_->get_links() ) {
 
@@ -325,23 +257,7 @@ std::list<Weighted_point> PointSampler::collect_spheres()
     p2[1] = n2->y;
     p2[2] = n2->z;
 
-    double vec[3];
-    vec[0] = p1[0] - p2[0];
-    vec[1] = p1[1] - p2[1];
-    vec[2] = p1[2] - p2[2];
-
-    double squared_distance = vtkMath::Distance2BetweenPoints( p1, p2 );
-    double distance = sqrt( squared_distance );
-
-    double smaller_radius = std::min<double>( n1->radius, n2->radius );
-
-    double num_steps = (int)( distance * num_pts_line );
-//    double num_steps = (int)( distance / ( smaller_radius / 4 ) );
-
-    if ( num_steps < 3 )
-    {
-      num_steps = 3;
-    }
+    int num_steps = this->get_num_steps( p1, p2, n1->radius, n2->radius );
 
     for ( int step = 0; step < num_steps; step++ )
     {
@@ -354,29 +270,13 @@ std::list<Weighted_point> PointSampler::collect_spheres()
       double this_y = n1->y * ratio + n2->y * inv_ratio;
       double this_z = n1->z * ratio + n2->z * inv_ratio;
 
-      points.push_front( Weighted_point( Bare_point( this_x, this_y, this_z ), radius ) );
-
-      //PointSampler::sample_sphere( radius, this_x, this_y, this_z, points );
-      sphere_count++;
-
-      //Point p( this_x, this_y, this_z );
-      //points.push_back( p );
+      points.push_front( Weighted_point( Bare_point( this_x, this_y, this_z ), radius * radius ) );
+      this->stats_.num_spheres++;
     }
+    this->stats_.num_links++;
   }
 
-/*
-   std::ofstream out;
-   out.open( "Z:\\shared\\points.asc" );
-   for ( std::list<Point>::iterator it = points.begin(); it != points.end(); ++it )
-   {
-    out << ( *it ).x() << " " << ( *it ).y() << " " << ( *it ).z() << "\n";
-   }
-
-   out.close();
- */
-  std::cerr << "Sampled " << points.size() << " points\n";
-
-  std::cerr << "Created " << sphere_count << " spheres\n";
+  this->stats_.sample_time = vtkTimerLog::GetUniversalTime() - start_time;
 
   return points;
 }
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cmath>
+
+#include <Data/SkeletonGeometry.h>
+#include <Data/SkeletonGraph.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//-----------------------------------------------------------------------------
+GeometryProperties::GeometryProperties()
+{
+  this->volume = 0;
+  this->surface_area = 0;
+  this->center_of_mass[0] = 0;
+  this->center_of_mass[1] = 0;
+  this->center_of_mass[2] = 0;
+}
+
+//-----------------------------------------------------------------------------
+GeometryProperties SkeletonGeometry::compute( const SkeletonGraph &graph )
+{
+  GeometryProperties properties;
+
+  double volume = 0;
+  double area = 0;
+  double moment[3] = {0, 0, 0};
+
+  int num_nodes = graph.get_num_nodes();
+
+  // remaining sphere surface per node after the cones have taken their share
+  std::vector<double> sphere_area( num_nodes, 0 );
+
+  // spheres on branch and end nodes
+  for ( int i = 0; i < num_nodes; i++ )
+  {
+    if ( graph.get_degree( i ) == 2 )
+    {
+      continue;
+    }
+
+    double r = graph.get_radius( i );
+    double v = 4.0 / 3.0 * M_PI * r * r * r;
+    const double* p = graph.get_position( i );
+
+    volume += v;
+    sphere_area[i] = 4.0 * M_PI * r * r;
+    for ( int k = 0; k < 3; k++ )
+    {
+      moment[k] += v * p[k];
+    }
+  }
+
+  // truncated cones on links
+  for ( int a = 0; a < num_nodes; a++ )
+  {
+    for ( int n = 0; n < graph.get_degree( a ); n++ )
+    {
+      int b = graph.get_neighbor( a, n );
+      if ( b < a )
+      {
+        continue; // each link once
+      }
+
+      const double* pa = graph.get_position( a );
+      const double* pb = graph.get_position( b );
+      double ra = graph.get_radius( a );
+      double rb = graph.get_radius( b );
+
+      double axis[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+      double h = sqrt( axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] );
+      if ( h <= 0 )
+      {
+        continue;
+      }
+      for ( int k = 0; k < 3; k++ )
+      {
+        axis[k] /= h;
+      }
+
+      double sum = ra * ra + ra * rb + rb * rb;
+      double v = M_PI * h * sum / 3.0;
+      double lateral = M_PI * ( ra + rb ) * sqrt( h * h + ( ra - rb ) * ( ra - rb ) );
+
+      // centroid of a truncated cone, measured from the 'a' end
+      double centroid = 0;
+      if ( sum > 0 )
+      {
+        centroid = h * ( ra * ra + 2 * ra * rb + 3 * rb * rb ) / ( 4 * sum );
+      }
+
+      volume += v;
+      area += lateral;
+      for ( int k = 0; k < 3; k++ )
+      {
+        moment[k] += v * ( pa[k] + centroid * axis[k] );
+      }
+
+      // remove the overlap with the spheres at either end
+      for ( int end = 0; end < 2; end++ )
+      {
+        int node = ( end == 0 ) ? a : b;
+        if ( graph.get_degree( node ) == 2 )
+        {
+          continue;
+        }
+
+        double sphere_radius = ( end == 0 ) ? ra : rb;
+        double far_radius = ( end == 0 ) ? rb : ra;
+        double direction = ( end == 0 ) ? 1.0 : -1.0;
+        const double* p = graph.get_position( node );
+
+        double overlap_volume, overlap_moment, cone_area, cap_area;
+        SkeletonGeometry::compute_joint_overlap( sphere_radius, far_radius, h,
+                                                 overlap_volume, overlap_moment, cone_area, cap_area );
+
+        volume -= overlap_volume;
+        area -= cone_area;
+        sphere_area[node] -= cap_area;
+        for ( int k = 0; k < 3; k++ )
+        {
+          moment[k] -= overlap_volume * p[k] + overlap_moment * direction * axis[k];
+        }
+      }
+    }
+  }
+
+  for ( int i = 0; i < num_nodes; i++ )
+  {
+    area += std::max( 0.0, sphere_area[i] );
+  }
+
+  properties.volume = volume;
+  properties.surface_area = area;
+  if ( volume > 0 )
+  {
+    for ( int k = 0; k < 3; k++ )
+    {
+      properties.center_of_mass[k] = moment[k] / volume;
+    }
+  }
+
+  return properties;
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonGeometry::compute_joint_overlap( double sphere_radius, double end_radius, double length,
+                                              double &volume, double &moment,
+                                              double &cone_area, double &sphere_area )
+{
+  // The cone starts at the sphere center with the sphere's radius, r(z) = R + s*z.
+  // Up to zs the cone surface lies inside the sphere (only when it tapers),
+  // from zs to z1 the sphere surface lies inside the cone.
+  double R = sphere_radius;
+  double s = ( end_radius - R ) / length;
+
+  double z1 = std::min( length, R );
+  double zs = 0;
+  if ( s < 0 )
+  {
+    zs = std::min( z1, -2.0 * R * s / ( 1 + s * s ) );
+  }
+
+  volume = M_PI * ( R * R * zs + R * s * zs * zs + s * s * zs * zs * zs / 3.0 )
+           + M_PI * ( R * R * ( z1 - zs ) - ( z1 * z1 * z1 - zs * zs * zs ) / 3.0 );
+
+  moment = M_PI * ( R * R * zs * zs / 2.0 + 2.0 * R * s * zs * zs * zs / 3.0 + s * s * zs * zs * zs * zs / 4.0 )
+           + M_PI * ( R * R * ( z1 * z1 - zs * zs ) / 2.0 - ( z1 * z1 * z1 * z1 - zs * zs * zs * zs ) / 4.0 );
+
+  cone_area = 2.0 * M_PI * sqrt( 1 + s * s ) * ( R * zs + s * zs * zs / 2.0 );
+  sphere_area = 2.0 * M_PI * R * ( z1 - zs );
+}
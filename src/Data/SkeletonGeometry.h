@@ -0,0 +1,40 @@
+#ifndef VIKING_DATA_SKELETONGEOMETRY_H
+#define VIKING_DATA_SKELETONGEOMETRY_H
+
+class SkeletonGraph;
+
+//! Volume, surface area and center of mass of a skeleton
+class GeometryProperties
+{
+public:
+  GeometryProperties();
+
+  double volume;
+  double surface_area;
+  double center_of_mass[3];
+};
+
+//! Computes geometric properties directly from node radii and links
+/*!
+ * The skeleton is treated the same way get_mesh_tubes() draws it: a truncated
+ * cone for every link and a sphere on every branch and end node.  Where a cone
+ * enters a sphere, the part of the cone inside the sphere is computed in closed
+ * form and subtracted so the joint is not counted twice.  Overlaps between
+ * neighbouring cones are ignored.
+ */
+class SkeletonGeometry
+{
+
+public:
+
+  static GeometryProperties compute( const SkeletonGraph &graph );
+
+private:
+
+  /// volume, axial moment and areas of a cone's overlap with the sphere on its first node
+  static void compute_joint_overlap( double sphere_radius, double end_radius, double length,
+                                     double &volume, double &moment,
+                                     double &cone_area, double &sphere_area );
+};
+
+#endif /* VIKING_DATA_SKELETONGEOMETRY_H */
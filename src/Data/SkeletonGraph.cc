@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cmath>
+
+#include <Data/SkeletonGraph.h>
+
+//-----------------------------------------------------------------------------
+SkeletonGraph::SkeletonGraph()
+{}
+
+//-----------------------------------------------------------------------------
+SkeletonGraph::~SkeletonGraph()
+{}
+
+//-----------------------------------------------------------------------------
+void SkeletonGraph::clear()
+{
+  this->ids_.clear();
+  this->positions_.clear();
+  this->radii_.clear();
+  this->offsets_.clear();
+  this->neighbors_.clear();
+  this->index_map_.clear();
+  this->segments_.clear();
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonGraph::set_node( int index, double x, double y, double z, double radius )
+{
+  this->positions_[3 * index] = x;
+  this->positions_[3 * index + 1] = y;
+  this->positions_[3 * index + 2] = z;
+  this->radii_[index] = radius;
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonGraph::build( const NodeMap &node_map )
+{
+  this->clear();
+
+  // sort the ids so that the indices are reproducible between runs
+  this->ids_.reserve( node_map.size() );
+  for ( NodeMap::const_iterator it = node_map.begin(); it != node_map.end(); ++it )
+  {
+    this->ids_.push_back( it.key() );
+  }
+  std::sort( this->ids_.begin(), this->ids_.end() );
+
+  int num_nodes = (int)this->ids_.size();
+  this->positions_.resize( 3 * num_nodes );
+  this->radii_.resize( num_nodes );
+  this->index_map_.reserve( num_nodes );
+
+  for ( int i = 0; i < num_nodes; i++ )
+  {
+    QSharedPointer<Node> n = node_map.value( this->ids_[i] );
+    this->positions_[3 * i] = n->x;
+    this->positions_[3 * i + 1] = n->y;
+    this->positions_[3 * i + 2] = n->z;
+    this->radii_[i] = n->radius;
+    this->index_map_.insert( this->ids_[i], i );
+  }
+
+  // adjacency, dropping self links, duplicates and links to culled nodes
+  this->offsets_.resize( num_nodes + 1 );
+  this->offsets_[0] = 0;
+  std::vector<int> linked;
+  for ( int i = 0; i < num_nodes; i++ )
+  {
+    QSharedPointer<Node> n = node_map.value( this->ids_[i] );
+
+    linked.clear();
+    foreach( int id, n->linked_nodes ) {
+      int index = this->get_index( id );
+      if ( index >= 0 && index != i )
+      {
+        linked.push_back( index );
+      }
+    }
+    std::sort( linked.begin(), linked.end() );
+    linked.erase( std::unique( linked.begin(), linked.end() ), linked.end() );
+
+    this->neighbors_.insert( this->neighbors_.end(), linked.begin(), linked.end() );
+    this->offsets_[i + 1] = (int)this->neighbors_.size();
+  }
+
+  this->build_segments();
+}
+
+//-----------------------------------------------------------------------------
+int SkeletonGraph::get_index( long id ) const
+{
+  return this->index_map_.value( id, -1 );
+}
+
+//-----------------------------------------------------------------------------
+double SkeletonGraph::distance( int a, int b ) const
+{
+  const double* pa = this->get_position( a );
+  const double* pb = this->get_position( b );
+  return sqrt( ( pa[0] - pb[0] ) * ( pa[0] - pb[0] )
+               + ( pa[1] - pb[1] ) * ( pa[1] - pb[1] )
+               + ( pa[2] - pb[2] ) * ( pa[2] - pb[2] ) );
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonGraph::build_segments()
+{
+  // one flag per directed link slot, both directions are marked together
+  std::vector<char> used( this->neighbors_.size(), 0 );
+
+  int num_nodes = this->get_num_nodes();
+
+  for ( int pass = 0; pass < 2; pass++ )
+  {
+    for ( int start = 0; start < num_nodes; start++ )
+    {
+      // the first pass starts at branch/end nodes, the second picks up closed loops
+      if ( pass == 0 && this->get_degree( start ) == 2 )
+      {
+        continue;
+      }
+
+      for ( int slot = this->offsets_[start]; slot < this->offsets_[start + 1]; slot++ )
+      {
+        if ( used[slot] )
+        {
+          continue;
+        }
+
+        // walk along this link until a branch or end node is reached
+        std::vector<int> segment;
+        segment.push_back( start );
+
+        int prev = start;
+        int current_slot = slot;
+
+        while ( true )
+        {
+          int current = this->neighbors_[current_slot];
+          used[current_slot] = 1;
+
+          // mark the reverse direction
+          for ( int k = this->offsets_[current]; k < this->offsets_[current + 1]; k++ )
+          {
+            if ( this->neighbors_[k] == prev )
+            {
+              used[k] = 1;
+              break;
+            }
+          }
+
+          segment.push_back( current );
+
+          if ( current == start || this->get_degree( current ) != 2 )
+          {
+            break;
+          }
+
+          // continue through the other link of this pass-through node
+          int next_slot = this->offsets_[current];
+          if ( this->neighbors_[next_slot] == prev )
+          {
+            next_slot++;
+          }
+
+          if ( used[next_slot] )
+          {
+            break;
+          }
+
+          prev = current;
+          current_slot = next_slot;
+        }
+
+        this->segments_.push_back( segment );
+      }
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef VIKING_DATA_SKELETONGRAPH_H
+#define VIKING_DATA_SKELETONGRAPH_H
+
+#include <vector>
+
+#include <Data/Structure.h>
+
+//! Compact, index based copy of a structure's node/link graph
+/*!
+ * The NodeMap is convenient for loading and culling, but every lookup goes
+ * through a hash and a shared pointer.  The SkeletonGraph stores the same
+ * nodes in flat arrays with adjacency in compressed (CSR) form so that the
+ * analysis and meshing code can walk the skeleton linearly.
+ */
+class SkeletonGraph
+{
+
+public:
+  SkeletonGraph();
+  ~SkeletonGraph();
+
+  /// rebuild from a structure's node map (duplicate and dangling links are dropped)
+  void build( const NodeMap &node_map );
+
+  void clear();
+
+  /// move a node or change its radius, the adjacency and segments stay as they are
+  void set_node( int index, double x, double y, double z, double radius );
+
+  int get_num_nodes() const { return (int)this->ids_.size(); }
+
+  /// index of a node id, or -1 if it is not part of the graph
+  int get_index( long id ) const;
+
+  long get_id( int index ) const { return this->ids_[index]; }
+
+  const double* get_position( int index ) const { return &this->positions_[3 * index]; }
+
+  double get_radius( int index ) const { return this->radii_[index]; }
+
+  int get_degree( int index ) const { return this->offsets_[index + 1] - this->offsets_[index]; }
+
+  int get_neighbor( int index, int i ) const { return this->neighbors_[this->offsets_[index] + i]; }
+
+  /// number of undirected links
+  int get_num_links() const { return (int)this->neighbors_.size() / 2; }
+
+  /// unbranched segments, each running from a branch/end node to a branch/end node
+  const std::vector< std::vector<int> >& get_segments() const { return this->segments_; }
+
+  /// distance between two nodes
+  double distance( int a, int b ) const;
+
+private:
+
+  void build_segments();
+
+  std::vector<long>   ids_;
+  std::vector<double> positions_;
+  std::vector<double> radii_;
+  std::vector<int>    offsets_;
+  std::vector<int>    neighbors_;
+
+  QHash<long, int> index_map_;
+
+  std::vector< std::vector<int> > segments_;
+};
+
+#endif /* VIKING_DATA_SKELETONGRAPH_H */
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cmath>
+
+#include <Data/SkeletonLOD.h>
+#include <Data/SkeletonGraph.h>
+
+//-----------------------------------------------------------------------------
+std::vector<double> SkeletonLOD::get_default_tolerances()
+{
+  std::vector<double> tolerances;
+  tolerances.push_back( 0.0 );
+  tolerances.push_back( 0.05 );
+  tolerances.push_back( 0.25 );
+  tolerances.push_back( 1.0 );
+  return tolerances;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<SkeletonLevel> SkeletonLOD::build_levels( const SkeletonGraph &graph,
+                                                      const std::vector<double> &tolerances )
+{
+  std::vector<SkeletonLevel> levels;
+  levels.reserve( tolerances.size() );
+  for ( unsigned int i = 0; i < tolerances.size(); i++ )
+  {
+    levels.push_back( SkeletonLOD::simplify( graph, tolerances[i] ) );
+  }
+  return levels;
+}
+
+//-----------------------------------------------------------------------------
+SkeletonLevel SkeletonLOD::simplify( const SkeletonGraph &graph, double tolerance )
+{
+  SkeletonLevel level;
+  level.tolerance = tolerance;
+
+  const std::vector< std::vector<int> > &segments = graph.get_segments();
+  level.segments.resize( segments.size() );
+
+  std::vector<char> kept( graph.get_num_nodes(), 0 );
+
+  for ( unsigned int i = 0; i < segments.size(); i++ )
+  {
+    if ( tolerance <= 0 )
+    {
+      level.segments[i] = segments[i];
+    }
+    else
+    {
+      SkeletonLOD::simplify_segment( graph, segments[i], tolerance, level.segments[i] );
+    }
+
+    for ( unsigned int j = 0; j < level.segments[i].size(); j++ )
+    {
+      kept[level.segments[i][j]] = 1;
+    }
+  }
+
+  // isolated nodes have no segment but are still drawn
+  level.num_nodes = 0;
+  for ( int i = 0; i < graph.get_num_nodes(); i++ )
+  {
+    if ( kept[i] || graph.get_degree( i ) == 0 )
+    {
+      level.num_nodes++;
+    }
+  }
+
+  return level;
+}
+
+//-----------------------------------------------------------------------------
+double SkeletonLOD::get_error( const SkeletonGraph &graph, int first, int last, int node )
+{
+  const double* a = graph.get_position( first );
+  const double* b = graph.get_position( last );
+  const double* p = graph.get_position( node );
+
+  double ab[3], ap[3];
+  for ( int i = 0; i < 3; i++ )
+  {
+    ab[i] = b[i] - a[i];
+    ap[i] = p[i] - a[i];
+  }
+
+  double length2 = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+
+  // parameter of the closest point on the chord
+  double t = 0;
+  if ( length2 > 0 )
+  {
+    t = ( ap[0] * ab[0] + ap[1] * ab[1] + ap[2] * ab[2] ) / length2;
+    t = std::max( 0.0, std::min( 1.0, t ) );
+  }
+
+  double d2 = 0;
+  for ( int i = 0; i < 3; i++ )
+  {
+    double d = ap[i] - t * ab[i];
+    d2 += d * d;
+  }
+
+  double radius = graph.get_radius( first ) * ( 1 - t ) + graph.get_radius( last ) * t;
+  double radius_error = fabs( graph.get_radius( node ) - radius );
+
+  return std::max( sqrt( d2 ), radius_error );
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonLOD::simplify_segment( const SkeletonGraph &graph, const std::vector<int> &segment,
+                                    double tolerance, std::vector<int> &simplified )
+{
+  int size = (int)segment.size();
+  simplified.clear();
+
+  if ( size <= 2 )
+  {
+    simplified = segment;
+    return;
+  }
+
+  std::vector<char> keep( size, 0 );
+  keep[0] = 1;
+  keep[size - 1] = 1;
+
+  // explicit stack of [first, last] ranges instead of recursion, segments can be long
+  std::vector<std::pair<int, int> > ranges;
+  ranges.push_back( std::make_pair( 0, size - 1 ) );
+
+  while ( !ranges.empty() )
+  {
+    int first = ranges.back().first;
+    int last = ranges.back().second;
+    ranges.pop_back();
+
+    double max_error = 0;
+    int max_index = -1;
+    for ( int i = first + 1; i < last; i++ )
+    {
+      double error = SkeletonLOD::get_error( graph, segment[first], segment[last], segment[i] );
+      if ( error > max_error )
+      {
+        max_error = error;
+        max_index = i;
+      }
+    }
+
+    // a closed loop always keeps its farthest node so it does not collapse to a point
+    bool closed = ( first == 0 && last == size - 1 && segment[first] == segment[last] );
+
+    if ( max_index != -1 && ( max_error > tolerance || closed ) )
+    {
+      keep[max_index] = 1;
+      ranges.push_back( std::make_pair( first, max_index ) );
+      ranges.push_back( std::make_pair( max_index, last ) );
+    }
+  }
+
+  for ( int i = 0; i < size; i++ )
+  {
+    if ( keep[i] )
+    {
+      simplified.push_back( segment[i] );
+    }
+  }
+}
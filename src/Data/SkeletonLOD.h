@@ -0,0 +1,52 @@
+#ifndef VIKING_DATA_SKELETONLOD_H
+#define VIKING_DATA_SKELETONLOD_H
+
+#include <vector>
+
+class SkeletonGraph;
+
+//! One simplified version of a structure's skeleton
+class SkeletonLevel
+{
+public:
+  /// position and radius tolerance used to build this level
+  double tolerance;
+
+  /// simplified segments, as node indices into the SkeletonGraph
+  std::vector< std::vector<int> > segments;
+
+  /// number of distinct nodes kept
+  int num_nodes;
+};
+
+//! Builds skeleton levels of detail
+/*!
+ * Each unbranched segment is simplified with a Douglas-Peucker pass that
+ * measures both the distance of a node from the simplified chord and the
+ * difference between its radius and the radius interpolated along the chord.
+ * Branch and end nodes are always kept, so the topology of every level
+ * matches the full skeleton.
+ */
+class SkeletonLOD
+{
+
+public:
+
+  /// build one level per tolerance (a tolerance of zero keeps every node)
+  static std::vector<SkeletonLevel> build_levels( const SkeletonGraph &graph,
+                                                  const std::vector<double> &tolerances );
+
+  static SkeletonLevel simplify( const SkeletonGraph &graph, double tolerance );
+
+  /// full detail followed by progressively coarser tolerances (in microns)
+  static std::vector<double> get_default_tolerances();
+
+private:
+
+  static void simplify_segment( const SkeletonGraph &graph, const std::vector<int> &segment,
+                                double tolerance, std::vector<int> &simplified );
+
+  static double get_error( const SkeletonGraph &graph, int first, int last, int node );
+};
+
+#endif /* VIKING_DATA_SKELETONLOD_H */
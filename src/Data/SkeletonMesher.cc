@@ -0,0 +1,820 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <QtConcurrentMap>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkCellArray.h>
+#include <vtkPointData.h>
+#include <vtkMath.h>
+
+#include <Data/SkeletonMesher.h>
+#include <Data/SkeletonGraph.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//-----------------------------------------------------------------------------
+void MeshBuffer::resize( int num_points, int num_triangles )
+{
+  this->points.resize( 3 * num_points );
+  this->normals.resize( 3 * num_points );
+  this->triangles.resize( 3 * num_triangles );
+}
+
+//-----------------------------------------------------------------------------
+void MeshBuffer::clear()
+{
+  this->points.clear();
+  this->normals.clear();
+  this->triangles.clear();
+}
+
+//-----------------------------------------------------------------------------
+void MeshBuffer::compute_normals()
+{
+  // the cross product of two edges is twice the area along the normal
+  std::vector<double> sums( this->points.size(), 0.0 );
+  for ( int i = 0; i < this->get_num_triangles(); i++ )
+  {
+    const int* triangle = &this->triangles[3 * i];
+    const double* a = &this->points[3 * triangle[0]];
+    const double* b = &this->points[3 * triangle[1]];
+    const double* c = &this->points[3 * triangle[2]];
+    double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    double v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+    for ( int j = 0; j < 3; j++ )
+    {
+      for ( int k = 0; k < 3; k++ )
+      {
+        sums[3 * triangle[j] + k] += n[k];
+      }
+    }
+  }
+
+  this->normals.resize( sums.size() );
+  for ( int i = 0; i < this->get_num_points(); i++ )
+  {
+    const double* n = &sums[3 * i];
+    double length = sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+    for ( int k = 0; k < 3; k++ )
+    {
+      this->normals[3 * i + k] = (float)( length > 0 ? n[k] / length : 0.0 );
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+SkeletonMesher::SkeletonMesher()
+{
+  this->tolerance_ = 0.01;
+  this->min_sides_ = 6;
+  this->max_sides_ = 32;
+  this->sphere_scale_ = 1.05;
+  this->samples_per_node_ = 2;
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::set_tolerance( double tolerance )
+{
+  this->tolerance_ = tolerance;
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::set_side_limits( int min_sides, int max_sides )
+{
+  this->min_sides_ = std::max( 4, min_sides );
+  this->max_sides_ = std::max( this->min_sides_, max_sides );
+}
+
+//-----------------------------------------------------------------------------
+int SkeletonMesher::get_num_sides( double radius ) const
+{
+  if ( this->tolerance_ <= 0 )
+  {
+    return this->max_sides_;
+  }
+
+  if ( this->tolerance_ >= radius )
+  {
+    return this->min_sides_;
+  }
+
+  int sides = (int)ceil( M_PI / acos( 1.0 - this->tolerance_ / radius ) );
+  return std::max( this->min_sides_, std::min( this->max_sides_, sides ) );
+}
+
+//-----------------------------------------------------------------------------
+int SkeletonMesher::get_phi_resolution( int sides )
+{
+  // phi steps over half a turn, theta over a full one
+  return ( sides + 1 ) / 2 + 1;
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::set_sphere_scale( double scale )
+{
+  this->sphere_scale_ = scale;
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::set_samples_per_node( int samples )
+{
+  this->samples_per_node_ = std::max( 1, samples );
+}
+
+//-----------------------------------------------------------------------------
+MeshBuffer SkeletonMesher::generate( const SkeletonGraph &graph ) const
+{
+  return this->generate( graph, graph.get_segments() );
+}
+
+//-----------------------------------------------------------------------------
+MeshBuffer SkeletonMesher::generate( const SkeletonGraph &graph,
+                                     const std::vector< std::vector<int> > &segments ) const
+{
+  MeshBuffer mesh;
+
+  MeshPiece piece;
+  piece.mesher = this;
+  piece.graph = &graph;
+  piece.mesh = &mesh;
+  piece.segment = 0;
+  piece.num_samples = 0;
+
+  // count pass, the offsets are an exclusive prefix sum of the counts
+  std::vector<MeshPiece> pieces;
+  pieces.reserve( segments.size() + graph.get_num_nodes() / 2 );
+
+  int num_points = 0;
+  int num_triangles = 0;
+
+  for ( int i = 0; i < graph.get_num_nodes(); i++ )
+  {
+    if ( graph.get_degree( i ) != 2 )
+    {
+      piece.node = i;
+      piece.sides = this->get_sphere_sides( graph, i );
+      piece.first_point = num_points;
+      piece.first_triangle = num_triangles;
+      pieces.push_back( piece );
+
+      int points, triangles;
+      SkeletonMesher::get_sphere_counts( piece.sides, points, triangles );
+      num_points += points;
+      num_triangles += triangles;
+    }
+  }
+
+  piece.node = -1;
+  for ( unsigned int i = 0; i < segments.size(); i++ )
+  {
+    int samples = this->get_num_samples( graph, segments[i] );
+    if ( samples < 2 )
+    {
+      continue;
+    }
+
+    piece.segment = &segments[i];
+    piece.num_samples = samples;
+    piece.sides = this->get_tube_sides( graph, segments[i] );
+    piece.first_point = num_points;
+    piece.first_triangle = num_triangles;
+    pieces.push_back( piece );
+
+    int points, triangles;
+    SkeletonMesher::get_tube_counts( samples, piece.sides, points, triangles );
+    num_points += points;
+    num_triangles += triangles;
+  }
+
+  mesh.resize( num_points, num_triangles );
+
+  // fill pass, every piece writes only its own range (small skeletons are not worth the scheduling)
+  if ( num_points < 100000 )
+  {
+    for ( unsigned int i = 0; i < pieces.size(); i++ )
+    {
+      SkeletonMesher::fill_piece( pieces[i] );
+    }
+  }
+  else
+  {
+    QtConcurrent::blockingMap( pieces, SkeletonMesher::fill_piece );
+  }
+
+  return mesh;
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::get_sphere_size( const SkeletonGraph &graph, int node, int &num_points, int &num_triangles ) const
+{
+  SkeletonMesher::get_sphere_counts( this->get_sphere_sides( graph, node ), num_points, num_triangles );
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::get_tube_size( const SkeletonGraph &graph, const std::vector<int> &segment, int &num_points,
+                                    int &num_triangles ) const
+{
+  int samples = this->get_num_samples( graph, segment );
+  if ( samples < 2 )
+  {
+    num_points = 0;
+    num_triangles = 0;
+    return;
+  }
+  SkeletonMesher::get_tube_counts( samples, this->get_tube_sides( graph, segment ), num_points, num_triangles );
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::write_sphere( const SkeletonGraph &graph, int node, MeshBuffer &mesh, int first_point,
+                                   int first_triangle ) const
+{
+  this->add_sphere( graph, node, this->get_sphere_sides( graph, node ), mesh, first_point, first_triangle );
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::write_tube( const SkeletonGraph &graph, const std::vector<int> &segment, MeshBuffer &mesh,
+                                 int first_point, int first_triangle ) const
+{
+  int samples = this->get_num_samples( graph, segment );
+  if ( samples < 2 )
+  {
+    return;
+  }
+  this->add_tube( graph, segment, samples, this->get_tube_sides( graph, segment ), mesh, first_point,
+                  first_triangle );
+}
+
+//-----------------------------------------------------------------------------
+int SkeletonMesher::get_sphere_sides( const SkeletonGraph &graph, int node ) const
+{
+  return this->get_num_sides( graph.get_radius( node ) * this->sphere_scale_ );
+}
+
+//-----------------------------------------------------------------------------
+int SkeletonMesher::get_tube_sides( const SkeletonGraph &graph, const std::vector<int> &segment ) const
+{
+  // one resolution per segment, from its thickest node
+  double radius = 0;
+  for ( unsigned int i = 0; i < segment.size(); i++ )
+  {
+    radius = std::max( radius, graph.get_radius( segment[i] ) );
+  }
+  return this->get_num_sides( radius );
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::get_sphere_counts( int sides, int &num_points, int &num_triangles )
+{
+  int phi = SkeletonMesher::get_phi_resolution( sides );
+  num_points = 2 + sides * ( phi - 2 );
+  num_triangles = 2 * sides + 2 * sides * ( phi - 3 );
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::get_tube_counts( int num_samples, int sides, int &num_points, int &num_triangles )
+{
+  // rings plus two cap rings, sides plus caps
+  num_points = ( num_samples + 2 ) * sides;
+  num_triangles = 2 * ( num_samples - 1 ) * sides + 2 * ( sides - 2 );
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::fill_piece( MeshPiece &piece )
+{
+  if ( piece.node != -1 )
+  {
+    piece.mesher->add_sphere( *piece.graph, piece.node, piece.sides, *piece.mesh,
+                              piece.first_point, piece.first_triangle );
+  }
+  else
+  {
+    piece.mesher->add_tube( *piece.graph, *piece.segment, piece.num_samples, piece.sides, *piece.mesh,
+                            piece.first_point, piece.first_triangle );
+  }
+}
+
+//-----------------------------------------------------------------------------
+int SkeletonMesher::get_num_samples( const SkeletonGraph &graph, const std::vector<int> &segment ) const
+{
+  if ( segment.size() < 2 )
+  {
+    return 0;
+  }
+
+  // a segment whose nodes all sit on the same spot has no tube
+  const double* first = graph.get_position( segment[0] );
+  bool moves = false;
+  for ( unsigned int i = 1; i < segment.size() && !moves; i++ )
+  {
+    const double* p = graph.get_position( segment[i] );
+    moves = ( p[0] != first[0] || p[1] != first[1] || p[2] != first[2] );
+  }
+  if ( !moves )
+  {
+    return 0;
+  }
+
+  // the same count vtkParametricFunctionSource produced (resolution + 1)
+  return this->samples_per_node_ * (int)segment.size() + 1;
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::add_sphere( const SkeletonGraph &graph, int node, int sides, MeshBuffer &mesh,
+                                 int first_point, int first_triangle ) const
+{
+  // same point order and connectivity as vtkSphereSource (full sphere, no lat/long tessellation)
+  const double* center = graph.get_position( node );
+  double radius = graph.get_radius( node ) * this->sphere_scale_;
+
+  int theta_resolution = sides;
+  int phi_resolution = SkeletonMesher::get_phi_resolution( sides );
+
+  double* points = &mesh.points[3 * first_point];
+  float* normals = &mesh.normals[3 * first_point];
+  int* triangles = &mesh.triangles[3 * first_triangle];
+
+  // poles
+  points[0] = center[0];
+  points[1] = center[1];
+  points[2] = center[2] + radius;
+  normals[0] = 0;
+  normals[1] = 0;
+  normals[2] = 1;
+
+  points[3] = center[0];
+  points[4] = center[1];
+  points[5] = center[2] - radius;
+  normals[3] = 0;
+  normals[4] = 0;
+  normals[5] = -1;
+
+  int count = 2;
+
+  double delta_theta = 2.0 * M_PI / theta_resolution;
+  double delta_phi = M_PI / ( phi_resolution - 1 );
+
+  for ( int i = 0; i < theta_resolution; i++ )
+  {
+    double theta = i * delta_theta;
+    for ( int j = 1; j < phi_resolution - 1; j++ )
+    {
+      double phi = j * delta_phi;
+      double n[3] = { sin( phi ) * cos( theta ), sin( phi ) * sin( theta ), cos( phi ) };
+      for ( int k = 0; k < 3; k++ )
+      {
+        points[3 * count + k] = center[k] + radius * n[k];
+        normals[3 * count + k] = (float)n[k];
+      }
+      count++;
+    }
+  }
+
+  int ring = phi_resolution - 2;
+  int base = ring * theta_resolution;
+  int num_poles = 2;
+
+  int t = 0;
+
+  // around north pole
+  for ( int i = 0; i < theta_resolution; i++ )
+  {
+    triangles[t++] = first_point + ring * i + num_poles;
+    triangles[t++] = first_point + ( ring * ( i + 1 ) ) % base + num_poles;
+    triangles[t++] = first_point + 0;
+  }
+
+  // around south pole
+  int offset = ring - 1 + num_poles;
+  for ( int i = 0; i < theta_resolution; i++ )
+  {
+    triangles[t++] = first_point + ring * i + offset;
+    triangles[t++] = first_point + 1;
+    triangles[t++] = first_point + ( ring * ( i + 1 ) ) % base + offset;
+  }
+
+  // bands in between
+  for ( int i = 0; i < theta_resolution; i++ )
+  {
+    for ( int j = 0; j < ring - 1; j++ )
+    {
+      int a = ring * i + j + num_poles;
+      int b = a + 1;
+      int c = ( ring * ( i + 1 ) + j ) % base + num_poles + 1;
+
+      triangles[t++] = first_point + a;
+      triangles[t++] = first_point + b;
+      triangles[t++] = first_point + c;
+
+      triangles[t++] = first_point + a;
+      triangles[t++] = first_point + c;
+      triangles[t++] = first_point + c - 1;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::sample_segment( const SkeletonGraph &graph, const std::vector<int> &segment, int num_samples,
+                                     std::vector<double> &positions, std::vector<double> &radii )
+{
+  int size = (int)segment.size();
+
+  // knots by accumulated chord length, repeated positions are skipped
+  std::vector<double> knots;
+  std::vector<double> values;
+  knots.reserve( size );
+  values.reserve( 3 * size );
+
+  double length = 0;
+  for ( int i = 0; i < size; i++ )
+  {
+    const double* p = graph.get_position( segment[i] );
+    if ( i > 0 )
+    {
+      double d = graph.distance( segment[i - 1], segment[i] );
+      if ( d <= 0 )
+      {
+        continue;
+      }
+      length += d;
+    }
+    knots.push_back( length );
+    values.push_back( p[0] );
+    values.push_back( p[1] );
+    values.push_back( p[2] );
+  }
+
+  int num_knots = (int)knots.size();
+
+  // first derivatives of a cubic spline with zero slope at both ends (vtkCardinalSpline's default)
+  std::vector<double> slopes( 3 * num_knots, 0 );
+  std::vector<double> diagonal( num_knots ), upper( num_knots ), rhs( num_knots );
+
+  for ( int k = 0; k < 3; k++ )
+  {
+    diagonal[0] = 1;
+    upper[0] = 0;
+    rhs[0] = 0;
+    for ( int i = 1; i < num_knots - 1; i++ )
+    {
+      double h0 = knots[i] - knots[i - 1];
+      double h1 = knots[i + 1] - knots[i];
+      double lower = h1;
+      diagonal[i] = 2.0 * ( h0 + h1 );
+      upper[i] = h0;
+      rhs[i] = 3.0 * ( h1 * ( values[3 * i + k] - values[3 * ( i - 1 ) + k] ) / h0
+                       + h0 * ( values[3 * ( i + 1 ) + k] - values[3 * i + k] ) / h1 );
+
+      // forward elimination
+      double m = lower / diagonal[i - 1];
+      diagonal[i] -= m * upper[i - 1];
+      rhs[i] -= m * rhs[i - 1];
+    }
+
+    // the last row is fixed to zero slope
+    slopes[3 * ( num_knots - 1 ) + k] = 0;
+    for ( int i = num_knots - 2; i >= 0; i-- )
+    {
+      slopes[3 * i + k] = ( rhs[i] - upper[i] * slopes[3 * ( i + 1 ) + k] ) / diagonal[i];
+    }
+  }
+
+  positions.resize( 3 * num_samples );
+  radii.resize( num_samples );
+
+  int interval = 0;
+  for ( int s = 0; s < num_samples; s++ )
+  {
+    double t = length * s / ( num_samples - 1 );
+
+    while ( interval < num_knots - 2 && t > knots[interval + 1] )
+    {
+      interval++;
+    }
+
+    double h = knots[interval + 1] - knots[interval];
+    double x = t - knots[interval];
+
+    for ( int k = 0; k < 3; k++ )
+    {
+      double y0 = values[3 * interval + k];
+      double y1 = values[3 * ( interval + 1 ) + k];
+      double m0 = slopes[3 * interval + k];
+      double m1 = slopes[3 * ( interval + 1 ) + k];
+      double delta = ( y1 - y0 ) / h;
+      double c2 = ( 3.0 * delta - 2.0 * m0 - m1 ) / h;
+      double c3 = ( m0 + m1 - 2.0 * delta ) / ( h * h );
+      positions[3 * s + k] = y0 + x * ( m0 + x * ( c2 + x * c3 ) );
+    }
+
+    // radius is interpolated by node index, not by length
+    double r = (double)( size - 1 ) * s / ( num_samples - 1 );
+    int index = std::min( (int)r, size - 2 );
+    double f = r - index;
+    radii[s] = graph.get_radius( segment[index] ) * ( 1 - f ) + graph.get_radius( segment[index + 1] ) * f;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonMesher::add_tube( const SkeletonGraph &graph, const std::vector<int> &segment, int num_samples,
+                               int sides, MeshBuffer &mesh, int first_point, int first_triangle ) const
+{
+  std::vector<double> positions;
+  std::vector<double> radii;
+  SkeletonMesher::sample_segment( graph, segment, num_samples, positions, radii );
+
+  double* points = &mesh.points[3 * first_point];
+  float* normals = &mesh.normals[3 * first_point];
+  int* triangles = &mesh.triangles[3 * first_triangle];
+
+  std::vector<double> tangents( 3 * num_samples );
+  double previous[3] = { 0, 0, 0 };
+
+  for ( int s = 0; s < num_samples; s++ )
+  {
+    double in[3] = { 0, 0, 0 };
+    double out[3] = { 0, 0, 0 };
+    for ( int k = 0; k < 3; k++ )
+    {
+      if ( s > 0 )
+      {
+        in[k] = positions[3 * s + k] - positions[3 * ( s - 1 ) + k];
+      }
+      if ( s < num_samples - 1 )
+      {
+        out[k] = positions[3 * ( s + 1 ) + k] - positions[3 * s + k];
+      }
+    }
+
+    double in_length = sqrt( in[0] * in[0] + in[1] * in[1] + in[2] * in[2] );
+    double out_length = sqrt( out[0] * out[0] + out[1] * out[1] + out[2] * out[2] );
+
+    double t[3];
+    for ( int k = 0; k < 3; k++ )
+    {
+      t[k] = ( in_length > 0 ? in[k] / in_length : 0 ) + ( out_length > 0 ? out[k] / out_length : 0 );
+    }
+
+    double length = sqrt( t[0] * t[0] + t[1] * t[1] + t[2] * t[2] );
+    if ( length <= 0 )
+    {
+      // repeated sample or a full reversal, keep going the same way
+      for ( int k = 0; k < 3; k++ )
+      {
+        t[k] = previous[k];
+      }
+    }
+    else
+    {
+      for ( int k = 0; k < 3; k++ )
+      {
+        t[k] /= length;
+      }
+    }
+
+    for ( int k = 0; k < 3; k++ )
+    {
+      tangents[3 * s + k] = t[k];
+      previous[k] = t[k];
+    }
+  }
+
+  // the first sample may still have no direction if the tube starts with repeats
+  for ( int s = num_samples - 1; s > 0; s-- )
+  {
+    double* t = &tangents[3 * ( s - 1 )];
+    if ( t[0] == 0 && t[1] == 0 && t[2] == 0 )
+    {
+      t[0] = tangents[3 * s];
+      t[1] = tangents[3 * s + 1];
+      t[2] = tangents[3 * s + 2];
+    }
+  }
+
+  // change of the radius and of the tangent per unit length, by central differences over the samples
+  std::vector<double> radius_slopes( num_samples );
+  std::vector<double> bends( 3 * num_samples );
+  for ( int s = 0; s < num_samples; s++ )
+  {
+    int s0 = std::max( s - 1, 0 );
+    int s1 = std::min( s + 1, num_samples - 1 );
+    double length = 0;
+    for ( int i = s0; i < s1; i++ )
+    {
+      length += sqrt( vtkMath::Distance2BetweenPoints( &positions[3 * i], &positions[3 * ( i + 1 )] ) );
+    }
+    radius_slopes[s] = length > 0 ? ( radii[s1] - radii[s0] ) / length : 0;
+    for ( int k = 0; k < 3; k++ )
+    {
+      bends[3 * s + k] = length > 0 ? ( tangents[3 * s1 + k] - tangents[3 * s0 + k] ) / length : 0;
+    }
+  }
+
+  // sliding normals: project the previous normal onto each new cross section
+  double normal[3] = { 0, 0, 0 };
+  for ( int s = 0; s < num_samples; s++ )
+  {
+    const double* t = &tangents[3 * s];
+
+    double d = normal[0] * t[0] + normal[1] * t[1] + normal[2] * t[2];
+    for ( int k = 0; k < 3; k++ )
+    {
+      normal[k] -= d * t[k];
+    }
+    double length = sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+
+    if ( length < 1e-6 )
+    {
+      // start (or restart) from the axis least aligned with the tangent
+      int axis = 0;
+      for ( int k = 1; k < 3; k++ )
+      {
+        if ( fabs( t[k] ) < fabs( t[axis] ) )
+        {
+          axis = k;
+        }
+      }
+      double e[3] = { 0, 0, 0 };
+      e[axis] = 1;
+      d = t[axis];
+      for ( int k = 0; k < 3; k++ )
+      {
+        normal[k] = e[k] - d * t[k];
+      }
+      length = sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+    }
+
+    for ( int k = 0; k < 3; k++ )
+    {
+      normal[k] /= length;
+    }
+
+    double binormal[3] = { t[1] * normal[2] - t[2] * normal[1],
+                           t[2] * normal[0] - t[0] * normal[2],
+                           t[0] * normal[1] - t[1] * normal[0] };
+
+    for ( int j = 0; j < sides; j++ )
+    {
+      double angle = 2.0 * M_PI * j / sides;
+      double c = cos( angle );
+      double sn = sin( angle );
+      double direction[3];
+      for ( int k = 0; k < 3; k++ )
+      {
+        direction[k] = c * normal[k] + sn * binormal[k];
+      }
+
+      // the surface normal leans back along the tangent where the radius grows, more so on the inside of a
+      // bend where the surface is compressed (1 - r * curvature); too tight a bend just keeps the radial normal
+      double stretch = 1.0 - radii[s] * vtkMath::Dot( direction, &bends[3 * s] );
+      double lean = stretch > 0.1 ? radius_slopes[s] / stretch : 0;
+      double scale = 1.0 / sqrt( 1.0 + lean * lean );
+
+      int index = s * sides + j;
+      for ( int k = 0; k < 3; k++ )
+      {
+        points[3 * index + k] = positions[3 * s + k] + radii[s] * direction[k];
+        normals[3 * index + k] = (float)( ( direction[k] - lean * t[k] ) * scale );
+      }
+    }
+  }
+
+  // caps reuse the first and last ring positions with normals along the tube
+  int start_cap = num_samples * sides;
+  int end_cap = ( num_samples + 1 ) * sides;
+  for ( int j = 0; j < sides; j++ )
+  {
+    for ( int k = 0; k < 3; k++ )
+    {
+      points[3 * ( start_cap + j ) + k] = points[3 * j + k];
+      normals[3 * ( start_cap + j ) + k] = (float)-tangents[k];
+      points[3 * ( end_cap + j ) + k] = points[3 * ( ( num_samples - 1 ) * sides + j ) + k];
+      normals[3 * ( end_cap + j ) + k] = (float)tangents[3 * ( num_samples - 1 ) + k];
+    }
+  }
+
+  int t = 0;
+  for ( int s = 0; s < num_samples - 1; s++ )
+  {
+    for ( int j = 0; j < sides; j++ )
+    {
+      int a = first_point + s * sides + j;
+      int b = first_point + s * sides + ( j + 1 ) % sides;
+      int c = a + sides;
+      int d = b + sides;
+
+      triangles[t++] = a;
+      triangles[t++] = b;
+      triangles[t++] = c;
+
+      triangles[t++] = b;
+      triangles[t++] = d;
+      triangles[t++] = c;
+    }
+  }
+
+  for ( int j = 1; j < sides - 1; j++ )
+  {
+    triangles[t++] = first_point + start_cap;
+    triangles[t++] = first_point + start_cap + j + 1;
+    triangles[t++] = first_point + start_cap + j;
+
+    triangles[t++] = first_point + end_cap;
+    triangles[t++] = first_point + end_cap + j;
+    triangles[t++] = first_point + end_cap + j + 1;
+  }
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> SkeletonMesher::create_polydata( const MeshBuffer &mesh )
+{
+  int num_points = mesh.get_num_points();
+  int num_triangles = mesh.get_num_triangles();
+
+  vtkSmartPointer<vtkDoubleArray> point_array = vtkSmartPointer<vtkDoubleArray>::New();
+  point_array->SetNumberOfComponents( 3 );
+  point_array->SetNumberOfTuples( num_points );
+  if ( num_points > 0 )
+  {
+    memcpy( point_array->GetPointer( 0 ), &mesh.points[0], sizeof( double ) * 3 * num_points );
+  }
+
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetData( point_array );
+
+  vtkSmartPointer<vtkFloatArray> normals = vtkSmartPointer<vtkFloatArray>::New();
+  normals->SetName( "Normals" );
+  normals->SetNumberOfComponents( 3 );
+  normals->SetNumberOfTuples( num_points );
+  if ( num_points > 0 )
+  {
+    memcpy( normals->GetPointer( 0 ), &mesh.normals[0], sizeof( float ) * 3 * num_points );
+  }
+
+  vtkSmartPointer<vtkIdTypeArray> cell_array = vtkSmartPointer<vtkIdTypeArray>::New();
+  cell_array->SetNumberOfTuples( 4 * num_triangles );
+  vtkIdType* cells = cell_array->GetPointer( 0 );
+  for ( int i = 0; i < num_triangles; i++ )
+  {
+    cells[4 * i] = 3;
+    cells[4 * i + 1] = mesh.triangles[3 * i];
+    cells[4 * i + 2] = mesh.triangles[3 * i + 1];
+    cells[4 * i + 3] = mesh.triangles[3 * i + 2];
+  }
+
+  vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+  polys->SetCells( num_triangles, cell_array );
+
+  vtkSmartPointer<vtkPolyData> poly_data = vtkSmartPointer<vtkPolyData>::New();
+  poly_data->SetPoints( points );
+  poly_data->SetPolys( polys );
+  poly_data->GetPointData()->SetNormals( normals );
+
+  return poly_data;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> SkeletonMesher::create_lines( const SkeletonGraph &graph,
+                                                           const std::vector< std::vector<int> > &segments )
+{
+  int num_nodes = graph.get_num_nodes();
+
+  vtkSmartPointer<vtkDoubleArray> point_array = vtkSmartPointer<vtkDoubleArray>::New();
+  point_array->SetNumberOfComponents( 3 );
+  point_array->SetNumberOfTuples( num_nodes );
+  if ( num_nodes > 0 )
+  {
+    memcpy( point_array->GetPointer( 0 ), graph.get_position( 0 ), sizeof( double ) * 3 * num_nodes );
+  }
+
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetData( point_array );
+
+  vtkSmartPointer<vtkCellArray> lines = vtkSmartPointer<vtkCellArray>::New();
+  for ( unsigned int i = 0; i < segments.size(); i++ )
+  {
+    if ( segments[i].size() < 2 )
+    {
+      continue;
+    }
+    lines->InsertNextCell( (int)segments[i].size() );
+    for ( unsigned int j = 0; j < segments[i].size(); j++ )
+    {
+      lines->InsertCellPoint( segments[i][j] );
+    }
+  }
+
+  vtkSmartPointer<vtkPolyData> poly_data = vtkSmartPointer<vtkPolyData>::New();
+  poly_data->SetPoints( points );
+  poly_data->SetLines( lines );
+
+  return poly_data;
+}
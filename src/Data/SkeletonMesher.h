@@ -0,0 +1,148 @@
+#ifndef VIKING_DATA_SKELETONMESHER_H
+#define VIKING_DATA_SKELETONMESHER_H
+
+#include <vector>
+
+#include <vtkSmartPointer.h>
+
+class vtkPolyData;
+class SkeletonGraph;
+
+//! Flat triangle mesh: xyz per point, a normal per point, three point indices per triangle
+class MeshBuffer
+{
+public:
+  std::vector<double> points;
+  std::vector<float> normals;
+  std::vector<int> triangles;
+
+  int get_num_points() const { return (int)this->points.size() / 3; }
+  int get_num_triangles() const { return (int)this->triangles.size() / 3; }
+
+  void resize( int num_points, int num_triangles );
+  void clear();
+
+  /// point normals as the area weighted averages of the triangle normals
+  void compute_normals();
+};
+
+//! Builds the sphere and tube surface of a skeleton directly into a MeshBuffer
+/*!
+ * Produces the same geometry the VTK pipeline in get_mesh_tubes() used to
+ * build: a vtkSphereSource style sphere (slightly enlarged) on every branch
+ * and end node and, for every unbranched segment, a capped tube following a
+ * clamped cubic spline through the nodes (as vtkParametricSpline) with the
+ * radius interpolated linearly between nodes (as vtkTupleInterpolator).
+ *
+ * The number of sides around each tube and sphere comes from the chordal
+ * error tolerance: a regular n-gon inscribed in a circle of radius r is at
+ * most r * (1 - cos(pi / n)) away from it, so n >= pi / acos(1 - tol / r),
+ * clamped to the side limits.  Thin processes get few sides, a soma many.
+ *
+ * Normals are written with the points: radial on the spheres, and on the
+ * tubes leaning back along the tangent by the slope of the radius (divided
+ * by the stretch of the surface around a bend), so tapering tubes shade
+ * like cones without a normals filter over the finished mesh.
+ *
+ * A first pass counts the points and triangles of every sphere and tube and
+ * a prefix sum over the counts gives each primitive its own range in one
+ * shared buffer.  The primitives are then written independently, in parallel
+ * for large skeletons, so a single big structure does not mesh on one core.
+ */
+class SkeletonMesher
+{
+
+public:
+  SkeletonMesher();
+
+  /// maximum distance between the tessellated and the true surface (0 uses the maximum resolution)
+  void set_tolerance( double tolerance );
+
+  /// bounds on the number of sides around tubes and spheres
+  void set_side_limits( int min_sides, int max_sides );
+
+  /// spheres are drawn this much larger than the node radius
+  void set_sphere_scale( double scale );
+
+  /// spline samples per node along a tube
+  void set_samples_per_node( int samples );
+
+  /// sides needed to stay within the tolerance at this radius
+  int get_num_sides( double radius ) const;
+
+  /// mesh all segments of the graph
+  MeshBuffer generate( const SkeletonGraph &graph ) const;
+
+  /// mesh the given segments (e.g. a simplified level) plus spheres on the graph's branch and end nodes
+  MeshBuffer generate( const SkeletonGraph &graph, const std::vector< std::vector<int> > &segments ) const;
+
+  /// points and triangles of the sphere on a node, and of the tube along a segment (none if it has no tube)
+  void get_sphere_size( const SkeletonGraph &graph, int node, int &num_points, int &num_triangles ) const;
+  void get_tube_size( const SkeletonGraph &graph, const std::vector<int> &segment, int &num_points,
+                      int &num_triangles ) const;
+
+  /// write one sphere or tube into a mesh that already has room for it at the given offsets
+  void write_sphere( const SkeletonGraph &graph, int node, MeshBuffer &mesh, int first_point,
+                     int first_triangle ) const;
+  void write_tube( const SkeletonGraph &graph, const std::vector<int> &segment, MeshBuffer &mesh, int first_point,
+                   int first_triangle ) const;
+
+  static vtkSmartPointer<vtkPolyData> create_polydata( const MeshBuffer &mesh );
+
+  /// the segments as polylines through the node positions
+  static vtkSmartPointer<vtkPolyData> create_lines( const SkeletonGraph &graph,
+                                                    const std::vector< std::vector<int> > &segments );
+
+private:
+
+  //! one sphere or tube and where it goes in the output
+  class MeshPiece
+  {
+  public:
+    const SkeletonMesher* mesher;
+    const SkeletonGraph* graph;
+    MeshBuffer* mesh;
+
+    /// node for a sphere, -1 for a tube
+    int node;
+    const std::vector<int>* segment;
+    int num_samples;
+
+    /// sides around the tube, or theta resolution of the sphere
+    int sides;
+
+    int first_point;
+    int first_triangle;
+  };
+
+  static void fill_piece( MeshPiece &piece );
+
+  int get_num_samples( const SkeletonGraph &graph, const std::vector<int> &segment ) const;
+
+  int get_sphere_sides( const SkeletonGraph &graph, int node ) const;
+  int get_tube_sides( const SkeletonGraph &graph, const std::vector<int> &segment ) const;
+
+  static void get_sphere_counts( int sides, int &num_points, int &num_triangles );
+  static void get_tube_counts( int num_samples, int sides, int &num_points, int &num_triangles );
+
+  /// phi resolution that gives the meridians about the same spacing as the sides
+  static int get_phi_resolution( int sides );
+
+  void add_sphere( const SkeletonGraph &graph, int node, int sides, MeshBuffer &mesh,
+                   int first_point, int first_triangle ) const;
+
+  void add_tube( const SkeletonGraph &graph, const std::vector<int> &segment, int num_samples, int sides,
+                 MeshBuffer &mesh, int first_point, int first_triangle ) const;
+
+  /// sample positions (clamped cubic spline by chord length) and radii (linear by node index)
+  static void sample_segment( const SkeletonGraph &graph, const std::vector<int> &segment, int num_samples,
+                              std::vector<double> &positions, std::vector<double> &radii );
+
+  double tolerance_;
+  int min_sides_;
+  int max_sides_;
+  double sphere_scale_;
+  int samples_per_node_;
+};
+
+#endif /* VIKING_DATA_SKELETONMESHER_H */
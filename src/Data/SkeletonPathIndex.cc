@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <utility>
+
+#include <Data/SkeletonPathIndex.h>
+#include <Data/SkeletonGraph.h>
+#include <Data/Morphometrics.h>
+
+//-----------------------------------------------------------------------------
+SkeletonPathIndex::SkeletonPathIndex()
+{}
+
+//-----------------------------------------------------------------------------
+void SkeletonPathIndex::clear()
+{
+  this->path_lengths_.clear();
+  this->components_.clear();
+  this->first_visit_.clear();
+  this->tour_.clear();
+  this->depths_.clear();
+  this->sparse_table_.clear();
+  this->log_table_.clear();
+}
+
+//-----------------------------------------------------------------------------
+void SkeletonPathIndex::build( const SkeletonGraph &graph )
+{
+  this->clear();
+
+  int num_nodes = graph.get_num_nodes();
+  if ( num_nodes == 0 )
+  {
+    return;
+  }
+
+  this->path_lengths_.resize( num_nodes, 0 );
+  this->components_.resize( num_nodes, -1 );
+  this->first_visit_.resize( num_nodes, -1 );
+
+  // each component contributes 2 * size - 1 entries
+  this->tour_.reserve( 2 * num_nodes );
+  this->depths_.reserve( 2 * num_nodes );
+
+  std::vector<int> depth( num_nodes, 0 );
+
+  // stack of (node, next neighbor to look at)
+  std::vector<std::pair<int, int> > stack;
+  stack.reserve( num_nodes );
+
+  int root = Morphometrics::find_root( graph );
+  int num_components = 0;
+
+  for ( int start = -1; start < num_nodes; start++ )
+  {
+    int seed = ( start == -1 ) ? root : start;
+    if ( this->components_[seed] != -1 )
+    {
+      continue;
+    }
+
+    this->components_[seed] = num_components;
+    this->first_visit_[seed] = (int)this->tour_.size();
+    this->tour_.push_back( seed );
+    this->depths_.push_back( 0 );
+    stack.push_back( std::make_pair( seed, 0 ) );
+
+    while ( !stack.empty() )
+    {
+      int node = stack.back().first;
+      int &next = stack.back().second;
+
+      if ( next < graph.get_degree( node ) )
+      {
+        int child = graph.get_neighbor( node, next );
+        next++;
+
+        if ( this->components_[child] != -1 )
+        {
+          continue;
+        }
+
+        this->components_[child] = num_components;
+        this->path_lengths_[child] = this->path_lengths_[node] + graph.distance( node, child );
+        depth[child] = depth[node] + 1;
+
+        this->first_visit_[child] = (int)this->tour_.size();
+        this->tour_.push_back( child );
+        this->depths_.push_back( depth[child] );
+        stack.push_back( std::make_pair( child, 0 ) );
+      }
+      else
+      {
+        stack.pop_back();
+
+        // back at the parent
+        if ( !stack.empty() )
+        {
+          int parent = stack.back().first;
+          this->tour_.push_back( parent );
+          this->depths_.push_back( depth[parent] );
+        }
+      }
+    }
+
+    num_components++;
+  }
+
+  // sparse table over the tour depths
+  int size = (int)this->tour_.size();
+
+  this->log_table_.resize( size + 1, 0 );
+  for ( int i = 2; i <= size; i++ )
+  {
+    this->log_table_[i] = this->log_table_[i / 2] + 1;
+  }
+
+  int levels = this->log_table_[size] + 1;
+  this->sparse_table_.resize( levels );
+
+  this->sparse_table_[0].resize( size );
+  for ( int i = 0; i < size; i++ )
+  {
+    this->sparse_table_[0][i] = i;
+  }
+
+  for ( int k = 1; k < levels; k++ )
+  {
+    int half = 1 << ( k - 1 );
+    int count = size - ( 1 << k ) + 1;
+    std::vector<int> &row = this->sparse_table_[k];
+    const std::vector<int> &previous = this->sparse_table_[k - 1];
+    row.resize( count );
+    for ( int i = 0; i < count; i++ )
+    {
+      int left = previous[i];
+      int right = previous[i + half];
+      row[i] = ( this->depths_[left] <= this->depths_[right] ) ? left : right;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+int SkeletonPathIndex::query_minimum( int first, int last ) const
+{
+  int k = this->log_table_[last - first + 1];
+  int left = this->sparse_table_[k][first];
+  int right = this->sparse_table_[k][last - ( 1 << k ) + 1];
+  return ( this->depths_[left] <= this->depths_[right] ) ? left : right;
+}
+
+//-----------------------------------------------------------------------------
+int SkeletonPathIndex::get_common_ancestor( int a, int b ) const
+{
+  if ( a < 0 || b < 0 || a >= (int)this->components_.size() || b >= (int)this->components_.size() )
+  {
+    return -1;
+  }
+
+  if ( this->components_[a] != this->components_[b] )
+  {
+    return -1;
+  }
+
+  int first = this->first_visit_[a];
+  int last = this->first_visit_[b];
+  if ( first > last )
+  {
+    std::swap( first, last );
+  }
+
+  return this->tour_[this->query_minimum( first, last )];
+}
+
+//-----------------------------------------------------------------------------
+double SkeletonPathIndex::get_distance( int a, int b ) const
+{
+  int ancestor = this->get_common_ancestor( a, b );
+  if ( ancestor == -1 )
+  {
+    return -1;
+  }
+
+  return this->path_lengths_[a] + this->path_lengths_[b] - 2.0 * this->path_lengths_[ancestor];
+}
+
+//-----------------------------------------------------------------------------
+double SkeletonPathIndex::get_distance_by_id( const SkeletonGraph &graph, long id_a, long id_b ) const
+{
+  return this->get_distance( graph.get_index( id_a ), graph.get_index( id_b ) );
+}
+
+//-----------------------------------------------------------------------------
+std::vector<double> SkeletonPathIndex::get_distance_matrix( const SkeletonGraph &graph,
+                                                            const std::vector<long> &ids ) const
+{
+  int n = (int)ids.size();
+
+  std::vector<int> indices( n );
+  for ( int i = 0; i < n; i++ )
+  {
+    indices[i] = graph.get_index( ids[i] );
+  }
+
+  std::vector<double> matrix( n * n, 0 );
+  for ( int i = 0; i < n; i++ )
+  {
+    if ( indices[i] == -1 )
+    {
+      for ( int j = 0; j < n; j++ )
+      {
+        matrix[i * n + j] = -1;
+        matrix[j * n + i] = -1;
+      }
+      continue;
+    }
+
+    for ( int j = i + 1; j < n; j++ )
+    {
+      double d = this->get_distance( indices[i], indices[j] );
+      matrix[i * n + j] = d;
+      matrix[j * n + i] = d;
+    }
+  }
+
+  return matrix;
+}
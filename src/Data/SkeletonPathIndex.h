@@ -0,0 +1,63 @@
+#ifndef VIKING_DATA_SKELETONPATHINDEX_H
+#define VIKING_DATA_SKELETONPATHINDEX_H
+
+#include <vector>
+
+class SkeletonGraph;
+
+//! Path length along the skeleton between any two nodes
+/*!
+ * The skeleton is walked once from the root to record an Euler tour, the
+ * depth of every tour entry and the path length from the root to every node.
+ * A sparse table over the tour depths answers lowest common ancestor queries
+ * in constant time, so the distance between two nodes is
+ *
+ *   path(a) + path(b) - 2 * path(lca(a, b))
+ *
+ * If the skeleton has loops the walk follows a spanning tree and the
+ * remaining links are not used.
+ */
+class SkeletonPathIndex
+{
+
+public:
+  SkeletonPathIndex();
+
+  /// rebuild for a skeleton, walking from the node with the largest radius
+  void build( const SkeletonGraph &graph );
+
+  void clear();
+
+  /// path length between two node indices, -1 if they are not connected
+  double get_distance( int a, int b ) const;
+
+  /// path length between two node ids, -1 if either is missing or they are not connected
+  double get_distance_by_id( const SkeletonGraph &graph, long id_a, long id_b ) const;
+
+  /// lowest common ancestor of two node indices, -1 if they are not connected
+  int get_common_ancestor( int a, int b ) const;
+
+  /// path length from the root of the node's component
+  double get_path_length( int index ) const { return this->path_lengths_[index]; }
+
+  /// all pairs distances between the given node ids, row major (n x n)
+  std::vector<double> get_distance_matrix( const SkeletonGraph &graph, const std::vector<long> &ids ) const;
+
+private:
+
+  /// position in the tour with the smallest depth in [first, last]
+  int query_minimum( int first, int last ) const;
+
+  std::vector<double> path_lengths_;
+  std::vector<int> components_;
+  std::vector<int> first_visit_;
+
+  std::vector<int> tour_;
+  std::vector<int> depths_;
+
+  /// sparse_table_[k][i] is the tour position of the minimum depth in [i, i + 2^k)
+  std::vector< std::vector<int> > sparse_table_;
+  std::vector<int> log_table_;
+};
+
+#endif /* VIKING_DATA_SKELETONPATHINDEX_H */
@@ -0,0 +1,104 @@
+#include <CGAL/Inverse_index.h>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkTimerLog.h>
+
+#include <Data/SkinMesher.h>
+#include <Data/PointSampler.h>
+#include <Data/Structure.h>
+
+//-----------------------------------------------------------------------------
+SkinMeshStats::SkinMeshStats()
+{
+  this->num_balls = 0;
+  this->num_triangles = 0;
+  this->sample_time = 0;
+  this->mesh_time = 0;
+}
+
+//-----------------------------------------------------------------------------
+SkinMesher::SkinMesher()
+{
+  this->ball_spacing_ = 0.5;
+}
+
+//-----------------------------------------------------------------------------
+void SkinMesher::set_ball_spacing( double spacing )
+{
+  this->ball_spacing_ = spacing;
+}
+
+//-----------------------------------------------------------------------------
+const SkinMeshStats& SkinMesher::get_stats() const
+{
+  return this->stats_;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> SkinMesher::generate( Structure* structure )
+{
+  this->stats_ = SkinMeshStats();
+
+  double start_time = vtkTimerLog::GetUniversalTime();
+
+  PointSampler sampler( structure );
+  // no floor: the union is only connected if neighbouring balls overlap
+  sampler.set_ball_spacing( this->ball_spacing_, 0 );
+  std::list<Weighted_point> spheres = sampler.collect_spheres();
+
+  if ( spheres.empty() )
+  {
+    return vtkSmartPointer<vtkPolyData>::New();
+  }
+
+  this->stats_.num_balls = (int)spheres.size();
+  this->stats_.sample_time = vtkTimerLog::GetUniversalTime() - start_time;
+  start_time = vtkTimerLog::GetUniversalTime();
+
+  // the union of balls builds its own (sequential) regular triangulation, which leaves out covered balls
+  Union_of_balls_3 union_of_balls( spheres.begin(), spheres.end() );
+  Polyhedron polyhedron;
+  CGAL::mesh_union_of_balls_3( union_of_balls, polyhedron );
+
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetNumberOfPoints( polyhedron.size_of_vertices() );
+  vtkIdType id = 0;
+  for ( Polyhedron::Vertex_const_iterator it = polyhedron.vertices_begin(); it != polyhedron.vertices_end(); ++it )
+  {
+    points->SetPoint( id++, CGAL::to_double( it->point().x() ), CGAL::to_double( it->point().y() ),
+                      CGAL::to_double( it->point().z() ) );
+  }
+
+  CGAL::Inverse_index<Polyhedron::Vertex_const_iterator> index( polyhedron.vertices_begin(),
+                                                                polyhedron.vertices_end() );
+
+  vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+  for ( Polyhedron::Facet_const_iterator it = polyhedron.facets_begin(); it != polyhedron.facets_end(); ++it )
+  {
+    polys->InsertNextCell( (int)it->facet_degree() );
+    Polyhedron::Halfedge_around_facet_const_circulator edge = it->facet_begin();
+    do
+    {
+      polys->InsertCellPoint( index[Polyhedron::Vertex_const_iterator( edge->vertex() )] );
+    }
+    while ( ++edge != it->facet_begin() );
+  }
+
+  vtkSmartPointer<vtkPolyData> poly_data = vtkSmartPointer<vtkPolyData>::New();
+  poly_data->SetPoints( points );
+  poly_data->SetPolys( polys );
+
+  vtkSmartPointer<vtkPolyDataNormals> normals = vtkSmartPointer<vtkPolyDataNormals>::New();
+  normals->SetInputData( poly_data );
+  normals->SplittingOff();
+  normals->Update();
+  poly_data = normals->GetOutput();
+
+  this->stats_.num_triangles = (int)poly_data->GetNumberOfPolys();
+  this->stats_.mesh_time = vtkTimerLog::GetUniversalTime() - start_time;
+
+  return poly_data;
+}
@@ -0,0 +1,58 @@
+#ifndef VIKING_DATA_SKINMESHER_H
+#define VIKING_DATA_SKINMESHER_H
+
+#include <vtkSmartPointer.h>
+
+class vtkPolyData;
+class Structure;
+
+//! Ball counts and stage timing of the last skin surface
+class SkinMeshStats
+{
+public:
+  SkinMeshStats();
+
+  int num_balls;
+
+  int num_triangles;
+
+  /// seconds spent placing the balls and meshing their union
+  double sample_time;
+  double mesh_time;
+};
+
+//! Exact surface of a union of balls along a structure's links, with CGAL
+/*!
+ * Balls are placed along every link (see PointSampler::collect_spheres) a
+ * fixed fraction of the local radius apart, so thin processes get as many
+ * balls per radius as thick ones and the dents between balls have the same
+ * relative depth everywhere.
+ *
+ * The balls go to CGAL::Union_of_balls_3 and CGAL::mesh_union_of_balls_3.
+ * The union of balls builds the regular triangulation of the balls itself,
+ * where a ball covered by the others has an empty power cell and drops out,
+ * and cannot take one built elsewhere, so the whole mesher is sequential.
+ *
+ * Only built with USE_CGAL.
+ */
+class SkinMesher
+{
+
+public:
+  SkinMesher();
+
+  /// distance between consecutive balls along a link, as a fraction of the smaller radius
+  void set_ball_spacing( double spacing );
+
+  vtkSmartPointer<vtkPolyData> generate( Structure* structure );
+
+  const SkinMeshStats& get_stats() const;
+
+private:
+
+  double ball_spacing_;
+
+  SkinMeshStats stats_;
+};
+
+#endif /* VIKING_DATA_SKINMESHER_H */
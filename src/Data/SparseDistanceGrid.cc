@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cmath>
+
+#include <QtConcurrentMap>
+
+#include <Data/SparseDistanceGrid.h>
+#include <Data/CapsuleBVH.h>
+#include <Data/UnionMesher.h>
+
+//-----------------------------------------------------------------------------
+SparseDistanceGrid::SparseDistanceGrid()
+{
+  this->clear();
+}
+
+//-----------------------------------------------------------------------------
+void SparseDistanceGrid::clear()
+{
+  this->tiles_.clear();
+  this->tile_map_.clear();
+  this->leaves_.clear();
+  this->spacing_ = 1;
+  this->band_ = 1;
+  for ( int k = 0; k < 3; k++ )
+  {
+    this->origin_[k] = 0;
+    this->dimensions_[k] = 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+long long SparseDistanceGrid::tile_key( int tx, int ty, int tz )
+{
+  return ( (long long)tz << 40 ) | ( (long long)ty << 20 ) | (long long)tx;
+}
+
+//-----------------------------------------------------------------------------
+void SparseDistanceGrid::build( const CapsuleBVH &bvh, const double* bounds, double spacing, double band )
+{
+  this->clear();
+  this->spacing_ = spacing;
+  this->band_ = band;
+
+  // the outermost samples must be outside so the surface closes
+  for ( int k = 0; k < 3; k++ )
+  {
+    this->origin_[k] = bounds[2 * k] - band;
+    this->dimensions_[k] = (int)ceil( ( bounds[2 * k + 1] + band - this->origin_[k] ) / spacing ) + 1;
+  }
+
+  // tiles some capsule (with the band around it) reaches, anything else is outside
+  const int tile_span = LEAF_SIZE * TILE_SIZE;
+  for ( int i = 0; i < bvh.get_num_capsules(); i++ )
+  {
+    const Capsule &capsule = bvh.get_capsule( i );
+    double radius = std::max( capsule.radius_a, capsule.radius_b ) + band;
+
+    int lower[3], upper[3];
+    for ( int k = 0; k < 3; k++ )
+    {
+      double low = std::min( capsule.a[k], capsule.b[k] ) - radius;
+      double high = std::max( capsule.a[k], capsule.b[k] ) + radius;
+      lower[k] = std::max( 0, (int)floor( ( low - this->origin_[k] ) / spacing ) ) / tile_span;
+      upper[k] = std::min( this->dimensions_[k] - 1, (int)ceil( ( high - this->origin_[k] ) / spacing ) ) / tile_span;
+    }
+
+    for ( int tz = lower[2]; tz <= upper[2]; tz++ )
+    {
+      for ( int ty = lower[1]; ty <= upper[1]; ty++ )
+      {
+        for ( int tx = lower[0]; tx <= upper[0]; tx++ )
+        {
+          long long key = SparseDistanceGrid::tile_key( tx, ty, tz );
+          if ( this->tile_map_.contains( key ) )
+          {
+            continue;
+          }
+
+          Tile tile;
+          tile.origin[0] = tx * tile_span;
+          tile.origin[1] = ty * tile_span;
+          tile.origin[2] = tz * tile_span;
+          tile.fill = OUTSIDE;
+          this->tile_map_.insert( key, (int)this->tiles_.size() );
+          this->tiles_.push_back( tile );
+        }
+      }
+    }
+  }
+
+  std::vector<TileTask> tasks( this->tiles_.size() );
+  for ( size_t i = 0; i < tasks.size(); i++ )
+  {
+    tasks[i].grid = this;
+    tasks[i].bvh = &bvh;
+    tasks[i].tile = &this->tiles_[i];
+  }
+
+  QtConcurrent::blockingMap( tasks, SparseDistanceGrid::build_tile );
+
+  for ( int t = 0; t < (int)this->tiles_.size(); t++ )
+  {
+    const Tile &tile = this->tiles_[t];
+    for ( int s = 0; s < (int)tile.slots.size(); s++ )
+    {
+      if ( tile.slots[s] < 0 )
+      {
+        continue;
+      }
+
+      Leaf leaf;
+      leaf.origin[0] = tile.origin[0] + ( s % TILE_SIZE ) * LEAF_SIZE;
+      leaf.origin[1] = tile.origin[1] + ( s / TILE_SIZE % TILE_SIZE ) * LEAF_SIZE;
+      leaf.origin[2] = tile.origin[2] + ( s / ( TILE_SIZE * TILE_SIZE ) ) * LEAF_SIZE;
+      leaf.tile = t;
+      leaf.index = tile.slots[s];
+      this->leaves_.push_back( leaf );
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SparseDistanceGrid::build_tile( TileTask &task )
+{
+  const SparseDistanceGrid &grid = *task.grid;
+  const CapsuleBVH &bvh = *task.bvh;
+  Tile &tile = *task.tile;
+  double h = grid.spacing_;
+
+  // a leaf whose center is further than this from the surface has no sample within the band
+  double leaf_radius = sqrt( 3.0 ) * 0.5 * ( LEAF_SIZE - 1 ) * h;
+  double reach = leaf_radius + grid.band_;
+
+  const int tile_span = LEAF_SIZE * TILE_SIZE;
+  double bounds[6];
+  for ( int k = 0; k < 3; k++ )
+  {
+    bounds[2 * k] = grid.origin_[k] + tile.origin[k] * h - reach;
+    bounds[2 * k + 1] = grid.origin_[k] + ( tile.origin[k] + tile_span - 1 ) * h + reach;
+  }
+
+  std::vector<int> candidates;
+  bvh.find_capsules( bounds, candidates );
+
+  tile.slots.assign( TILE_SIZE * TILE_SIZE * TILE_SIZE, OUTSIDE );
+
+  std::vector<int> leaf_capsules;
+  int num_leaves = 0;
+  int num_inside = 0;
+
+  for ( int s = 0; s < (int)tile.slots.size(); s++ )
+  {
+    int leaf_origin[3];
+    leaf_origin[0] = tile.origin[0] + ( s % TILE_SIZE ) * LEAF_SIZE;
+    leaf_origin[1] = tile.origin[1] + ( s / TILE_SIZE % TILE_SIZE ) * LEAF_SIZE;
+    leaf_origin[2] = tile.origin[2] + ( s / ( TILE_SIZE * TILE_SIZE ) ) * LEAF_SIZE;
+
+    if ( leaf_origin[0] >= grid.dimensions_[0] || leaf_origin[1] >= grid.dimensions_[1] ||
+         leaf_origin[2] >= grid.dimensions_[2] )
+    {
+      continue;
+    }
+
+    double center[3];
+    for ( int k = 0; k < 3; k++ )
+    {
+      center[k] = grid.origin_[k] + ( leaf_origin[k] + 0.5 * ( LEAF_SIZE - 1 ) ) * h;
+    }
+
+    double center_distance = SparseDistanceGrid::distance( bvh, candidates, center, 2.0 * reach );
+    if ( center_distance > reach )
+    {
+      continue;
+    }
+    if ( center_distance < -reach )
+    {
+      tile.slots[s] = INSIDE;
+      num_inside++;
+      continue;
+    }
+
+    // the capsules within the band of this leaf
+    double leaf_bounds[6];
+    for ( int k = 0; k < 3; k++ )
+    {
+      leaf_bounds[2 * k] = grid.origin_[k] + leaf_origin[k] * h - grid.band_;
+      leaf_bounds[2 * k + 1] = grid.origin_[k] + ( leaf_origin[k] + LEAF_SIZE - 1 ) * h + grid.band_;
+    }
+
+    leaf_capsules.clear();
+    for ( size_t i = 0; i < candidates.size(); i++ )
+    {
+      const Capsule &capsule = bvh.get_capsule( candidates[i] );
+      double radius = std::max( capsule.radius_a, capsule.radius_b );
+      bool overlap = true;
+      for ( int k = 0; k < 3 && overlap; k++ )
+      {
+        overlap = std::min( capsule.a[k], capsule.b[k] ) - radius <= leaf_bounds[2 * k + 1] &&
+                  std::max( capsule.a[k], capsule.b[k] ) + radius >= leaf_bounds[2 * k];
+      }
+      if ( overlap )
+      {
+        leaf_capsules.push_back( candidates[i] );
+      }
+    }
+
+    tile.slots[s] = num_leaves++;
+    tile.values.resize( num_leaves * LEAF_VALUES );
+    float* values = &tile.values[( num_leaves - 1 ) * LEAF_VALUES];
+
+    double point[3];
+    for ( int z = 0; z < LEAF_SIZE; z++ )
+    {
+      point[2] = grid.origin_[2] + ( leaf_origin[2] + z ) * h;
+      for ( int y = 0; y < LEAF_SIZE; y++ )
+      {
+        point[1] = grid.origin_[1] + ( leaf_origin[1] + y ) * h;
+        for ( int x = 0; x < LEAF_SIZE; x++ )
+        {
+          point[0] = grid.origin_[0] + ( leaf_origin[0] + x ) * h;
+          *values++ = (float)SparseDistanceGrid::distance( bvh, leaf_capsules, point, grid.band_ );
+        }
+      }
+    }
+  }
+
+  std::vector<float>( tile.values ).swap( tile.values );
+
+  // uniform tiles keep only their sign
+  if ( num_leaves == 0 && ( num_inside == 0 || num_inside == (int)tile.slots.size() ) )
+  {
+    tile.fill = ( num_inside == 0 ) ? OUTSIDE : INSIDE;
+    std::vector<int>().swap( tile.slots );
+  }
+}
+
+//-----------------------------------------------------------------------------
+double SparseDistanceGrid::distance( const CapsuleBVH &bvh, const std::vector<int> &capsules,
+                                     const double* point, double limit )
+{
+  double distance = limit;
+  for ( size_t i = 0; i < capsules.size(); i++ )
+  {
+    distance = std::min( distance, UnionMesher::capsule_distance( bvh.get_capsule( capsules[i] ), point ) );
+  }
+  return distance;
+}
+
+//-----------------------------------------------------------------------------
+float SparseDistanceGrid::get_value( int x, int y, int z ) const
+{
+  float band = (float)this->band_;
+
+  if ( x < 0 || y < 0 || z < 0 ||
+       x >= this->dimensions_[0] || y >= this->dimensions_[1] || z >= this->dimensions_[2] )
+  {
+    return band;
+  }
+
+  const int tile_span = LEAF_SIZE * TILE_SIZE;
+  QHash<long long, int>::const_iterator it =
+    this->tile_map_.constFind( SparseDistanceGrid::tile_key( x / tile_span, y / tile_span, z / tile_span ) );
+  if ( it == this->tile_map_.constEnd() )
+  {
+    return band;
+  }
+
+  const Tile &tile = this->tiles_[it.value()];
+  if ( tile.slots.empty() )
+  {
+    return tile.fill == INSIDE ? -band : band;
+  }
+
+  int lx = ( x % tile_span ) / LEAF_SIZE;
+  int ly = ( y % tile_span ) / LEAF_SIZE;
+  int lz = ( z % tile_span ) / LEAF_SIZE;
+  int index = tile.slots[lx + TILE_SIZE * ( ly + TILE_SIZE * lz )];
+  if ( index == OUTSIDE )
+  {
+    return band;
+  }
+  if ( index == INSIDE )
+  {
+    return -band;
+  }
+
+  return tile.values[index * LEAF_VALUES +
+                     ( x % LEAF_SIZE ) + LEAF_SIZE * ( ( y % LEAF_SIZE ) + LEAF_SIZE * ( z % LEAF_SIZE ) )];
+}
+
+//-----------------------------------------------------------------------------
+void SparseDistanceGrid::gather_leaf( int leaf, float* values ) const
+{
+  const Leaf &info = this->leaves_[leaf];
+  const float* own = &this->tiles_[info.tile].values[info.index * LEAF_VALUES];
+
+  const int size = GATHER_SIZE;
+  for ( int z = -1; z <= LEAF_SIZE + 1; z++ )
+  {
+    for ( int y = -1; y <= LEAF_SIZE + 1; y++ )
+    {
+      float* row = values + ( ( z + 1 ) * size + ( y + 1 ) ) * size + 1;
+      bool inside = z >= 0 && z < LEAF_SIZE && y >= 0 && y < LEAF_SIZE;
+      for ( int x = -1; x <= LEAF_SIZE + 1; x++ )
+      {
+        if ( inside && x >= 0 && x < LEAF_SIZE )
+        {
+          row[x] = own[x + LEAF_SIZE * ( y + LEAF_SIZE * z )];
+        }
+        else
+        {
+          row[x] = this->get_value( info.origin[0] + x, info.origin[1] + y, info.origin[2] + z );
+        }
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+double SparseDistanceGrid::get_memory_size() const
+{
+  double size = sizeof( *this ) + this->tiles_.capacity() * sizeof( Tile ) +
+                this->leaves_.capacity() * sizeof( Leaf ) +
+                this->tile_map_.size() * ( sizeof( long long ) + sizeof( int ) + 2 * sizeof( void* ) );
+
+  for ( size_t i = 0; i < this->tiles_.size(); i++ )
+  {
+    size += this->tiles_[i].slots.capacity() * sizeof( int ) + this->tiles_[i].values.capacity() * sizeof( float );
+  }
+
+  return size;
+}
+
+//-----------------------------------------------------------------------------
+double SparseDistanceGrid::get_dense_memory_size() const
+{
+  return (double)this->dimensions_[0] * this->dimensions_[1] * this->dimensions_[2] * sizeof( float );
+}
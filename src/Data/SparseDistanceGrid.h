@@ -0,0 +1,126 @@
+#ifndef VIKING_DATA_SPARSEDISTANCEGRID_H
+#define VIKING_DATA_SPARSEDISTANCEGRID_H
+
+#include <vector>
+
+#include <QHash>
+
+class CapsuleBVH;
+
+//! Narrow band signed distance to a union of capsules, stored sparsely
+/*!
+ * A two level hierarchy in the spirit of VDB.  The lattice is cut into
+ * leaves of LEAF_SIZE^3 samples, and leaves are grouped into tiles of
+ * TILE_SIZE^3 leaves.  Tiles live in a hash keyed by their lattice position,
+ * and only tiles some capsule comes near are created at all.
+ *
+ * Within a tile, a leaf gets sample storage only if the surface can pass
+ * through it: the distance at its center is compared with its half diagonal
+ * plus the band (the distance changes by at most the distance moved).  Leaves
+ * entirely outside or entirely inside store no samples, only their sign, and
+ * read back as plus or minus the band.  Memory therefore grows with the
+ * surface area rather than the bounding volume.
+ *
+ * Tiles are classified and sampled in parallel, each tile with the capsules
+ * the CapsuleBVH finds near it.
+ */
+class SparseDistanceGrid
+{
+
+public:
+  SparseDistanceGrid();
+
+  static const int LEAF_SIZE = 8;
+  static const int TILE_SIZE = 8;
+  static const int LEAF_VALUES = LEAF_SIZE * LEAF_SIZE * LEAF_SIZE;
+
+  /// sample the capsules of the BVH on a lattice covering the box (xmin, xmax, ymin, ...) plus the band
+  void build( const CapsuleBVH &bvh, const double* bounds, double spacing, double band );
+
+  void clear();
+
+  /// distance at a lattice point, plus or minus the band away from the surface and outside the lattice
+  float get_value( int x, int y, int z ) const;
+
+  /// world position of lattice point 0, 0, 0
+  const double* get_origin() const { return this->origin_; }
+
+  double get_spacing() const { return this->spacing_; }
+
+  double get_band() const { return this->band_; }
+
+  /// lattice points along each axis
+  const int* get_dimensions() const { return this->dimensions_; }
+
+  int get_num_tiles() const { return (int)this->tiles_.size(); }
+
+  int get_num_leaves() const { return (int)this->leaves_.size(); }
+
+  /// lattice position of the first sample of a leaf
+  const int* get_leaf_origin( int leaf ) const { return this->leaves_[leaf].origin; }
+
+  /// the samples of a leaf and one layer of its neighbors' all around (offsets -1 .. LEAF_SIZE + 1),
+  /// GATHER_SIZE^3 values, x fastest
+  void gather_leaf( int leaf, float* values ) const;
+
+  static const int GATHER_SIZE = LEAF_SIZE + 3;
+
+  /// bytes used by the hierarchy and the samples
+  double get_memory_size() const;
+
+  /// bytes a dense float grid over the same lattice would need
+  double get_dense_memory_size() const;
+
+private:
+
+  //! TILE_SIZE^3 leaves
+  class Tile
+  {
+  public:
+    int origin[3];
+
+    /// per leaf: index into values / LEAF_VALUES, or OUTSIDE / INSIDE
+    std::vector<int> slots;
+    std::vector<float> values;
+
+    /// sign of the whole tile when it has no slots
+    int fill;
+  };
+
+  //! where the samples of one leaf are
+  class Leaf
+  {
+  public:
+    int origin[3];
+    int tile;
+    int index;
+  };
+
+  class TileTask
+  {
+  public:
+    const SparseDistanceGrid* grid;
+    const CapsuleBVH* bvh;
+    Tile* tile;
+  };
+
+  static void build_tile( TileTask &task );
+
+  static long long tile_key( int tx, int ty, int tz );
+
+  /// distance to the nearest of the given capsules, at most 'limit'
+  static double distance( const CapsuleBVH &bvh, const std::vector<int> &capsules, const double* point, double limit );
+
+  enum { OUTSIDE = -1, INSIDE = -2 };
+
+  double origin_[3];
+  double spacing_;
+  double band_;
+  int dimensions_[3];
+
+  std::vector<Tile> tiles_;
+  QHash<long long, int> tile_map_;
+  std::vector<Leaf> leaves_;
+};
+
+#endif /* VIKING_DATA_SPARSEDISTANCEGRID_H */
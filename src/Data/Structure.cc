@@ -1,11 +1,20 @@
 #include <Data/Structure.h>
 #include <Data/Json.h>
-//#include <Data/PointSampler.h>
-//#include <Data/AlphaShape.h>
+#include <Data/SkeletonGraph.h>
+#include <Data/SkeletonGeometry.h>
+#include <Data/SkeletonPathIndex.h>
+#include <Data/SkeletonMesher.h>
+#include <Data/UnionMesher.h>
+#include <Data/MeshRepair.h>
+#include <Data/TubeMeshCache.h>
+#include <Data/CompactMesh.h>
+#ifdef VIKING_USE_CGAL
+#include <Data/SkinMesher.h>
+#include <Data/PointSampler.h>
+#include <Data/AlphaShape.h>
+#endif
 //#include <Data/FixedAlphaShape.h>
 
-#include <vtkCenterOfMass.h>
-#include <vtkMassProperties.h>
 #include <vtkWindowedSincPolyDataFilter.h>
 #include <vtkCleanPolyData.h>
 #include <vtkSTLWriter.h>
@@ -45,6 +54,9 @@
 #include <vtkButterflySubdivisionFilter.h>
 
 #include <QVariant>
+#include <QThread>
+
+#include <algorithm>
 
 //#include <CGAL/IO/Polyhedron_iostream.h>
 //#include <CGAL/Inverse_index.h>
@@ -52,11 +64,33 @@
 
 //#include <CGAL/Polyhe>
 
+//-----------------------------------------------------------------------------
+DecimationStats::DecimationStats()
+{
+  this->input_triangles = 0;
+  this->output_triangles = 0;
+  this->reduction = 0;
+  this->max_error = 0;
+  this->topology_rejections = 0;
+}
+
 //-----------------------------------------------------------------------------
 Structure::Structure()
 {
   this->color_ = QColor( 128 + ( qrand() % 128 ), 128 + ( qrand() % 128 ), 128 + ( qrand() % 128 ) );
   this->num_tubes_ = 0;
+  this->mesh_tolerance_ = 0.01;
+  this->triangle_budget_ = 0;
+  this->union_surface_ = false;
+  this->union_voxel_size_ = 0;
+  this->union_extraction_ = UnionMesher::MARCHING_CUBES;
+  this->graph_ = QSharedPointer<SkeletonGraph>( new SkeletonGraph() );
+  this->path_index_ = QSharedPointer<SkeletonPathIndex>( new SkeletonPathIndex() );
+
+  SkeletonMesher mesher;
+  mesher.set_tolerance( this->mesh_tolerance_ );
+  this->tube_cache_ = QSharedPointer<TubeMeshCache>( new TubeMeshCache() );
+  this->tube_cache_->set_mesher( mesher );
 }
 
 //-----------------------------------------------------------------------------
@@ -161,6 +195,8 @@ QSharedPointer<StructureHash> Structure::create_structures( QList<QVariant> stru
 
     //std::cerr << "===After location culling===\n";
     //structure->link_report();
+
+    structure->build_skeleton();
   }
 
   return structures;
@@ -243,6 +279,8 @@ QSharedPointer<Structure> Structure::create_structure( int id, QList<QVariant> s
 
   std::cerr << "===After location culling===\n";
   structure->link_report();
+
+  structure->build_skeleton();
   return structure;
 }
 
@@ -355,157 +393,56 @@ NodeMap Structure::get_node_map()
    }
  */
 
-/*
-   //-----------------------------------------------------------------------------
-   vtkSmartPointer<vtkPolyData> Structure::get_mesh_alpha()
-   {
-   if ( !this->mesh_ )
-   {
-    PointSampler ps( this );
-    std::list<Point> points = ps.sample_points();
-
-    AlphaShape alpha_shape;
-    alpha_shape.set_points( points );
-    vtkSmartPointer<vtkPolyData> poly_data = alpha_shape.get_mesh();
-
-    //FixedAlphaShape alpha_shape;
-    //alpha_shape.set_points( points );
-    //vtkSmartPointer<vtkPolyData> poly_data = alpha_shape.get_mesh();
-
-    // clean
-    std::cerr << "Number of points before cleaning: " << poly_data->GetNumberOfPoints() << "\n";
-    vtkSmartPointer<vtkCleanPolyData> clean = vtkSmartPointer<vtkCleanPolyData>::New();
-    clean->SetInputData( poly_data );
-    clean->SetTolerance( 0.00001 );
-    clean->Update();
-    poly_data = clean->GetOutput();
-    std::cerr << "Number of points after cleaning: " << poly_data->GetNumberOfPoints() << "\n";
-
-    vtkSmartPointer<vtkFeatureEdges> features = vtkSmartPointer<vtkFeatureEdges>::New();
-    features->SetInputData( poly_data );
-    features->NonManifoldEdgesOn();
-    features->BoundaryEdgesOff();
-    features->FeatureEdgesOff();
-    features->Update();
-
-    vtkSmartPointer<vtkPolyData> nonmanifold = features->GetOutput();
-
-    std::cerr << "Number of non-manifold points: " << nonmanifold->GetNumberOfPoints() << "\n";
-    std::cerr << "Number of non-manifold cells: " << nonmanifold->GetNumberOfCells() << "\n";
-
-    std::vector<int> remove;
-
-    for ( int j = 0; j < poly_data->GetNumberOfPoints(); j++ )
-    {
-      double p2[3];
-      poly_data->GetPoint( j, p2 );
-
-      for ( int i = 0; i < nonmanifold->GetNumberOfPoints(); i++ )
-      {
-        double p[3];
-        nonmanifold->GetPoint( i, p );
-
-        if ( p[0] == p2[0] && p[1] == p2[1] && p[2] == p2[2] )
-        {
-          remove.push_back( j );
-        }
-      }
-    }
-
-    std::cerr << "Removing " << remove.size() << " non-manifold vertices\n";
-
-    vtkSmartPointer<vtkPolyData> new_poly_data = vtkSmartPointer<vtkPolyData>::New();
-    vtkSmartPointer<vtkPoints> vtk_pts = vtkSmartPointer<vtkPoints>::New();
-    vtkSmartPointer<vtkCellArray> vtk_triangles = vtkSmartPointer<vtkCellArray>::New();
-
-    for ( int i = 0; i < poly_data->GetNumberOfCells(); i++ )
-    {
-      vtkSmartPointer<vtkIdList> list = vtkIdList::New();
-      poly_data->GetCellPoints( i, list );
-
-      bool match = false;
-      for ( int j = 0; j < list->GetNumberOfIds(); j++ )
-      {
-        int id = list->GetId( j );
-        for ( unsigned int k = 0; k < remove.size(); k++ )
-        {
-          if ( id == remove[k] )
-          {
-            match = true;
-          }
-        }
-      }
-
-      if ( match )
-      {
-        poly_data->DeleteCell( i );
-      }
-    }
+#ifdef VIKING_USE_CGAL
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> Structure::get_mesh_alpha()
+{
+  AlphaShape alpha_shape;
+
+  // samples far closer together than the alpha ball is wide only slow the triangulation down, so thin
+  // processes get the same absolute spacing as thick ones
+  double alpha_radius = sqrt( alpha_shape.get_alpha() );
+  PointSampler sampler( this );
+  sampler.set_point_spacing( 0.25, 0.3 * alpha_radius );
+  sampler.set_ball_spacing( 0.5, 0.3 * alpha_radius );
+  std::vector<double> points;
+  sampler.sample_points( points );
+
+  const PointSampleStats &sample_stats = sampler.get_stats();
+  std::cerr << "Sampled " << sample_stats.num_points << " points on " << sample_stats.num_spheres << " spheres along "
+            << sample_stats.num_links << " links in " << sample_stats.sample_time << "s\n";
+
+  alpha_shape.set_points( points );
+  vtkSmartPointer<vtkPolyData> poly_data = alpha_shape.get_mesh();
+
+  // the alpha shape pinches where processes nearly touch; loop subdivision needs a manifold mesh
+  MeshRepair repair;
+  repair.set_weld_tolerance( 0.00001 );
+  poly_data = repair.repair( poly_data );
+
+  const MeshRepairStats &stats = repair.get_stats();
+  std::cerr << "Repaired alpha shape: " << stats.welded_points << " points welded, " << stats.non_manifold_edges
+            << " non-manifold edges (" << stats.removed_triangles << " triangles removed), "
+            << stats.non_manifold_vertices << " non-manifold vertices split in " << stats.repair_time << "s\n";
+
+  vtkSmartPointer<vtkLoopSubdivisionFilter> subdivision = vtkSmartPointer<vtkLoopSubdivisionFilter>::New();
+  subdivision->SetInputData( poly_data );
+  subdivision->SetNumberOfSubdivisions( 2 );
+  subdivision->Update();
+  poly_data = subdivision->GetOutput();
+
+  // Make the triangle winding order consistent
+  vtkSmartPointer<vtkPolyDataNormals> normals = vtkSmartPointer<vtkPolyDataNormals>::New();
+  normals->SetInputData( poly_data );
+  normals->ConsistencyOn();
+  normals->SplittingOff();
+  normals->Update();
+  poly_data = normals->GetOutput();
 
-    poly_data->RemoveDeletedCells();
-
-    features = vtkSmartPointer<vtkFeatureEdges>::New();
-    features->SetInputData( poly_data );
-    features->NonManifoldEdgesOn();
-    features->BoundaryEdgesOff();
-    features->FeatureEdgesOff();
-    features->Update();
-
-    nonmanifold = features->GetOutput();
-
-    //std::cerr < "Number of non-manifold points: " << nonmanifold->GetNumberOfPoints() << "\n";
-    //std::cerr << "Number of non-manifold cells: " << nonmanifold->GetNumberOfCells() << "\n";
-
-    vtkSmartPointer< vtkTriangleFilter > triangle_filter =
-      vtkSmartPointer< vtkTriangleFilter >::New();
-    triangle_filter->SetInputData( poly_data );
-    triangle_filter->Update();
-    poly_data = triangle_filter->GetOutput();
-
-    vtkSmartPointer<vtkSTLWriter> writer = vtkSmartPointer<vtkSTLWriter>::New();
-    writer->SetFileName( "Z:\\shared\\file.stl" );
-    writer->SetInputData( poly_data );
-    writer->Write();
-
-    // clean
-    clean = vtkSmartPointer<vtkCleanPolyData>::New();
-    clean->SetInputData( poly_data );
-    clean->Update();
-    poly_data = clean->GetOutput();
-
-    // smooth
-
-
-    vtkSmartPointer<vtkLoopSubdivisionFilter> subdivision = vtkSmartPointer<vtkLoopSubdivisionFilter>::New();
-    subdivision->SetInputData( poly_data );
-    subdivision->SetNumberOfSubdivisions( 2 );
-    subdivision->Update();
-    poly_data = subdivision->GetOutput();
-
-    // Make the triangle winding order consistent
-    vtkSmartPointer<vtkPolyDataNormals> normals =
-      vtkSmartPointer<vtkPolyDataNormals>::New();
-    normals->SetInputData( poly_data );
-    normals->ConsistencyOn();
-    normals->SplittingOff();
-    normals->Update();
-    poly_data = normals->GetOutput();
-
-
-    // Make the triangle winding order consistent
-    normals = vtkSmartPointer<vtkPolyDataNormals>::New();
-    normals->SetInputData( poly_data );
-    normals->ConsistencyOn();
-    normals->SplittingOff();
-    normals->Update();
-    poly_data = normals->GetOutput();
-
-    this->mesh_ = poly_data;
-   }
+  return poly_data;
+}
+#endif
 
-   return this->mesh_;
-   }
- */
 //-----------------------------------------------------------------------------
 int Structure::get_id()
 {
@@ -521,32 +458,19 @@ int Structure::get_type()
 //-----------------------------------------------------------------------------
 double Structure::get_volume()
 {
-  return 0;
-  vtkSmartPointer<vtkPolyData> mesh = this->get_mesh_union();
-
-  vtkSmartPointer<vtkMassProperties> mass_properties = vtkSmartPointer<vtkMassProperties>::New();
-
-  mass_properties->SetInputData( mesh );
-  mass_properties->Update();
+  return this->geometry_.volume;
+}
 
-  return mass_properties->GetVolume();
+//-----------------------------------------------------------------------------
+double Structure::get_surface_area()
+{
+  return this->geometry_.surface_area;
 }
 
 //-----------------------------------------------------------------------------
 QString Structure::get_center_of_mass_string()
 {
-  return "";
-  vtkSmartPointer<vtkPolyData> mesh = this->get_mesh_union();
-
-  // Compute the center of mass
-  vtkSmartPointer<vtkCenterOfMass> center_of_mass =
-    vtkSmartPointer<vtkCenterOfMass>::New();
-  center_of_mass->SetInputData( mesh );
-  center_of_mass->SetUseScalarsAsWeights( false );
-  center_of_mass->Update();
-
-  double center[3];
-  center_of_mass->GetCenter( center );
+  const double* center = this->geometry_.center_of_mass;
 
   QString str = QString::number( center[0] ) + ", " + QString::number( center[1] ) + ", " + QString::number( center[2] );
 
@@ -601,11 +525,6 @@ vtkSmartPointer<vtkPolyData> Structure::recopy_mesh( vtkSmartPointer<vtkPolyData
 //-----------------------------------------------------------------------------
 vtkSmartPointer<vtkPolyData> Structure::get_mesh_parts()
 {
-  if ( this->mesh_ )
-  {
-    return this->mesh_;
-  }
-
   //std::cerr << "creating mesh...\n";
 
   NodeMap node_map = this->get_node_map();
@@ -707,9 +626,7 @@ vtkSmartPointer<vtkPolyData> Structure::get_mesh_parts()
     poly_data = append->GetOutput();
   }
 
-  this->mesh_ = poly_data;
-
-  return this->mesh_;
+  return poly_data;
 }
 
 //-----------------------------------------------------------------------------
@@ -935,330 +852,504 @@ void Structure::link_report()
 }
 
 //-----------------------------------------------------------------------------
-vtkSmartPointer<vtkPolyData> Structure::get_mesh_tubes()
+void Structure::build_skeleton()
 {
-  if ( this->mesh_ )
+  this->graph_->build( this->node_map_ );
+  this->update_skeleton_properties();
+}
+
+//-----------------------------------------------------------------------------
+void Structure::update_skeleton_properties()
+{
+  this->lod_levels_ = SkeletonLOD::build_levels( *this->graph_, SkeletonLOD::get_default_tolerances() );
+  this->geometry_ = SkeletonGeometry::compute( *this->graph_ );
+  this->morphometrics_ = Morphometrics::compute( *this->graph_ );
+  this->path_index_->build( *this->graph_ );
+}
+
+//-----------------------------------------------------------------------------
+void Structure::move_node( long id, double x, double y, double z, double radius )
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
+
+  int index = this->graph_->get_index( id );
+  if ( index < 0 )
   {
-    return this->mesh_;
+    return;
   }
 
-  //std::cerr << "creating mesh...\n";
-
-  //NodeMap node_map = this->get_node_map();
+  QSharedPointer<Node> n = this->node_map_[id];
+  n->x = x;
+  n->y = y;
+  n->z = z;
+  n->radius = radius;
+
+  // the links stay the same, so the graph only needs the new position; the levels of detail, lengths and
+  // path index are recomputed in full, which is linear in the nodes and small next to meshing
+  this->graph_->set_node( index, x, y, z, radius );
+  this->update_skeleton_properties();
+  this->remesh_tubes( id );
+}
 
-  //std::list<Point> points;
+//-----------------------------------------------------------------------------
+void Structure::add_node( long id, double x, double y, double z, double radius, long linked_id )
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
 
-  vtkSmartPointer<vtkPolyData> poly_data = vtkSmartPointer<vtkPolyData>::New();
+  if ( this->node_map_.contains( id ) )
+  {
+    return;
+  }
 
-  // reset visited
-  for ( NodeMap::iterator it = this->node_map_.begin(); it != this->node_map_.end(); ++it )
+  QSharedPointer<Node> n = QSharedPointer<Node>( new Node() );
+  n->id = id;
+  n->x = x;
+  n->y = y;
+  n->z = z;
+  n->radius = radius;
+  n->parent_id = this->id_;
+  n->graph_id = -1;
+  n->visited = false;
+  this->node_map_[id] = n;
+
+  if ( this->node_map_.contains( linked_id ) )
   {
-    it.value()->visited = false;
+    Link link;
+    link.a = linked_id;
+    link.b = id;
+    this->node_map_[linked_id]->linked_nodes.append( id );
+    n->linked_nodes.append( linked_id );
+    this->links_.append( link );
   }
 
-  int root = -1;
-  // find a dead-end
-  for ( NodeMap::iterator it = this->node_map_.begin(); it != this->node_map_.end(); ++it )
+  this->build_skeleton();
+  this->remesh_tubes( -1 );
+}
+
+//-----------------------------------------------------------------------------
+void Structure::remove_node( long id )
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
+
+  if ( !this->node_map_.contains( id ) )
   {
-    QSharedPointer<Node> n = it.value();
-    if ( n->linked_nodes.size() == 1 || n->linked_nodes.size() == 0 )
+    return;
+  }
+
+  foreach( int linked_id, this->node_map_[id]->linked_nodes ) {
+    if ( this->node_map_.contains( linked_id ) )
+    {
+      this->node_map_[linked_id]->linked_nodes.removeAll( id );
+    }
+  }
+  this->node_map_.remove( id );
+
+  QList<Link> links;
+  foreach( Link link, this->links_ ) {
+    if ( link.a != id && link.b != id )
     {
-      root = n->id;
-      break;
+      links.append( link );
     }
   }
+  this->links_ = links;
+
+  this->build_skeleton();
+  this->remesh_tubes( -1 );
+}
 
-  if ( root == -1 )
+//-----------------------------------------------------------------------------
+void Structure::remesh_tubes( long id )
+{
+  // the coarse tubes and lines follow the simplified skeleton, which an edit can change along a whole
+  // branch, so they are rebuilt rather than patched; they are a small part of the meshing time
+  this->coarse_mesh_.clear();
+  this->lines_mesh_ = NULL;
+  this->union_mesh_.clear();
+
+  // nothing to patch if the tubes have not been meshed yet
+  if ( !this->mesh_ )
   {
-    std::cerr << "Error: could not locate root node\n";
-    return this->mesh_;
+    return;
   }
 
-  QSharedPointer<Node> n = this->node_map_[root];
+  QSharedPointer<CompactMesh> mesh = this->tube_cache_->get_mesh();
+  if ( id < 0 )
+  {
+    this->tube_cache_->update( *this->graph_ );
+  }
+  else
+  {
+    this->tube_cache_->update_node( *this->graph_, id );
+  }
 
-  vtkSmartPointer<vtkAppendPolyData> append = vtkSmartPointer<vtkAppendPolyData>::New();
+  const TubeMeshUpdateStats &stats = this->tube_cache_->get_stats();
+  std::cerr << "remeshed " << stats.regenerated_pieces << " of " << stats.num_pieces << " tube pieces in "
+            << stats.update_time << "s" << ( stats.patched ? ", patched in place\n" : "\n" );
 
-  this->add_polydata( n, -1, append, QList<int>() );
+  // a decimated mesh has no pieces to patch and is decimated again from the patched cache, a new layout
+  // has to be picked up as well
+  if ( this->mesh_ != mesh || this->tube_cache_->get_mesh() != mesh )
+  {
+    this->mesh_.clear();
+  }
+}
 
-  //std::cerr << "Num of items: " << append->GetNumberOfInputConnections( 0 ) << "\n";
+//-----------------------------------------------------------------------------
+const TubeMeshUpdateStats& Structure::get_tube_update_stats()
+{
+  return this->tube_cache_->get_stats();
+}
 
-  //std::cerr << "number of tubes: " << this->num_tubes_ << "\n";
+//-----------------------------------------------------------------------------
+const SkeletonGraph& Structure::get_skeleton_graph()
+{
+  return *this->graph_;
+}
 
-  append->Update();
-  poly_data = append->GetOutput();
+//-----------------------------------------------------------------------------
+int Structure::get_num_lod_levels()
+{
+  return (int)this->lod_levels_.size();
+}
 
-  //  std::cerr << "number of verts: " << poly_data->GetNumberOfPoints() << "\n";
-  //std::cerr << "number of polys: " << poly_data->GetNumberOfCells() << "\n";
+//-----------------------------------------------------------------------------
+const SkeletonLevel& Structure::get_lod_level( int level )
+{
+  if ( this->lod_levels_.empty() )
+  {
+    this->build_skeleton();
+  }
+  level = std::max( 0, std::min( level, (int)this->lod_levels_.size() - 1 ) );
+  return this->lod_levels_[level];
+}
 
-  vtkSmartPointer<vtkPolyDataNormals> normals = vtkSmartPointer<vtkPolyDataNormals>::New();
-  normals->SetInputData( poly_data );
-  normals->Update();
-  poly_data = normals->GetOutput();
+//-----------------------------------------------------------------------------
+double Structure::get_path_length( long id_a, long id_b )
+{
+  return this->path_index_->get_distance_by_id( *this->graph_, id_a, id_b );
+}
 
-  this->mesh_ = poly_data;
+//-----------------------------------------------------------------------------
+const SkeletonPathIndex& Structure::get_path_index()
+{
+  return *this->path_index_;
+}
 
-  return this->mesh_;
+//-----------------------------------------------------------------------------
+const GeometryProperties& Structure::get_geometry_properties()
+{
+  return this->geometry_;
 }
 
 //-----------------------------------------------------------------------------
-void Structure::add_polydata( QSharedPointer<Node> n, int from, vtkSmartPointer<vtkAppendPolyData> append, QList<int> current_line )
+const Morphometrics& Structure::get_morphometrics()
 {
-  this->node_map_[n->id]->visited = true;
+  return this->morphometrics_;
+}
 
-  if ( n->linked_nodes.size() == 2 )
-  {
-    current_line.append( n->id );
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> Structure::get_mesh_tubes()
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
+  this->build_tubes();
+  return this->mesh_->get_poly_data();
+}
 
-    for ( int i = 0; i < n->linked_nodes.size(); i++ )
-    {
-      QSharedPointer<Node> other = this->node_map_[n->linked_nodes[i]];
-      if ( !other->visited )
-      {
-        this->add_polydata( other, n->id, append, current_line );
-      }
-    }
+//-----------------------------------------------------------------------------
+void Structure::build_tubes()
+{
+  if ( this->mesh_ )
+  {
+    return;
   }
 
-  /*
-     // add a circle at every location
-     vtkSmartPointer<vtkRegularPolygonSource> circle = vtkSmartPointer<vtkRegularPolygonSource>::New();
-     circle->GeneratePolygonOff();
-     circle->SetNumberOfSides( 12 );
-     circle->SetRadius( n->radius );
-     circle->SetCenter( n->x, n->y, n->z );
-     circle->Update();
-     append->AddInputData( circle->GetOutput() );
-     /**/
-
-  if ( n->linked_nodes.size() != 2 )
+  // pieces that did not change since the last mesh are copied, so this is cheap after an edit
+  this->tube_cache_->update( *this->graph_ );
+
+  // the mesher writes the surface normals of the tubes and spheres, and the decimation carries them over
+  this->mesh_ = this->decimate( this->tube_cache_->get_mesh() );
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> Structure::get_mesh_union()
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
+  this->build_union();
+  return this->union_mesh_->get_poly_data();
+}
+
+//-----------------------------------------------------------------------------
+void Structure::build_union()
+{
+  if ( this->union_mesh_ )
   {
+    return;
+  }
 
-    /* sphere */
-    vtkSmartPointer<vtkSphereSource> sphere = vtkSmartPointer<vtkSphereSource>::New();
-    sphere->SetCenter( n->x, n->y, n->z );
-    sphere->SetRadius( n->radius * 1.05 );
-    //sphere->SetRadius( n.radius );
+#ifdef VIKING_USE_CGAL
+  if ( this->union_extraction_ == Structure::SKIN_SURFACE )
+  {
+    SkinMesher mesher;
+    this->union_mesh_ = this->decimate( CompactMesh::create_mesh( mesher.generate( this ) ) );
 
-    int resolution = 10;
-    if ( n->radius > 1.0 )
-    {
-      resolution = resolution * n->radius;
-    }
+    // ball placement stands in for the index, the skin mesh for the extraction
+    const SkinMeshStats &stats = mesher.get_stats();
+    this->union_stats_ = UnionMeshStats();
+    this->union_stats_.num_triangles = stats.num_triangles;
+    this->union_stats_.index_time = stats.sample_time;
+    this->union_stats_.extract_time = stats.mesh_time;
 
-    resolution = 15;
+    return;
+  }
+#endif
+
+  // the normals come from the distance gradient and are carried through the decimation
+  UnionMesher mesher;
+  mesher.set_voxel_size( this->union_voxel_size_ );
+  mesher.set_extraction( (UnionMesher::Extraction)this->union_extraction_ );
+  this->union_mesh_ = this->decimate( CompactMesh::create_mesh( mesher.generate( *this->graph_ ) ) );
+  this->union_stats_ = mesher.get_stats();
+}
 
-    sphere->SetPhiResolution( resolution );
-    sphere->SetThetaResolution( resolution );
-    sphere->Update();
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> Structure::get_mesh()
+{
+  if ( this->get_union_surface() )
+  {
+    return this->get_mesh_union();
+  }
+  return this->get_mesh_tubes();
+}
 
-    vtkSmartPointer<vtkPolyData> poly_data = vtkSmartPointer<vtkPolyData>::New();
-    poly_data = sphere->GetOutput();
+//-----------------------------------------------------------------------------
+void Structure::build_meshes()
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
 
-/*
-    vtkSmartPointer<vtkUnsignedCharArray> colors =
-      vtkSmartPointer<vtkUnsignedCharArray>::New();
-    colors->SetNumberOfComponents( 3 );
-    colors->SetName( "Colors" );
-
-    int r = 128 + ( qrand() % 128 );
-    int g = 128 + ( qrand() % 128 );
-    int b = 128 + ( qrand() % 128 );
-    for ( int i = 0; i < poly_data->GetNumberOfPoints(); ++i )
-    {
-      unsigned char tempColor[3] =
-      {r, g, b};
+  this->build_coarse_tubes();
+  if ( this->union_surface_ )
+  {
+    this->build_union();
+  }
+  else
+  {
+    this->build_tubes();
+  }
+}
 
-      colors->InsertNextTupleValue( tempColor );
-    }
-    //poly_data->GetPointData()->SetScalars( colors );
- */
+//-----------------------------------------------------------------------------
+MeshMemoryStats Structure::get_mesh_memory()
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
 
-/*
-    vtkSmartPointer< vtkTriangleFilter > triangle_filter = vtkSmartPointer< vtkTriangleFilter >::New();
-    triangle_filter->SetInputData( poly_data );
-    //    triangle_filter->PassLinesOff();
-    triangle_filter->Update();
-    poly_data = triangle_filter->GetOutput();
-
-    std::cerr << "Number of points before cleaning: " << poly_data->GetNumberOfPoints() << "\n";
-    vtkSmartPointer<vtkCleanPolyData> clean = vtkSmartPointer<vtkCleanPolyData>::New();
-    clean->SetInputData( poly_data );
-    //clean->SetTolerance( 0.00001 );
-    clean->Update();
-    poly_data = clean->GetOutput();
-    std::cerr << "Number of points after cleaning: " << poly_data->GetNumberOfPoints() << "\n";
-
-    this->num_tubes_++;
-    //QString filename = QString("C:\\Users\\amorris\\part") + QString::number(this->num_tubes_) + ".ply";
-    QString filename = QString("C:\\Users\\amorris\\part") + QString::number(this->num_tubes_) + ".vtk";
-    vtkSmartPointer<vtkPolyDataWriter> writer4 = vtkSmartPointer<vtkPolyDataWriter>::New();
-    //vtkSmartPointer<vtkPLYWriter> writer4 = vtkSmartPointer<vtkPLYWriter>::New();
-    writer4->SetFileName( filename );
-    writer4->SetInputData( poly_data );
-    //writer4->SetFileTypeToBinary();
-    writer4->Write();
- */
+  MeshMemoryStats stats;
+  QList<QSharedPointer<CompactMesh> > meshes;
+  meshes << this->mesh_ << this->coarse_mesh_ << this->union_mesh_;
 
-    append->AddInputData( poly_data );
+  // the full resolution tubes are the tube mesh itself unless that was decimated
+  if ( this->tube_cache_->get_mesh() != this->mesh_ )
+  {
+    meshes << this->tube_cache_->get_mesh();
+  }
 
-    if ( current_line.size() > 0 )
+  foreach( QSharedPointer<CompactMesh> mesh, meshes ) {
+    if ( mesh )
     {
-      current_line.append( n->id );
-
-      vtkSmartPointer<vtkPoints> vtk_points = vtkSmartPointer<vtkPoints>::New();
-      vtkSmartPointer<vtkCellArray> lines = vtkSmartPointer<vtkCellArray>::New();
-      lines->InsertNextCell( current_line.size() );
-      vtkSmartPointer<vtkDoubleArray> tube_radius_array = vtkSmartPointer<vtkDoubleArray>::New();
-      tube_radius_array->SetName( "tube_radius" );
-
-      vtkSmartPointer<vtkTupleInterpolator> interpolated_radius = vtkSmartPointer<vtkTupleInterpolator> ::New();
-      interpolated_radius->SetInterpolationTypeToLinear();
-      //interpolated_radius->SetInterpolationTypeToSpline();
-      interpolated_radius->SetNumberOfComponents( 1 );
-
-      int count = 0;
-      foreach( int node_id, current_line ) {
-        QSharedPointer<Node> node = this->node_map_[node_id];
-
-        vtk_points->InsertNextPoint( node->x, node->y, node->z );
-        lines->InsertCellPoint( count );
-        tube_radius_array->InsertNextTuple1( node->radius );
-        interpolated_radius->AddTuple( count, &( node->radius ) );
-        count++;
-      }
+      stats.compact_bytes += mesh->get_memory_size();
+      stats.live_vtk_bytes += mesh->get_live_memory_size();
+      stats.old_vtk_bytes += mesh->get_vtk_memory_size();
+    }
+  }
 
-      vtkSmartPointer<vtkParametricSpline> spline = vtkSmartPointer<vtkParametricSpline>::New();
-      //vtkSmartPointer<vtkCardinalSpline> spline = vtkSmartPointer<vtkCardinalSpline>::New();
-      spline->SetPoints( vtk_points );
-
-      // Interpolate the points
-      vtkSmartPointer<vtkParametricFunctionSource> function_source =
-        vtkSmartPointer<vtkParametricFunctionSource>::New();
-      function_source->SetParametricFunction( spline );
-      //function_source->SetUResolution( 30 * vtk_points->GetNumberOfPoints() );
-      function_source->SetUResolution( 2 * vtk_points->GetNumberOfPoints() );
-      //function_source->SetUResolution( vtk_points->GetNumberOfPoints() );
-
-      function_source->Update();
-
-      vtkSmartPointer<vtkPolyData> poly_data = vtkSmartPointer<vtkPolyData>::New();
-      poly_data->SetPoints( vtk_points );
-      poly_data->SetLines( lines );
-      //poly_data->GetPointData()->AddArray( tube_radius_array );
-      //poly_data->GetPointData()->SetActiveScalars( "tube_radius" );
-
-      //append->AddInputData(function_source->GetOutput());
-      // tmp: add line instead
-      //append->AddInputData( poly_data );
-
-      // Generate the radius scalars
-      vtkSmartPointer<vtkDoubleArray> tube_radius = vtkSmartPointer<vtkDoubleArray>::New();
-      unsigned int n = function_source->GetOutput()->GetNumberOfPoints();
-      tube_radius->SetNumberOfTuples( n );
-      tube_radius->SetName( "TubeRadius" );
-      double tMin = interpolated_radius->GetMinimumT();
-      double tMax = interpolated_radius->GetMaximumT();
-      double radius;
-      for ( unsigned int i = 0; i < n; ++i )
-      {
-        double t = ( tMax - tMin ) / ( n - 1 ) * i + tMin;
-        interpolated_radius->InterpolateTuple( t, &radius );
-        tube_radius->SetTuple1( i, radius );
-      }
+  if ( this->lines_mesh_ )
+  {
+    size_t lines_bytes = (size_t)this->lines_mesh_->GetActualMemorySize() * 1024;
+    stats.live_vtk_bytes += lines_bytes;
+    stats.old_vtk_bytes += lines_bytes;
+  }
 
-      // Add the scalars to the polydata
-      vtkSmartPointer<vtkPolyData> tube_poly_data = vtkSmartPointer<vtkPolyData>::New();
-      tube_poly_data = function_source->GetOutput();
-      tube_poly_data->GetPointData()->AddArray( tube_radius );
-      tube_poly_data->GetPointData()->SetActiveScalars( "TubeRadius" );
+  return stats;
+}
 
-      vtkSmartPointer<vtkTubeFilter> tube = vtkSmartPointer<vtkTubeFilter>::New();
-      //tube->SetInputData( poly_data );
+//-----------------------------------------------------------------------------
+QSharedPointer<CompactMesh> Structure::decimate( QSharedPointer<CompactMesh> mesh )
+{
+  int num_triangles = mesh->get_num_triangles();
 
-      tube->SetInputData( tube_poly_data );
+  this->decimation_stats_ = DecimationStats();
+  this->decimation_stats_.input_triangles = num_triangles;
+  this->decimation_stats_.output_triangles = num_triangles;
 
-      tube->CappingOn();
-      tube->SetVaryRadiusToVaryRadiusByAbsoluteScalar();
+  if ( this->triangle_budget_ <= 0 || num_triangles <= this->triangle_budget_ )
+  {
+    return mesh;
+  }
 
-      //tube->SetRadius(n.radius);
-      //tube->SetRadius( 0.1 );
-      tube->SetNumberOfSides( 15 );
-      tube->Update();
+  // the VTK copy only lives as long as the decimation
+  vtkSmartPointer<customQuadricDecimation> decimation = vtkSmartPointer<customQuadricDecimation>::New();
+  decimation->SetInputData( mesh->get_poly_data() );
+  decimation->SetTargetReduction( 1.0 - (double)this->triangle_budget_ / num_triangles );
+  // only splits meshes that are large enough to be worth it
+  decimation->SetNumberOfPartitions( QThread::idealThreadCount() );
+  decimation->Update();
 
-      poly_data = tube->GetOutput();
+  this->decimation_stats_.output_triangles = decimation->GetOutput()->GetNumberOfPolys();
+  this->decimation_stats_.reduction = decimation->GetActualReduction();
+  this->decimation_stats_.max_error = decimation->GetMaximumError();
+  this->decimation_stats_.topology_rejections = decimation->GetNumberOfTopologyRejections();
 
-      /* //color
-         vtkSmartPointer<vtkUnsignedCharArray> colors =
-         vtkSmartPointer<vtkUnsignedCharArray>::New();
-         colors->SetNumberOfComponents( 3 );
-         colors->SetName( "Colors" );
+  return CompactMesh::create_mesh( decimation->GetOutput() );
+}
 
-         int r = 128 + ( qrand() % 128 );
-         int g = 128 + ( qrand() % 128 );
-         int b = 128 + ( qrand() % 128 );
+//-----------------------------------------------------------------------------
+void Structure::set_union_surface( bool enabled )
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
+  this->union_surface_ = enabled;
+}
 
-         for ( int i = 0; i < poly_data->GetNumberOfPoints(); ++i )
-         {
-         unsigned char tempColor[3] =
-         {r, g, b};
+//-----------------------------------------------------------------------------
+bool Structure::get_union_surface()
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
+  return this->union_surface_;
+}
 
-         colors->InsertNextTupleValue( tempColor );
-         }
+//-----------------------------------------------------------------------------
+void Structure::set_union_voxel_size( double voxel_size )
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
 
-         //poly_data->GetPointData()->SetScalars( colors );
-       */
+  if ( voxel_size != this->union_voxel_size_ )
+  {
+    this->union_voxel_size_ = voxel_size;
+    this->union_mesh_.clear();
+  }
+}
 
-      // here
-      append->AddInputData( poly_data );
+//-----------------------------------------------------------------------------
+void Structure::set_union_extraction( int extraction )
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
 
-/*
+  if ( extraction != this->union_extraction_ )
+  {
+    this->union_extraction_ = extraction;
+    this->union_mesh_.clear();
+  }
+}
 
+//-----------------------------------------------------------------------------
+const UnionMeshStats& Structure::get_union_stats()
+{
+  return this->union_stats_;
+}
 
-      vtkSmartPointer< vtkTriangleFilter > triangle_filter = vtkSmartPointer< vtkTriangleFilter >::New();
-      triangle_filter->SetInputData( poly_data );
-      //    triangle_filter->PassLinesOff();
-      triangle_filter->Update();
-      poly_data = triangle_filter->GetOutput();
+//-----------------------------------------------------------------------------
+void Structure::set_mesh_tolerance( double tolerance )
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
 
-      std::cerr << "Number of points before cleaning: " << poly_data->GetNumberOfPoints() << "\n";
-      vtkSmartPointer<vtkCleanPolyData> clean = vtkSmartPointer<vtkCleanPolyData>::New();
-      clean->SetInputData( poly_data );
-      //clean->SetTolerance( 0.00001 );
-      clean->Update();
-      poly_data = clean->GetOutput();
-      std::cerr << "Number of points after cleaning: " << poly_data->GetNumberOfPoints() << "\n";
+  if ( tolerance != this->mesh_tolerance_ )
+  {
+    this->mesh_tolerance_ = tolerance;
+    this->mesh_.clear();
+    this->coarse_mesh_.clear();
 
+    SkeletonMesher mesher;
+    mesher.set_tolerance( tolerance );
+    this->tube_cache_->set_mesher( mesher );
+  }
+}
 
+//-----------------------------------------------------------------------------
+void Structure::set_triangle_budget( int triangles )
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
 
-      this->num_tubes_++;
-      //QString filename = QString("C:\\Users\\amorris\\part") + QString::number(this->num_tubes_) + ".ply";
-      QString filename = QString("C:\\Users\\amorris\\part") + QString::number(this->num_tubes_) + ".vtk";
-      //vtkSmartPointer<vtkPLYWriter> writer4 = vtkSmartPointer<vtkPLYWriter>::New();
-      vtkSmartPointer<vtkPolyDataWriter> writer4 = vtkSmartPointer<vtkPolyDataWriter>::New();
-      writer4->SetFileName( filename );
-      writer4->SetInputData( poly_data );
-      //writer4->SetFileTypeToBinary();
-      writer4->Write();
+  if ( triangles != this->triangle_budget_ )
+  {
+    this->triangle_budget_ = triangles;
+    this->mesh_.clear();
+    this->union_mesh_.clear();
+  }
+}
 
+//-----------------------------------------------------------------------------
+int Structure::get_triangle_budget()
+{
+  return this->triangle_budget_;
+}
 
-      filename = QString("C:\\Users\\amorris\\part") + QString::number(this->num_tubes_) + ".stl";
-      vtkSmartPointer<vtkSTLWriter> writer = vtkSmartPointer<vtkSTLWriter>::New();
-      writer->SetFileName( filename );
-      writer->SetInputData( poly_data );
-      writer->Write();
+//-----------------------------------------------------------------------------
+const DecimationStats& Structure::get_decimation_stats()
+{
+  return this->decimation_stats_;
+}
 
- */
+//-----------------------------------------------------------------------------
+void Structure::split_triangle_budget( QList<QSharedPointer<Structure> > structures, int budget )
+{
+  // even the smallest structure keeps a recognizable shape
+  const int min_triangles = 100;
+
+  double total_volume = 0;
+  foreach( QSharedPointer<Structure> s, structures ) {
+    total_volume += std::max( 0.0, s->get_volume() );
+  }
+
+  foreach( QSharedPointer<Structure> s, structures ) {
+    if ( budget <= 0 )
+    {
+      s->set_triangle_budget( 0 );
+      continue;
     }
 
-    for ( int i = 0; i < n->linked_nodes.size(); i++ )
+    double share = 1.0 / structures.size();
+    if ( total_volume > 0 )
     {
-      QSharedPointer<Node> other = this->node_map_[n->linked_nodes[i]];
-      if ( !other->visited )
-      {
-        QList<int> new_line;
-        new_line.append( n->id );
-        this->add_polydata( other, n->id, append, new_line );
-      }
+      share = std::max( 0.0, s->get_volume() ) / total_volume;
     }
+
+    s->set_triangle_budget( std::max( min_triangles, (int)( share * budget ) ) );
+  }
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> Structure::get_mesh_coarse_tubes()
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
+  this->build_coarse_tubes();
+  return this->coarse_mesh_->get_poly_data();
+}
+
+//-----------------------------------------------------------------------------
+void Structure::build_coarse_tubes()
+{
+  if ( this->coarse_mesh_ )
+  {
+    return;
   }
+
+  // simplified skeleton, one sample per node and few sides
+  SkeletonMesher mesher;
+  mesher.set_tolerance( std::max( 0.05, 5.0 * this->mesh_tolerance_ ) );
+  mesher.set_side_limits( 4, 8 );
+  mesher.set_samples_per_node( 1 );
+  MeshBuffer mesh = mesher.generate( *this->graph_, this->get_lod_level( 2 ).segments );
+
+  this->coarse_mesh_ = CompactMesh::create_mesh( mesh );
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> Structure::get_mesh_lines()
+{
+  QMutexLocker locker( &this->mesh_mutex_ );
+
+  if ( !this->lines_mesh_ )
+  {
+    this->lines_mesh_ = SkeletonMesher::create_lines( *this->graph_, this->get_lod_level( 1 ).segments );
+  }
+
+  return this->lines_mesh_;
 }
@@ -5,11 +5,20 @@
 #include <QSharedPointer.h>
 #include <QHash.h>
 #include <QColor.h>
+#include <QMutex>
 
 #include <vtkSmartPointer.h>
 
+#include <Data/SkeletonLOD.h>
+#include <Data/SkeletonGeometry.h>
+#include <Data/Morphometrics.h>
+#include <Data/UnionMesher.h>
+#include <Data/TubeMeshCache.h>
+#include <Data/CompactMesh.h>
+
 class vtkPolyData;
-class vtkAppendPolyData;
+class SkeletonGraph;
+class SkeletonPathIndex;
 
 class Node
 {
@@ -31,6 +40,25 @@ public:
 };
 
 
+//! Result of the decimation stage of a structure mesh
+class DecimationStats
+{
+public:
+  DecimationStats();
+
+  int input_triangles;
+  int output_triangles;
+
+  /// fraction of the input triangles removed
+  double reduction;
+
+  /// largest collapse error (see customQuadricDecimation::GetMaximumError)
+  double max_error;
+
+  /// collapses refused because they would change the topology
+  int topology_rejections;
+};
+
 class Structure;
 
 typedef QHash<long, QSharedPointer<Structure> > StructureHash;
@@ -61,12 +89,68 @@ public:
   QList<Link> get_links();
 
   vtkSmartPointer<vtkPolyData> get_mesh_old();
+
+#ifdef VIKING_USE_CGAL
+  /// alpha shape of points sampled on the links, repaired (see MeshRepair) and smoothed, not cached
   vtkSmartPointer<vtkPolyData> get_mesh_alpha();
-  vtkSmartPointer<vtkPolyData> get_mesh_union();
+#endif
   vtkSmartPointer<vtkPolyData> get_mesh_parts();
+
+  /// watertight surface of the union of the tubes and spheres (see UnionMesher), cached like the tubes
+  vtkSmartPointer<vtkPolyData> get_mesh_union();
+
+  /// generated on first use and cached as a CompactMesh, safe to call from worker threads
   vtkSmartPointer<vtkPolyData> get_mesh_tubes();
 
+  /// full detail mesh: the union surface if enabled, the tubes otherwise
+  vtkSmartPointer<vtkPolyData> get_mesh();
+
+  /// generate and cache the full detail and coarse meshes without converting them to VTK, for worker threads
+  void build_meshes();
+
+  /// memory of the cached meshes, kept as CompactMesh, and of their VTK copies that are alive for rendering
+  MeshMemoryStats get_mesh_memory();
+
+  /// use the union surface instead of the tubes as the full detail mesh
+  void set_union_surface( bool enabled );
+  bool get_union_surface();
+
+  /// grid spacing of the union surface (0: automatic), drops the cached union mesh if it changes
+  void set_union_voxel_size( double voxel_size );
+
+  /// surface extraction of the union surface (a UnionMesher::Extraction or SKIN_SURFACE), drops the cached union
+  /// mesh if it changes
+  void set_union_extraction( int extraction );
+
+  /// union extraction that meshes a union of balls exactly with CGAL (see SkinMesher), only with USE_CGAL
+  static const int SKIN_SURFACE = 2;
+
+  /// grid size and stage timing of the last union mesh
+  const UnionMeshStats& get_union_stats();
+
+  /// reduced tube mesh on a simplified skeleton, for interactive rendering
+  vtkSmartPointer<vtkPolyData> get_mesh_coarse_tubes();
+
+  /// skeleton polylines, the cheapest level of detail
+  vtkSmartPointer<vtkPolyData> get_mesh_lines();
+
+  /// chordal error tolerance of the tube meshes, drops the cached meshes if it changes
+  void set_mesh_tolerance( double tolerance );
+
+  /// triangle budget of the tube mesh (0: no decimation), drops the cached mesh if it changes
+  void set_triangle_budget( int triangles );
+  int get_triangle_budget();
+
+  /// reduction and error of the last decimation of a full detail mesh
+  const DecimationStats& get_decimation_stats();
+
+  /// split a scene wide triangle budget across structures by volume
+  static void split_triangle_budget( QList<QSharedPointer<Structure> > structures, int budget );
+
+  /// volume and surface area computed from the skeleton (see SkeletonGeometry)
   double get_volume();
+  double get_surface_area();
+  const GeometryProperties& get_geometry_properties();
 
   QString get_center_of_mass_string();
 
@@ -79,13 +163,41 @@ public:
 
   vtkSmartPointer<vtkPolyData> recopy_mesh( vtkSmartPointer<vtkPolyData> mesh );
 
+  /// compact copy of the node/link graph, built after location culling
+  const SkeletonGraph& get_skeleton_graph();
+
+  /// skeleton levels of detail, level 0 is the full skeleton
+  int get_num_lod_levels();
+  const SkeletonLevel& get_lod_level( int level );
+
+  /// cable length, branching and path measurements (see Morphometrics)
+  const Morphometrics& get_morphometrics();
+
+  /// distance along the skeleton between two node ids (-1 if not connected)
+  double get_path_length( long id_a, long id_b );
+
+  /// constant time path length queries (see SkeletonPathIndex)
+  const SkeletonPathIndex& get_path_index();
+
+  /// annotation edits, the skeleton is rebuilt and only the tube pieces they touch are remeshed (see
+  /// TubeMeshCache); the coarse, line and union meshes are dropped and rebuilt in full on next use, as is
+  /// the tube mesh when it was decimated. Nothing in the application edits annotations yet, these are
+  /// the entry points for an editor, with Viewer::update_structure to redisplay the structure.
+  void move_node( long id, double x, double y, double z, double radius );
+
+  /// add a node linked to an existing one (or to none if linked_id is not a node of this structure)
+  void add_node( long id, double x, double y, double z, double radius, long linked_id );
+
+  /// remove a node and its links
+  void remove_node( long id );
+
+  /// what the last remesh of the tubes copied and regenerated
+  const TubeMeshUpdateStats& get_tube_update_stats();
+
 private:
 
   Structure(); // private
 
-  void add_polydata( QSharedPointer<Node> n, int from, vtkSmartPointer<vtkAppendPolyData> append, 
-    QList<int> current_line );
-
   static double distance( const QSharedPointer<Node> &n1, const QSharedPointer<Node> &n2 );
 
   void connect_subgraphs();
@@ -94,17 +206,51 @@ private:
 
   void link_report();
 
+  void build_skeleton();
+
+  /// levels of detail, geometry, morphometrics and path index of the current graph
+  void update_skeleton_properties();
+
+  /// bring the tube mesh up to date after an edit of a node (-1 after a change of the topology)
+  void remesh_tubes( long id );
+
+  /// reduce a mesh to the triangle budget and record the decimation stats
+  QSharedPointer<CompactMesh> decimate( QSharedPointer<CompactMesh> mesh );
+
+  /// fill in the cached meshes if they are missing, with the mesh mutex held
+  void build_tubes();
+  void build_union();
+  void build_coarse_tubes();
+
   int id_;
   int type_;
   NodeMap node_map_;
 
   QList<Link> links_;
-  vtkSmartPointer<vtkPolyData> mesh_;
+  QSharedPointer<CompactMesh> mesh_;
+  QSharedPointer<CompactMesh> coarse_mesh_;
+  vtkSmartPointer<vtkPolyData> lines_mesh_;
+  QSharedPointer<CompactMesh> union_mesh_;
+  QMutex mesh_mutex_;
+  double mesh_tolerance_;
+  int triangle_budget_;
+  DecimationStats decimation_stats_;
+  bool union_surface_;
+  double union_voxel_size_;
+  int union_extraction_;
+  UnionMeshStats union_stats_;
 
   QColor color_;
 
   int num_tubes_;
 
+  QSharedPointer<SkeletonGraph> graph_;
+  QSharedPointer<SkeletonPathIndex> path_index_;
+  QSharedPointer<TubeMeshCache> tube_cache_;
+  std::vector<SkeletonLevel> lod_levels_;
+  GeometryProperties geometry_;
+  Morphometrics morphometrics_;
+
 //  float color_[3];
 };
 
@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <cstring>
+
+#include <QtConcurrentMap>
+
+#include <vtkTimerLog.h>
+
+#include <Data/TubeMeshCache.h>
+#include <Data/SkeletonGraph.h>
+
+//-----------------------------------------------------------------------------
+TubeMeshUpdateStats::TubeMeshUpdateStats()
+{
+  this->num_pieces = 0;
+  this->regenerated_pieces = 0;
+  this->patched = false;
+  this->update_time = 0;
+}
+
+//-----------------------------------------------------------------------------
+TubeMeshCache::TubeMeshCache()
+{}
+
+//-----------------------------------------------------------------------------
+void TubeMeshCache::set_mesher( const SkeletonMesher &mesher )
+{
+  this->mesher_ = mesher;
+  this->clear();
+}
+
+//-----------------------------------------------------------------------------
+void TubeMeshCache::clear()
+{
+  this->pieces_.clear();
+  this->mesh_.clear();
+  this->node_pieces_.clear();
+  this->spheres_.clear();
+  this->tubes_.clear();
+}
+
+//-----------------------------------------------------------------------------
+QSharedPointer<CompactMesh> TubeMeshCache::get_mesh()
+{
+  return this->mesh_;
+}
+
+//-----------------------------------------------------------------------------
+const TubeMeshUpdateStats& TubeMeshCache::get_stats() const
+{
+  return this->stats_;
+}
+
+//-----------------------------------------------------------------------------
+void TubeMeshCache::update( const SkeletonGraph &graph )
+{
+  double start_time = vtkTimerLog::GetUniversalTime();
+
+  // same pieces in the same order as SkeletonMesher::generate
+  std::vector<Piece> pieces;
+  Piece piece;
+
+  piece.sphere = true;
+  for ( int i = 0; i < graph.get_num_nodes(); i++ )
+  {
+    if ( graph.get_degree( i ) != 2 )
+    {
+      piece.ids.assign( 1, graph.get_id( i ) );
+      this->measure_piece( graph, piece );
+      pieces.push_back( piece );
+    }
+  }
+
+  piece.sphere = false;
+  const std::vector< std::vector<int> > &segments = graph.get_segments();
+  for ( unsigned int i = 0; i < segments.size(); i++ )
+  {
+    int size = (int)segments[i].size();
+    if ( size < 2 )
+    {
+      continue;
+    }
+
+    piece.ids.resize( size );
+    for ( int j = 0; j < size; j++ )
+    {
+      piece.ids[j] = graph.get_id( segments[i][j] );
+    }
+
+    // a fixed direction, so a tube is found again whichever way the graph walks it
+    if ( piece.ids[0] > piece.ids[size - 1] ||
+         ( piece.ids[0] == piece.ids[size - 1] && piece.ids[1] > piece.ids[size - 2] ) )
+    {
+      std::reverse( piece.ids.begin(), piece.ids.end() );
+    }
+
+    this->measure_piece( graph, piece );
+    pieces.push_back( piece );
+  }
+
+  std::vector<int> sources( pieces.size() );
+  for ( unsigned int i = 0; i < pieces.size(); i++ )
+  {
+    sources[i] = this->find_source( pieces[i] );
+  }
+
+  this->assemble( graph, pieces, sources );
+  this->stats_.update_time = vtkTimerLog::GetUniversalTime() - start_time;
+}
+
+//-----------------------------------------------------------------------------
+void TubeMeshCache::update_node( const SkeletonGraph &graph, long id )
+{
+  if ( !this->mesh_ )
+  {
+    this->update( graph );
+    return;
+  }
+
+  double start_time = vtkTimerLog::GetUniversalTime();
+
+  std::vector<Piece> pieces = this->pieces_;
+  std::vector<int> sources( pieces.size() );
+  for ( unsigned int i = 0; i < pieces.size(); i++ )
+  {
+    sources[i] = i;
+  }
+
+  foreach( int i, this->node_pieces_.value( id ) ) {
+    this->measure_piece( graph, pieces[i] );
+    sources[i] = -1;
+  }
+
+  this->assemble( graph, pieces, sources );
+  this->stats_.update_time = vtkTimerLog::GetUniversalTime() - start_time;
+}
+
+//-----------------------------------------------------------------------------
+void TubeMeshCache::measure_piece( const SkeletonGraph &graph, Piece &piece ) const
+{
+  int size = (int)piece.ids.size();
+  piece.nodes.resize( size );
+  piece.signature.resize( 4 * size );
+  for ( int i = 0; i < size; i++ )
+  {
+    int node = graph.get_index( piece.ids[i] );
+    const double* position = graph.get_position( node );
+    piece.nodes[i] = node;
+    piece.signature[4 * i] = position[0];
+    piece.signature[4 * i + 1] = position[1];
+    piece.signature[4 * i + 2] = position[2];
+    piece.signature[4 * i + 3] = graph.get_radius( node );
+  }
+
+  if ( piece.sphere )
+  {
+    this->mesher_.get_sphere_size( graph, piece.nodes[0], piece.num_points, piece.num_triangles );
+  }
+  else
+  {
+    this->mesher_.get_tube_size( graph, piece.nodes, piece.num_points, piece.num_triangles );
+  }
+}
+
+//-----------------------------------------------------------------------------
+int TubeMeshCache::find_source( const Piece &piece ) const
+{
+  int source = piece.sphere ? this->spheres_.value( piece.ids[0], -1 )
+               : this->tubes_.value( qMakePair( piece.ids[0], piece.ids[1] ), -1 );
+  if ( source < 0 )
+  {
+    return -1;
+  }
+
+  const Piece &cached = this->pieces_[source];
+  if ( cached.ids != piece.ids || cached.signature != piece.signature )
+  {
+    return -1;
+  }
+
+  return source;
+}
+
+//-----------------------------------------------------------------------------
+void TubeMeshCache::write_piece( PieceTask &task )
+{
+  const Piece &piece = *task.piece;
+
+  MeshBuffer buffer;
+  buffer.resize( piece.num_points, piece.num_triangles );
+  if ( piece.sphere )
+  {
+    task.mesher->write_sphere( *task.graph, piece.nodes[0], buffer, 0, 0 );
+  }
+  else
+  {
+    task.mesher->write_tube( *task.graph, piece.nodes, buffer, 0, 0 );
+  }
+
+  task.mesh->write( buffer, piece.first_point, piece.first_triangle );
+}
+
+//-----------------------------------------------------------------------------
+void TubeMeshCache::assemble( const SkeletonGraph &graph, std::vector<Piece> &pieces, const std::vector<int> &sources )
+{
+  int num_pieces = (int)pieces.size();
+
+  // the layout holds if every piece keeps its place and size
+  bool in_place = this->mesh_ && pieces.size() == this->pieces_.size();
+  for ( int i = 0; i < num_pieces && in_place; i++ )
+  {
+    const Piece &cached = this->pieces_[i];
+    in_place = sources[i] == i || ( sources[i] < 0 && pieces[i].sphere == cached.sphere &&
+                                    pieces[i].num_points == cached.num_points &&
+                                    pieces[i].num_triangles == cached.num_triangles );
+  }
+
+  QSharedPointer<CompactMesh> mesh = this->mesh_;
+
+  if ( in_place )
+  {
+    for ( int i = 0; i < num_pieces; i++ )
+    {
+      pieces[i].first_point = this->pieces_[i].first_point;
+      pieces[i].first_triangle = this->pieces_[i].first_triangle;
+    }
+  }
+  else
+  {
+    int num_points = 0;
+    int num_triangles = 0;
+    for ( int i = 0; i < num_pieces; i++ )
+    {
+      pieces[i].first_point = num_points;
+      pieces[i].first_triangle = num_triangles;
+      num_points += pieces[i].num_points;
+      num_triangles += pieces[i].num_triangles;
+    }
+
+    mesh = QSharedPointer<CompactMesh>( new CompactMesh() );
+    mesh->resize( num_points, num_triangles );
+
+    // unchanged pieces are copied from the old mesh
+    for ( int i = 0; i < num_pieces; i++ )
+    {
+      if ( sources[i] >= 0 )
+      {
+        const Piece &cached = this->pieces_[sources[i]];
+        mesh->copy( *this->mesh_, cached.first_point, cached.num_points, cached.first_triangle,
+                    cached.num_triangles, pieces[i].first_point, pieces[i].first_triangle );
+      }
+    }
+  }
+
+  PieceTask task;
+  task.mesher = &this->mesher_;
+  task.graph = &graph;
+  task.mesh = mesh.data();
+
+  std::vector<PieceTask> tasks;
+  int regenerated_points = 0;
+  for ( int i = 0; i < num_pieces; i++ )
+  {
+    if ( sources[i] < 0 )
+    {
+      task.piece = &pieces[i];
+      tasks.push_back( task );
+      regenerated_points += pieces[i].num_points;
+    }
+  }
+
+  // every remeshed piece writes only its own range
+  if ( regenerated_points < 100000 )
+  {
+    for ( unsigned int i = 0; i < tasks.size(); i++ )
+    {
+      TubeMeshCache::write_piece( tasks[i] );
+    }
+  }
+  else
+  {
+    QtConcurrent::blockingMap( tasks, TubeMeshCache::write_piece );
+  }
+
+  // a poly data handed out for rendering sees the new points without being rebuilt
+  if ( in_place )
+  {
+    for ( unsigned int i = 0; i < tasks.size(); i++ )
+    {
+      mesh->update_poly_data( tasks[i].piece->first_point, tasks[i].piece->num_points );
+    }
+  }
+
+  this->mesh_ = mesh;
+  this->pieces_.swap( pieces );
+  this->index_pieces();
+
+  this->stats_ = TubeMeshUpdateStats();
+  this->stats_.num_pieces = num_pieces;
+  this->stats_.regenerated_pieces = (int)tasks.size();
+  this->stats_.patched = in_place;
+}
+
+//-----------------------------------------------------------------------------
+void TubeMeshCache::index_pieces()
+{
+  this->node_pieces_.clear();
+  this->spheres_.clear();
+  this->tubes_.clear();
+
+  for ( unsigned int i = 0; i < this->pieces_.size(); i++ )
+  {
+    const Piece &piece = this->pieces_[i];
+
+    // node indices are only good for the graph they were taken from
+    this->pieces_[i].nodes.clear();
+
+    for ( unsigned int j = 0; j < piece.ids.size(); j++ )
+    {
+      this->node_pieces_[piece.ids[j]].append( i );
+    }
+
+    if ( piece.sphere )
+    {
+      this->spheres_.insert( piece.ids[0], i );
+    }
+    else
+    {
+      this->tubes_.insert( qMakePair( piece.ids[0], piece.ids[1] ), i );
+    }
+  }
+}
@@ -0,0 +1,135 @@
+#ifndef VIKING_DATA_TUBEMESHCACHE_H
+#define VIKING_DATA_TUBEMESHCACHE_H
+
+#include <vector>
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSharedPointer>
+
+#include <Data/SkeletonMesher.h>
+#include <Data/CompactMesh.h>
+
+class SkeletonGraph;
+
+//! What the last update of a TubeMeshCache remeshed
+class TubeMeshUpdateStats
+{
+public:
+  TubeMeshUpdateStats();
+
+  /// spheres and tubes in the mesh, and how many of them were meshed again (the rest were copied)
+  int num_pieces;
+  int regenerated_pieces;
+
+  /// the new points were written into the existing mesh instead of a new one
+  bool patched;
+
+  double update_time;
+};
+
+//! Sphere and tube mesh of a skeleton, kept per segment so that edits remesh only what they touch
+/*!
+ * Every sphere (on a branch or end node) and every tube (along an
+ * unbranched segment) is a piece that remembers the ids of its nodes, and
+ * the positions and radii they had when it was meshed.  Pieces are found by
+ * node id (spheres) or by the ids of their first link (tubes, which are kept
+ * in a fixed direction), and a map from node ids to the pieces that use
+ * them finds everything a moved node affects.
+ *
+ * update() compares the pieces of a rebuilt graph with the cached ones and
+ * remeshes only those whose nodes changed, so an added branch or a deleted
+ * node costs the segments and junctions around it.  update_node() skips the
+ * comparison for a node that only moved.
+ *
+ * The mesh is kept as a CompactMesh.  If the remeshed pieces keep their
+ * sizes (a moved node does unless the number of sides changes with the
+ * radius) and no pieces come or go, their points and normals are written
+ * straight into its arrays, and into the poly data it has handed out for
+ * rendering, so the same mesh stays valid.  Otherwise a new mesh is
+ * assembled, copying the unchanged pieces from the old one.  Pieces are
+ * meshed with the same two pass layout as SkeletonMesher::generate, in
+ * parallel when there are many.
+ */
+class TubeMeshCache
+{
+
+public:
+  TubeMeshCache();
+
+  /// resolution of the spheres and tubes, drops the cached mesh
+  void set_mesher( const SkeletonMesher &mesher );
+
+  void clear();
+
+  /// bring the mesh up to date with the graph, copying the pieces whose nodes did not change
+  void update( const SkeletonGraph &graph );
+
+  /// remesh the pieces that use a node after it moved or changed radius (see SkeletonGraph::set_node)
+  void update_node( const SkeletonGraph &graph, long id );
+
+  /// the assembled mesh, the same object as long as updates keep the layout
+  QSharedPointer<CompactMesh> get_mesh();
+
+  const TubeMeshUpdateStats& get_stats() const;
+
+private:
+
+  //! a sphere or a tube and where it is in the mesh
+  class Piece
+  {
+  public:
+    bool sphere;
+
+    /// node id of a sphere, or the node ids along a tube
+    std::vector<long> ids;
+
+    /// node indices in the graph being meshed, only valid during an update
+    std::vector<int> nodes;
+
+    /// positions and radii of the nodes when the piece was meshed
+    std::vector<double> signature;
+
+    int first_point;
+    int num_points;
+    int first_triangle;
+    int num_triangles;
+  };
+
+  //! a piece to mesh and the mesh it is written into
+  class PieceTask
+  {
+  public:
+    const SkeletonMesher* mesher;
+    const SkeletonGraph* graph;
+    const Piece* piece;
+    CompactMesh* mesh;
+  };
+
+  static void write_piece( PieceTask &task );
+
+  /// fill in the node indices, signature and size of a piece from the graph
+  void measure_piece( const SkeletonGraph &graph, Piece &piece ) const;
+
+  /// cached piece that can be copied for this one, -1 if it has to be meshed
+  int find_source( const Piece &piece ) const;
+
+  /// make the pieces the current mesh, sources give the cached piece to copy for each or -1 to mesh it
+  void assemble( const SkeletonGraph &graph, std::vector<Piece> &pieces, const std::vector<int> &sources );
+
+  void index_pieces();
+
+  SkeletonMesher mesher_;
+
+  std::vector<Piece> pieces_;
+  QSharedPointer<CompactMesh> mesh_;
+
+  QHash<long, QList<int> > node_pieces_;
+  QHash<long, int> spheres_;
+  QHash<QPair<long, long>, int> tubes_;
+
+  TubeMeshUpdateStats stats_;
+};
+
+#endif /* VIKING_DATA_TUBEMESHCACHE_H */
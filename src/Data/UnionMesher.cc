@@ -0,0 +1,1048 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include <QHash>
+#include <QtConcurrentMap>
+
+#include <vtkPolyData.h>
+#include <vtkTimerLog.h>
+
+#include <Data/UnionMesher.h>
+#include <Data/SkeletonGraph.h>
+#include <Data/CapsuleBVH.h>
+#include <Data/SparseDistanceGrid.h>
+#include <Data/MeshRepair.h>
+
+namespace
+{
+// cube corners, x fastest in the low bit
+const int CORNERS[8][3] = {
+  { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 },
+  { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 }
+};
+
+// cube edges, from the lower to the upper corner
+const int EDGES[12][2] = {
+  { 0, 1 }, { 1, 2 }, { 3, 2 }, { 0, 3 },
+  { 4, 5 }, { 5, 6 }, { 7, 6 }, { 4, 7 },
+  { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+};
+
+// cube faces, counter clockwise seen from outside the cube
+const int FACES[6][4] = {
+  { 0, 3, 2, 1 }, { 4, 5, 6, 7 }, { 0, 1, 5, 4 },
+  { 3, 7, 6, 2 }, { 0, 4, 7, 3 }, { 1, 2, 6, 5 }
+};
+
+//! marching cubes surface loops (as cube edges) for every corner sign combination
+/*!
+ * Built once when the program starts.  On every face the isoline runs from
+ * the edge where the boundary (counter clockwise) enters the inside to the
+ * next edge where it leaves, which keeps the inside corners of an ambiguous
+ * face apart.  Each cut edge belongs to two faces, once as an entry and once
+ * as an exit, so the segments close into loops, oriented so that a fan over
+ * a loop faces the outside.
+ *
+ * A fan diagonal between two cut edges of the same face could also be made
+ * by the cube on the other side of that face, giving a non-manifold edge.
+ * Loops where that can happen are flagged and get a vertex in the middle.
+ *
+ * For surface nets every loop is a cell vertex, except that a loop with both
+ * segments of an ambiguous face (a tunnel through the face) would join the
+ * four quads of that face along one edge.  Such a loop is split into two
+ * vertices, each taking one of the two segments, cut right after them.
+ */
+class CaseTable
+{
+public:
+  CaseTable()
+  {
+    int edge_of[8][8];
+    for ( int e = 0; e < 12; e++ )
+    {
+      edge_of[EDGES[e][0]][EDGES[e][1]] = e;
+      edge_of[EDGES[e][1]][EDGES[e][0]] = e;
+    }
+
+    // faces each edge lies on
+    int edge_faces[12][2];
+    int num_faces[12] = { 0 };
+    for ( int f = 0; f < 6; f++ )
+    {
+      for ( int m = 0; m < 4; m++ )
+      {
+        int e = edge_of[FACES[f][m]][FACES[f][( m + 1 ) % 4]];
+        edge_faces[e][num_faces[e]++] = f;
+      }
+    }
+
+    for ( int c = 0; c < 256; c++ )
+    {
+      signed char* next = this->next_edges[c];
+      for ( int e = 0; e < 12; e++ )
+      {
+        next[e] = -1;
+        this->prev_edges[c][e] = -1;
+        this->next_faces[c][e] = -1;
+        this->edge_vertices[c][e] = -1;
+      }
+      this->num_vertices[c] = 0;
+
+      for ( int f = 0; f < 6; f++ )
+      {
+        int cuts[4];
+        bool enters[4];
+        int num_cuts = 0;
+        for ( int m = 0; m < 4; m++ )
+        {
+          int a = FACES[f][m];
+          int b = FACES[f][( m + 1 ) % 4];
+          bool inside_a = ( c >> a ) & 1;
+          bool inside_b = ( c >> b ) & 1;
+          if ( inside_a != inside_b )
+          {
+            cuts[num_cuts] = edge_of[a][b];
+            enters[num_cuts] = inside_b;
+            num_cuts++;
+          }
+        }
+
+        // entries and exits alternate around the face
+        for ( int m = 0; m < num_cuts; m++ )
+        {
+          if ( enters[m] )
+          {
+            next[cuts[m]] = cuts[( m + 1 ) % num_cuts];
+            this->prev_edges[c][cuts[( m + 1 ) % num_cuts]] = cuts[m];
+            this->next_faces[c][cuts[m]] = f;
+          }
+        }
+      }
+
+      int count = 0;
+      bool used[12] = { false };
+      for ( int e = 0; e < 12; e++ )
+      {
+        if ( next[e] == -1 || used[e] )
+        {
+          continue;
+        }
+
+        int loop[12];
+        int length = 0;
+        for ( int i = e; !used[i]; i = next[i] )
+        {
+          used[i] = true;
+          loop[length++] = i;
+        }
+
+        // fan diagonals from loop[0] that lie in a face
+        bool center = false;
+        for ( int i = 2; i + 1 < length && !center; i++ )
+        {
+          for ( int m = 0; m < 2; m++ )
+          {
+            int f = edge_faces[loop[0]][m];
+            center = center || edge_faces[loop[i]][0] == f || edge_faces[loop[i]][1] == f;
+          }
+        }
+
+        this->loops[c][count++] = center ? -length : length;
+        for ( int i = 0; i < length; i++ )
+        {
+          this->loops[c][count++] = loop[i];
+          this->edge_vertices[c][loop[i]] = this->num_vertices[c];
+        }
+        this->num_vertices[c]++;
+
+        // segments of the same face, a loop has at most one such pair
+        for ( int i = 0; i < length; i++ )
+        {
+          for ( int j = i + 1; j < length; j++ )
+          {
+            if ( this->next_faces[c][loop[i]] != this->next_faces[c][loop[j]] )
+            {
+              continue;
+            }
+            for ( int k = i + 2; k <= j + 1; k++ )
+            {
+              this->edge_vertices[c][loop[k % length]] = this->num_vertices[c];
+            }
+            this->num_vertices[c]++;
+          }
+        }
+      }
+      this->loops[c][count] = 0;
+    }
+  }
+
+  /// per loop its length (negative: fan around a middle vertex) and its edges, 0 terminated
+  signed char loops[256][17];
+
+  /// surface nets cell vertex each cut edge belongs to, -1 for edges that are not cut
+  signed char edge_vertices[256][12];
+
+  signed char num_vertices[256];
+
+  /// per cut edge the next and previous edge of its loop, and the face of the segment to the next
+  signed char next_edges[256][12];
+  signed char prev_edges[256][12];
+  signed char next_faces[256][12];
+};
+
+const CaseTable CASES;
+}
+
+//-----------------------------------------------------------------------------
+UnionMeshStats::UnionMeshStats()
+{
+  this->voxel_size = 0;
+  this->dimensions[0] = this->dimensions[1] = this->dimensions[2] = 0;
+  this->num_capsules = 0;
+  this->num_tiles = 0;
+  this->num_leaves = 0;
+  this->grid_memory = 0;
+  this->dense_memory = 0;
+  this->num_triangles = 0;
+  this->non_manifold_edges = 0;
+  this->non_manifold_vertices = 0;
+  this->index_time = 0;
+  this->sample_time = 0;
+  this->extract_time = 0;
+}
+
+//-----------------------------------------------------------------------------
+UnionMesher::UnionMesher()
+{
+  this->voxel_size_ = 0;
+  this->max_voxels_ = 4.0 * 1024 * 1024 * 1024;
+  this->extraction_ = MARCHING_CUBES;
+}
+
+//-----------------------------------------------------------------------------
+void UnionMesher::set_extraction( Extraction extraction )
+{
+  this->extraction_ = extraction;
+}
+
+//-----------------------------------------------------------------------------
+void UnionMesher::set_voxel_size( double voxel_size )
+{
+  this->voxel_size_ = std::max( 0.0, voxel_size );
+}
+
+//-----------------------------------------------------------------------------
+void UnionMesher::set_max_voxels( double max_voxels )
+{
+  this->max_voxels_ = std::max( 1000.0, max_voxels );
+}
+
+//-----------------------------------------------------------------------------
+const UnionMeshStats& UnionMesher::get_stats() const
+{
+  return this->stats_;
+}
+
+//-----------------------------------------------------------------------------
+double UnionMesher::get_voxel_size( const SkeletonGraph &graph ) const
+{
+  int num_nodes = graph.get_num_nodes();
+  if ( num_nodes == 0 )
+  {
+    return 1.0;
+  }
+
+  double lower[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+  double upper[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+  std::vector<double> radii( num_nodes );
+  for ( int i = 0; i < num_nodes; i++ )
+  {
+    const double* p = graph.get_position( i );
+    double r = graph.get_radius( i );
+    for ( int k = 0; k < 3; k++ )
+    {
+      lower[k] = std::min( lower[k], p[k] - r );
+      upper[k] = std::max( upper[k], p[k] + r );
+    }
+    radii[i] = r;
+  }
+
+  double voxel_size = this->voxel_size_;
+  if ( voxel_size <= 0 )
+  {
+    // two samples across the radius of a typical process
+    std::nth_element( radii.begin(), radii.begin() + num_nodes / 2, radii.end() );
+    voxel_size = radii[num_nodes / 2] / 2.0;
+  }
+
+  // stay within the sample limit
+  double volume = 1;
+  for ( int k = 0; k < 3; k++ )
+  {
+    volume *= std::max( upper[k] - lower[k], 1e-6 );
+  }
+  voxel_size = std::max( voxel_size, pow( volume / this->max_voxels_, 1.0 / 3.0 ) );
+
+  // lattice coordinates are packed into 20 bits
+  for ( int k = 0; k < 3; k++ )
+  {
+    voxel_size = std::max( voxel_size, ( upper[k] - lower[k] ) / 1000000.0 );
+  }
+
+  return voxel_size;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> UnionMesher::generate( const SkeletonGraph &graph )
+{
+  this->stats_ = UnionMeshStats();
+
+  double start_time = vtkTimerLog::GetUniversalTime();
+
+  double spacing = this->get_voxel_size( graph );
+
+  std::vector<Capsule> capsules;
+  CapsuleBVH::collect_capsules( graph, 0, 0, capsules );
+
+  if ( capsules.empty() )
+  {
+    return vtkSmartPointer<vtkPolyData>::New();
+  }
+
+  // processes thinner than a voxel would break up between the samples
+  for ( size_t i = 0; i < capsules.size(); i++ )
+  {
+    capsules[i].radius_a = std::max( capsules[i].radius_a, spacing );
+    capsules[i].radius_b = std::max( capsules[i].radius_b, spacing );
+  }
+
+  CapsuleBVH bvh;
+  bvh.build( capsules );
+
+  double bounds[6] = { DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX };
+  for ( size_t i = 0; i < capsules.size(); i++ )
+  {
+    double radius = std::max( capsules[i].radius_a, capsules[i].radius_b );
+    for ( int k = 0; k < 3; k++ )
+    {
+      bounds[2 * k] = std::min( bounds[2 * k], std::min( capsules[i].a[k], capsules[i].b[k] ) - radius );
+      bounds[2 * k + 1] = std::max( bounds[2 * k + 1], std::max( capsules[i].a[k], capsules[i].b[k] ) + radius );
+    }
+  }
+
+  this->stats_.voxel_size = spacing;
+  this->stats_.num_capsules = (int)capsules.size();
+  this->stats_.index_time = vtkTimerLog::GetUniversalTime() - start_time;
+  start_time = vtkTimerLog::GetUniversalTime();
+
+  // distances are exact within the band, enough for the interpolation and the gradients
+  SparseDistanceGrid grid;
+  grid.build( bvh, bounds, spacing, 2.0 * spacing );
+
+  for ( int k = 0; k < 3; k++ )
+  {
+    this->stats_.dimensions[k] = grid.get_dimensions()[k];
+  }
+  this->stats_.num_tiles = grid.get_num_tiles();
+  this->stats_.num_leaves = grid.get_num_leaves();
+  this->stats_.grid_memory = grid.get_memory_size();
+  this->stats_.dense_memory = grid.get_dense_memory_size();
+  this->stats_.sample_time = vtkTimerLog::GetUniversalTime() - start_time;
+  start_time = vtkTimerLog::GetUniversalTime();
+
+  // a few hundred leaves per task keeps the seams between tasks small
+  const int leaves_per_task = 256;
+  std::vector<ExtractTask> tasks;
+  for ( int first = 0; first < grid.get_num_leaves(); first += leaves_per_task )
+  {
+    ExtractTask task;
+    task.grid = &grid;
+    task.first_leaf = first;
+    task.last_leaf = std::min( first + leaves_per_task, grid.get_num_leaves() );
+    tasks.push_back( task );
+  }
+
+  if ( this->extraction_ == SURFACE_NETS )
+  {
+    QtConcurrent::blockingMap( tasks, UnionMesher::surface_nets );
+  }
+  else
+  {
+    QtConcurrent::blockingMap( tasks, UnionMesher::marching_cubes );
+  }
+
+  MeshBuffer mesh;
+  UnionMesher::merge_pieces( tasks, mesh );
+
+  // the split loops keep the edges manifold, anything left is split apart here
+  if ( this->extraction_ == SURFACE_NETS )
+  {
+    MeshRepair repair;
+    repair.repair( mesh );
+    this->stats_.non_manifold_edges = repair.get_stats().non_manifold_edges;
+    this->stats_.non_manifold_vertices = repair.get_stats().non_manifold_vertices;
+  }
+
+  vtkSmartPointer<vtkPolyData> poly_data = SkeletonMesher::create_polydata( mesh );
+
+  this->stats_.num_triangles = mesh.get_num_triangles();
+  this->stats_.extract_time = vtkTimerLog::GetUniversalTime() - start_time;
+
+  return poly_data;
+}
+
+//-----------------------------------------------------------------------------
+void UnionMesher::marching_cubes( ExtractTask &task )
+{
+  const SparseDistanceGrid &grid = *task.grid;
+  const int leaf_size = SparseDistanceGrid::LEAF_SIZE;
+  const int size = SparseDistanceGrid::GATHER_SIZE;
+  const int* dimensions = grid.get_dimensions();
+  const double* origin = grid.get_origin();
+  double h = grid.get_spacing();
+
+  std::vector<float> values( size * size * size );
+
+  // vertex of every edge of the leaf's lattice points 0 .. LEAF_SIZE, per axis
+  const int span = leaf_size + 1;
+  std::vector<int> edge_vertices( 3 * span * span * span );
+
+  int offsets[8];
+  for ( int i = 0; i < 8; i++ )
+  {
+    offsets[i] = CORNERS[i][0] + size * ( CORNERS[i][1] + size * CORNERS[i][2] );
+  }
+  const int steps[3] = { 1, size, size * size };
+
+  for ( int leaf = task.first_leaf; leaf < task.last_leaf; leaf++ )
+  {
+    grid.gather_leaf( leaf, &values[0] );
+    const int* leaf_origin = grid.get_leaf_origin( leaf );
+    std::fill( edge_vertices.begin(), edge_vertices.end(), -1 );
+
+    for ( int z = 0; z < leaf_size; z++ )
+    {
+      for ( int y = 0; y < leaf_size; y++ )
+      {
+        for ( int x = 0; x < leaf_size; x++ )
+        {
+          if ( leaf_origin[0] + x + 1 >= dimensions[0] || leaf_origin[1] + y + 1 >= dimensions[1] ||
+               leaf_origin[2] + z + 1 >= dimensions[2] )
+          {
+            continue;
+          }
+
+          // gathered values start one layer before the leaf
+          const float* cell = &values[( x + 1 ) + size * ( ( y + 1 ) + size * ( z + 1 ) )];
+
+          int index = 0;
+          for ( int i = 0; i < 8; i++ )
+          {
+            if ( cell[offsets[i]] < 0 )
+            {
+              index |= 1 << i;
+            }
+          }
+
+          const signed char* loops = CASES.loops[index];
+          while ( *loops != 0 )
+          {
+            int length = std::abs( (int)*loops );
+            bool center = *loops < 0;
+            loops++;
+
+            int loop[12];
+            for ( int i = 0; i < length; i++ )
+            {
+              int edge = loops[i];
+              const int* lower = CORNERS[EDGES[edge][0]];
+              const int* upper = CORNERS[EDGES[edge][1]];
+              int axis = ( upper[0] != lower[0] ) ? 0 : ( ( upper[1] != lower[1] ) ? 1 : 2 );
+              int p[3] = { x + lower[0], y + lower[1], z + lower[2] };
+
+              int& vertex = edge_vertices[3 * ( p[0] + span * ( p[1] + span * p[2] ) ) + axis];
+              if ( vertex == -1 )
+              {
+                const float* a = cell + offsets[EDGES[edge][0]];
+                const float* b = a + steps[axis];
+                double s = *a / ( *a - *b );
+
+                vertex = task.mesh.get_num_points();
+                double gradient[3];
+                for ( int k = 0; k < 3; k++ )
+                {
+                  double position = leaf_origin[k] + p[k] + ( k == axis ? s : 0.0 );
+                  task.mesh.points.push_back( origin[k] + position * h );
+
+                  // central differences at both ends, interpolated
+                  double ga = a[steps[k]] - a[-steps[k]];
+                  double gb = b[steps[k]] - b[-steps[k]];
+                  gradient[k] = ga + s * ( gb - ga );
+                }
+                UnionMesher::add_normal( gradient, task.mesh );
+
+                // shared with a neighbor if it lies in one of the leaf's faces
+                bool seam = false;
+                for ( int k = 0; k < 3; k++ )
+                {
+                  seam = seam || ( k != axis && ( p[k] == 0 || p[k] == leaf_size ) );
+                }
+
+                long long key = -1;
+                if ( seam )
+                {
+                  long long gx = leaf_origin[0] + p[0];
+                  long long gy = leaf_origin[1] + p[1];
+                  long long gz = leaf_origin[2] + p[2];
+                  key = ( ( ( ( gz << 20 ) | gy ) << 20 | gx ) << 2 ) | axis;
+                }
+                task.seam_keys.push_back( key );
+              }
+              loop[i] = vertex;
+            }
+            loops += length;
+
+            if ( !center )
+            {
+              for ( int i = 1; i + 1 < length; i++ )
+              {
+                task.mesh.triangles.push_back( loop[0] );
+                task.mesh.triangles.push_back( loop[i] );
+                task.mesh.triangles.push_back( loop[i + 1] );
+              }
+              continue;
+            }
+
+            // a vertex of its own in the middle of the loop
+            int middle = task.mesh.get_num_points();
+            double position[3] = { 0, 0, 0 };
+            double normal[3] = { 0, 0, 0 };
+            for ( int i = 0; i < length; i++ )
+            {
+              for ( int k = 0; k < 3; k++ )
+              {
+                position[k] += task.mesh.points[3 * loop[i] + k] / length;
+                normal[k] += task.mesh.normals[3 * loop[i] + k];
+              }
+            }
+            for ( int k = 0; k < 3; k++ )
+            {
+              task.mesh.points.push_back( position[k] );
+            }
+            UnionMesher::add_normal( normal, task.mesh );
+            task.seam_keys.push_back( -1 );
+
+            for ( int i = 0; i < length; i++ )
+            {
+              task.mesh.triangles.push_back( middle );
+              task.mesh.triangles.push_back( loop[i] );
+              task.mesh.triangles.push_back( loop[( i + 1 ) % length] );
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void UnionMesher::surface_nets( ExtractTask &task )
+{
+  const SparseDistanceGrid &grid = *task.grid;
+  const int leaf_size = SparseDistanceGrid::LEAF_SIZE;
+  const int size = SparseDistanceGrid::GATHER_SIZE;
+  const int* dimensions = grid.get_dimensions();
+
+  std::vector<float> values( size * size * size );
+
+  // first vertex of every cell with its lower corner at -1 .. LEAF_SIZE - 1
+  const int span = leaf_size + 1;
+  std::vector<int> cell_vertices( span * span * span );
+
+  const int steps[3] = { 1, size, size * size };
+
+  // the four cells around an edge, counter clockwise about it
+  const int around[4][2] = { { -1, -1 }, { 0, -1 }, { 0, 0 }, { -1, 0 } };
+
+  int offsets[8];
+  for ( int i = 0; i < 8; i++ )
+  {
+    offsets[i] = CORNERS[i][0] + size * ( CORNERS[i][1] + size * CORNERS[i][2] );
+  }
+
+  // the cube edge a lattice edge along each axis is, in each of the four cells around it
+  int cell_edges[3][4];
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    for ( int q = 0; q < 4; q++ )
+    {
+      int lower[3];
+      lower[axis] = 0;
+      lower[( axis + 1 ) % 3] = -around[q][0];
+      lower[( axis + 2 ) % 3] = -around[q][1];
+      for ( int e = 0; e < 12; e++ )
+      {
+        const int* a = CORNERS[EDGES[e][0]];
+        const int* b = CORNERS[EDGES[e][1]];
+        if ( a[0] == lower[0] && a[1] == lower[1] && a[2] == lower[2] && b[axis] == 1 )
+        {
+          cell_edges[axis][q] = e;
+        }
+      }
+    }
+  }
+
+  for ( int leaf = task.first_leaf; leaf < task.last_leaf; leaf++ )
+  {
+    grid.gather_leaf( leaf, &values[0] );
+    const int* leaf_origin = grid.get_leaf_origin( leaf );
+    std::fill( cell_vertices.begin(), cell_vertices.end(), -1 );
+
+    // every lattice edge starting at one of the leaf's own samples
+    for ( int z = 0; z < leaf_size; z++ )
+    {
+      for ( int y = 0; y < leaf_size; y++ )
+      {
+        for ( int x = 0; x < leaf_size; x++ )
+        {
+          int p[3] = { x, y, z };
+          const float* point = &values[( x + 1 ) + size * ( ( y + 1 ) + size * ( z + 1 ) )];
+
+          for ( int axis = 0; axis < 3; axis++ )
+          {
+            if ( leaf_origin[axis] + p[axis] + 1 >= dimensions[axis] )
+            {
+              continue;
+            }
+
+            bool inside = point[0] < 0;
+            if ( inside == ( point[steps[axis]] < 0 ) )
+            {
+              continue;
+            }
+
+            int b = ( axis + 1 ) % 3;
+            int c = ( axis + 2 ) % 3;
+
+            int quad[4];
+            int cases[4];
+            int firsts[4];
+            for ( int q = 0; q < 4; q++ )
+            {
+              int cell[3] = { p[0], p[1], p[2] };
+              cell[b] += around[q][0];
+              cell[c] += around[q][1];
+              const float* corner = &values[( cell[0] + 1 ) + size * ( ( cell[1] + 1 ) + size * ( cell[2] + 1 ) )];
+
+              int index = 0;
+              for ( int i = 0; i < 8; i++ )
+              {
+                if ( corner[offsets[i]] < 0 )
+                {
+                  index |= 1 << i;
+                }
+              }
+
+              int& first = cell_vertices[( cell[0] + 1 ) + span * ( ( cell[1] + 1 ) + span * ( cell[2] + 1 ) )];
+              if ( first == -1 )
+              {
+                int global_cell[3];
+                bool seam = false;
+                for ( int k = 0; k < 3; k++ )
+                {
+                  global_cell[k] = leaf_origin[k] + cell[k];
+                  seam = seam || cell[k] == -1 || cell[k] == leaf_size - 1;
+                }
+                first = UnionMesher::add_cell_vertices( corner, index, global_cell, seam, task );
+              }
+
+              quad[q] = first + CASES.edge_vertices[index][cell_edges[axis][q]];
+              cases[q] = index;
+              firsts[q] = first;
+            }
+
+            // where two cells around the edge meet in a face, the isoline segment of the face runs on to
+            // another lattice edge; if either cell split its loop there (see CaseTable), the quads of the
+            // two edges no longer share a side and the gap between them is filled, once, from the edge the
+            // segment starts at in the lower cell
+            for ( int q = 0; q < 4; q++ )
+            {
+              int n = ( q + 1 ) % 4;
+              int k = ( around[q][0] != around[n][0] ) ? 0 : 1;
+              int across = ( k == 0 ) ? b : c;
+              bool lower = around[q][k] < around[n][k];
+              int l = lower ? q : n;
+              int u = lower ? n : q;
+
+              // faces are ordered z, y, x, lower side first
+              int lower_face = 2 * ( 2 - across ) + 1;
+              int upper_face = 2 * ( 2 - across );
+
+              int lower_edge = cell_edges[axis][l];
+              if ( CASES.next_faces[cases[l]][lower_edge] != lower_face )
+              {
+                continue;
+              }
+              int lower_next = CASES.next_edges[cases[l]][lower_edge];
+
+              int upper_edge = cell_edges[axis][u];
+              int upper_next = ( CASES.next_faces[cases[u]][upper_edge] == upper_face ) ?
+                               CASES.next_edges[cases[u]][upper_edge] : CASES.prev_edges[cases[u]][upper_edge];
+
+              int gap[4];
+              gap[0] = quad[u];
+              gap[1] = quad[l];
+              gap[2] = firsts[l] + CASES.edge_vertices[cases[l]][lower_next];
+              gap[3] = firsts[u] + CASES.edge_vertices[cases[u]][upper_next];
+              if ( gap[1] == gap[2] && gap[0] == gap[3] )
+              {
+                continue;
+              }
+
+              // the gap runs from u to l, against the quad, which keeps the order around the edge if inside
+              if ( ( l == q ) != inside )
+              {
+                std::swap( gap[0], gap[3] );
+                std::swap( gap[1], gap[2] );
+              }
+
+              UnionMesher::add_polygon( gap, task.mesh );
+            }
+
+            // the outside is towards the end of the edge that is outside
+            if ( !inside )
+            {
+              std::swap( quad[1], quad[3] );
+            }
+
+            // split along the shorter diagonal
+            double d02 = 0;
+            double d13 = 0;
+            for ( int k = 0; k < 3; k++ )
+            {
+              double a = task.mesh.points[3 * quad[0] + k] - task.mesh.points[3 * quad[2] + k];
+              double e = task.mesh.points[3 * quad[1] + k] - task.mesh.points[3 * quad[3] + k];
+              d02 += a * a;
+              d13 += e * e;
+            }
+
+            const int split02[6] = { 0, 1, 2, 0, 2, 3 };
+            const int split13[6] = { 0, 1, 3, 1, 2, 3 };
+            const int* split = ( d02 <= d13 ) ? split02 : split13;
+            for ( int i = 0; i < 6; i++ )
+            {
+              task.mesh.triangles.push_back( quad[split[i]] );
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void UnionMesher::add_polygon( const int* polygon, MeshBuffer &mesh )
+{
+  int corners[4];
+  int count = 0;
+  for ( int i = 0; i < 4; i++ )
+  {
+    if ( polygon[i] != polygon[( i + 3 ) % 4] )
+    {
+      corners[count++] = polygon[i];
+    }
+  }
+
+  for ( int i = 1; i + 1 < count; i++ )
+  {
+    mesh.triangles.push_back( corners[0] );
+    mesh.triangles.push_back( corners[i] );
+    mesh.triangles.push_back( corners[i + 1] );
+  }
+}
+
+//-----------------------------------------------------------------------------
+int UnionMesher::add_cell_vertices( const float* cell, int index, const int* global_cell, bool seam, ExtractTask &task )
+{
+  const int size = SparseDistanceGrid::GATHER_SIZE;
+  const SparseDistanceGrid &grid = *task.grid;
+
+  // tangent planes are weighed against the average crossing with this, in cells
+  const double regularization = 0.05;
+
+  double corner[8];
+  for ( int i = 0; i < 8; i++ )
+  {
+    corner[i] = cell[CORNERS[i][0] + size * ( CORNERS[i][1] + size * CORNERS[i][2] )];
+  }
+
+  // one vertex per surface sheet (marching cubes loop) in the cell, two for a loop through a face twice
+  int first = task.mesh.get_num_points();
+  for ( int vertex = 0; vertex < CASES.num_vertices[index]; vertex++ )
+  {
+    // normal equations of the tangent planes, relative to the cell corner
+    double ata[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+    double atb[3] = { 0, 0, 0 };
+    double mass[3] = { 0, 0, 0 };
+    int count = 0;
+
+    for ( int e = 0; e < 12; e++ )
+    {
+      if ( CASES.edge_vertices[index][e] != vertex )
+      {
+        continue;
+      }
+
+      double a = corner[EDGES[e][0]];
+      double b = corner[EDGES[e][1]];
+
+      double t = a / ( a - b );
+      double crossing[3];
+      for ( int k = 0; k < 3; k++ )
+      {
+        crossing[k] = CORNERS[EDGES[e][0]][k] + t * ( CORNERS[EDGES[e][1]][k] - CORNERS[EDGES[e][0]][k] );
+      }
+
+      double normal[3];
+      UnionMesher::trilinear_gradient( corner, crossing, normal );
+      double length = sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+      if ( length <= 0 )
+      {
+        continue;
+      }
+
+      double offset = 0;
+      for ( int k = 0; k < 3; k++ )
+      {
+        normal[k] /= length;
+        offset += normal[k] * crossing[k];
+        mass[k] += crossing[k];
+      }
+      for ( int i = 0; i < 3; i++ )
+      {
+        for ( int j = 0; j < 3; j++ )
+        {
+          ata[i][j] += normal[i] * normal[j];
+        }
+        atb[i] += normal[i] * offset;
+      }
+      count++;
+    }
+
+    double position[3] = { 0.5, 0.5, 0.5 };
+    if ( count > 0 )
+    {
+      for ( int k = 0; k < 3; k++ )
+      {
+        mass[k] /= count;
+      }
+
+      // (AtA + r I) d = At (b - A m), the vertex is m + d
+      double m[3][3];
+      double r[3];
+      for ( int i = 0; i < 3; i++ )
+      {
+        r[i] = atb[i];
+        for ( int j = 0; j < 3; j++ )
+        {
+          m[i][j] = ata[i][j] + ( i == j ? regularization : 0.0 );
+          r[i] -= ata[i][j] * mass[j];
+        }
+      }
+
+      double det = m[0][0] * ( m[1][1] * m[2][2] - m[1][2] * m[2][1] )
+                   - m[0][1] * ( m[1][0] * m[2][2] - m[1][2] * m[2][0] )
+                   + m[0][2] * ( m[1][0] * m[2][1] - m[1][1] * m[2][0] );
+
+      for ( int k = 0; k < 3; k++ )
+      {
+        position[k] = mass[k];
+      }
+
+      if ( fabs( det ) > 1e-12 )
+      {
+        // Cramer's rule
+        for ( int k = 0; k < 3; k++ )
+        {
+          double column[3][3];
+          for ( int i = 0; i < 3; i++ )
+          {
+            for ( int j = 0; j < 3; j++ )
+            {
+              column[i][j] = ( j == k ) ? r[i] : m[i][j];
+            }
+          }
+          double det_k = column[0][0] * ( column[1][1] * column[2][2] - column[1][2] * column[2][1] )
+                         - column[0][1] * ( column[1][0] * column[2][2] - column[1][2] * column[2][0] )
+                         + column[0][2] * ( column[1][0] * column[2][1] - column[1][1] * column[2][0] );
+          position[k] = std::min( 1.0, std::max( 0.0, mass[k] + det_k / det ) );
+        }
+      }
+    }
+
+    for ( int k = 0; k < 3; k++ )
+    {
+      task.mesh.points.push_back( grid.get_origin()[k] + ( global_cell[k] + position[k] ) * grid.get_spacing() );
+    }
+
+    double gradient[3];
+    UnionMesher::trilinear_gradient( corner, position, gradient );
+    UnionMesher::add_normal( gradient, task.mesh );
+
+    long long key = -1;
+    if ( seam )
+    {
+      long long gx = global_cell[0];
+      long long gy = global_cell[1];
+      long long gz = global_cell[2];
+      key = ( ( ( ( gz << 20 ) | gy ) << 20 | gx ) << 2 ) | vertex;
+    }
+    task.seam_keys.push_back( key );
+  }
+
+  return first;
+}
+
+//-----------------------------------------------------------------------------
+void UnionMesher::trilinear_gradient( const double* corner, const double* position, double* gradient )
+{
+  for ( int k = 0; k < 3; k++ )
+  {
+    gradient[k] = 0;
+  }
+
+  for ( int i = 0; i < 8; i++ )
+  {
+    double weight[3], slope[3];
+    for ( int k = 0; k < 3; k++ )
+    {
+      weight[k] = CORNERS[i][k] ? position[k] : 1.0 - position[k];
+      slope[k] = CORNERS[i][k] ? 1.0 : -1.0;
+    }
+    gradient[0] += corner[i] * slope[0] * weight[1] * weight[2];
+    gradient[1] += corner[i] * weight[0] * slope[1] * weight[2];
+    gradient[2] += corner[i] * weight[0] * weight[1] * slope[2];
+  }
+}
+
+//-----------------------------------------------------------------------------
+void UnionMesher::add_normal( const double* direction, MeshBuffer &mesh )
+{
+  double length = sqrt( direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2] );
+  for ( int k = 0; k < 3; k++ )
+  {
+    mesh.normals.push_back( length > 0 ? (float)( direction[k] / length ) : 0.0f );
+  }
+}
+
+//-----------------------------------------------------------------------------
+void UnionMesher::merge_pieces( const std::vector<ExtractTask> &tasks, MeshBuffer &mesh )
+{
+  int num_points = 0;
+  int num_triangles = 0;
+  int num_seams = 0;
+  for ( size_t i = 0; i < tasks.size(); i++ )
+  {
+    num_points += tasks[i].mesh.get_num_points();
+    num_triangles += tasks[i].mesh.get_num_triangles();
+    num_seams += (int)tasks[i].seam_keys.size();
+  }
+
+  mesh.clear();
+  mesh.points.reserve( 3 * num_points );
+  mesh.normals.reserve( 3 * num_points );
+  mesh.triangles.reserve( 3 * num_triangles );
+
+  QHash<long long, int> seams;
+  seams.reserve( num_seams );
+
+  std::vector<int> remap;
+  for ( size_t i = 0; i < tasks.size(); i++ )
+  {
+    const MeshBuffer &piece = tasks[i].mesh;
+
+    remap.resize( piece.get_num_points() );
+    for ( int v = 0; v < piece.get_num_points(); v++ )
+    {
+      long long key = tasks[i].seam_keys[v];
+      if ( key != -1 )
+      {
+        QHash<long long, int>::const_iterator it = seams.constFind( key );
+        if ( it != seams.constEnd() )
+        {
+          remap[v] = it.value();
+          continue;
+        }
+        seams.insert( key, mesh.get_num_points() );
+      }
+
+      remap[v] = mesh.get_num_points();
+      mesh.points.insert( mesh.points.end(), piece.points.begin() + 3 * v, piece.points.begin() + 3 * v + 3 );
+      mesh.normals.insert( mesh.normals.end(), piece.normals.begin() + 3 * v, piece.normals.begin() + 3 * v + 3 );
+    }
+
+    for ( size_t t = 0; t < piece.triangles.size(); t++ )
+    {
+      mesh.triangles.push_back( remap[piece.triangles[t]] );
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+double UnionMesher::capsule_distance( const Capsule &capsule, const double* point )
+{
+  // exact distance to a round cone (two spheres and the tangent cone between them)
+  double ba[3], pa[3];
+  for ( int k = 0; k < 3; k++ )
+  {
+    ba[k] = capsule.b[k] - capsule.a[k];
+    pa[k] = point[k] - capsule.a[k];
+  }
+
+  double l2 = ba[0] * ba[0] + ba[1] * ba[1] + ba[2] * ba[2];
+  double rr = capsule.radius_a - capsule.radius_b;
+  double a2 = l2 - rr * rr;
+
+  if ( l2 <= 0 || a2 <= 1e-12 * l2 )
+  {
+    // one sphere contains the other (or a single sphere)
+    double pb[3];
+    for ( int k = 0; k < 3; k++ )
+    {
+      pb[k] = point[k] - capsule.b[k];
+    }
+    double da = sqrt( pa[0] * pa[0] + pa[1] * pa[1] + pa[2] * pa[2] ) - capsule.radius_a;
+    double db = sqrt( pb[0] * pb[0] + pb[1] * pb[1] + pb[2] * pb[2] ) - capsule.radius_b;
+    return std::min( da, db );
+  }
+
+  double il2 = 1.0 / l2;
+  double y = pa[0] * ba[0] + pa[1] * ba[1] + pa[2] * ba[2];
+  double z = y - l2;
+
+  double x2 = 0;
+  for ( int k = 0; k < 3; k++ )
+  {
+    double c = pa[k] * l2 - ba[k] * y;
+    x2 += c * c;
+  }
+  double y2 = y * y * l2;
+  double z2 = z * z * l2;
+
+  // compare the angle to the axis with the cone's half angle to pick the closest part
+  double k = ( rr > 0 ? 1.0 : ( rr < 0 ? -1.0 : 0.0 ) ) * rr * rr * x2;
+  double sign_z = z > 0 ? 1.0 : ( z < 0 ? -1.0 : 0.0 );
+  double sign_y = y > 0 ? 1.0 : ( y < 0 ? -1.0 : 0.0 );
+
+  if ( sign_z * a2 * z2 > k )
+  {
+    return sqrt( x2 + z2 ) * il2 - capsule.radius_b;
+  }
+  if ( sign_y * a2 * y2 < k )
+  {
+    return sqrt( x2 + y2 ) * il2 - capsule.radius_a;
+  }
+  return ( sqrt( x2 * a2 * il2 ) + y * rr ) * il2 - capsule.radius_a;
+}
@@ -0,0 +1,155 @@
+#ifndef VIKING_DATA_UNIONMESHER_H
+#define VIKING_DATA_UNIONMESHER_H
+
+#include <vector>
+
+#include <vtkSmartPointer.h>
+
+#include <Data/SkeletonMesher.h>
+
+class vtkPolyData;
+class SkeletonGraph;
+class Capsule;
+class CapsuleBVH;
+class SparseDistanceGrid;
+
+//! Grid size, memory and stage timing of the last union mesh
+class UnionMeshStats
+{
+public:
+  UnionMeshStats();
+
+  double voxel_size;
+  int dimensions[3];
+
+  int num_capsules;
+
+  /// tiles near the skeleton and leaves with sample storage (see SparseDistanceGrid)
+  int num_tiles;
+  int num_leaves;
+
+  /// bytes of the sparse grid, and of a dense grid over the same lattice for comparison
+  double grid_memory;
+  double dense_memory;
+
+  int num_triangles;
+
+  /// non-manifold edges and vertices the surface nets left, split apart afterwards (see MeshRepair)
+  int non_manifold_edges;
+  int non_manifold_vertices;
+
+  /// seconds spent building the capsule index, sampling the distance field and extracting the surface
+  double index_time;
+  double sample_time;
+  double extract_time;
+};
+
+//! Watertight surface of the union of a skeleton's capsules
+/*!
+ * Every link is a capsule with linearly varying radius (a round cone) and
+ * the union of all capsules is the zero level set of the minimum of their
+ * signed distance functions.  The distance is sampled in a narrow band
+ * around the surface on a SparseDistanceGrid and the surface extracted with
+ * marching cubes, so overlapping tubes and spheres merge into one closed,
+ * non self-intersecting mesh.
+ *
+ * Two extractions work on the same grid, leaf by leaf, in parallel.
+ *
+ * Marching cubes is the default.  Each case
+ * is triangulated by walking the isolines on the cube faces, where the
+ * ambiguous faces always keep the inside corners apart; the choice depends
+ * only on the face itself, so neighboring cubes agree and the surface has no
+ * cracks.  Vertices are keyed by the lattice edge they lie on, and the ones on
+ * leaf faces are merged across leaves through a hash of that key.
+ *
+ * Surface nets put a vertex in every cell the surface passes through and a
+ * quad across every cut lattice edge.  The triangle count is about that of
+ * marching cubes, but the triangles are well shaped, without the slivers
+ * marching cubes makes where the surface passes near a lattice point.  A
+ * cell gets one vertex per marching cubes loop (as in manifold dual
+ * contouring), so two sheets passing through one cell are not pinched
+ * together, and each quad uses the vertex of the loop its edge belongs to.
+ * The vertex is placed as in dual contouring: it minimizes the squared
+ * distances to the tangent planes at the loop's edge crossings (the quadratic
+ * error function), pulled slightly towards their average so flat and thin
+ * cells stay well posed, and kept inside its cell.  Cells are keyed by their
+ * lattice position and vertex for the seam merge.  A loop that passes
+ * through a face twice (a tunnel of the outside through an ambiguous face)
+ * would join the four quads of that face along one edge, so it gets two
+ * vertices, one per pass, and the gaps this opens between neighboring quads
+ * are filled with triangles.  MeshRepair still runs afterwards as a check.
+ */
+class UnionMesher
+{
+
+public:
+  UnionMesher();
+
+  enum Extraction
+  {
+    MARCHING_CUBES,
+    SURFACE_NETS
+  };
+
+  void set_extraction( Extraction extraction );
+
+  /// grid spacing, 0 picks one from the skeleton (see get_voxel_size)
+  void set_voxel_size( double voxel_size );
+
+  /// upper bound on the lattice size (as if it were dense), the voxel size grows to stay below it
+  void set_max_voxels( double max_voxels );
+
+  /// spacing that would be used for this skeleton
+  double get_voxel_size( const SkeletonGraph &graph ) const;
+
+  vtkSmartPointer<vtkPolyData> generate( const SkeletonGraph &graph );
+
+  const UnionMeshStats& get_stats() const;
+
+  /// signed distance from a point to a capsule (negative inside)
+  static double capsule_distance( const Capsule &capsule, const double* point );
+
+private:
+
+  //! a range of leaves and the triangles found in them
+  class ExtractTask
+  {
+  public:
+    const SparseDistanceGrid* grid;
+    int first_leaf;
+    int last_leaf;
+
+    MeshBuffer mesh;
+
+    /// lattice edge (marching cubes) or cell (surface nets) of every vertex a neighbor leaf also makes, else -1
+    std::vector<long long> seam_keys;
+  };
+
+  static void marching_cubes( ExtractTask &task );
+
+  static void surface_nets( ExtractTask &task );
+
+  /// dual contouring vertices of marching cubes case 'index' (see CaseTable), of the cell whose lower
+  /// corner value is at 'cell', returns the index of the first
+  static int add_cell_vertices( const float* cell, int index, const int* global_cell, bool seam, ExtractTask &task );
+
+  /// gradient of the trilinear interpolation of the cell corners at a position within the cell
+  static void trilinear_gradient( const double* corner, const double* position, double* gradient );
+
+  /// triangles of a polygon of four vertices, leaving out repeated ones
+  static void add_polygon( const int* polygon, MeshBuffer &mesh );
+
+  /// append a unit normal (zero if the direction is)
+  static void add_normal( const double* direction, MeshBuffer &mesh );
+
+  /// join the pieces, merging the vertices on leaf faces
+  static void merge_pieces( const std::vector<ExtractTask> &tasks, MeshBuffer &mesh );
+
+  double voxel_size_;
+  double max_voxels_;
+  Extraction extraction_;
+
+  UnionMeshStats stats_;
+};
+
+#endif /* VIKING_DATA_UNIONMESHER_H */
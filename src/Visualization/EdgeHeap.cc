@@ -0,0 +1,152 @@
+#include <algorithm>
+
+#include <Visualization/EdgeHeap.h>
+
+//-----------------------------------------------------------------------------
+EdgeHeap::EdgeHeap()
+{}
+
+//-----------------------------------------------------------------------------
+void EdgeHeap::initialize( vtkIdType capacity )
+{
+  this->heap_.clear();
+  this->heap_.reserve( capacity );
+  this->positions_.assign( capacity, -1 );
+}
+
+//-----------------------------------------------------------------------------
+bool EdgeHeap::contains( vtkIdType id ) const
+{
+  return id >= 0 && id < (vtkIdType)this->positions_.size() && this->positions_[id] >= 0;
+}
+
+//-----------------------------------------------------------------------------
+void EdgeHeap::insert( vtkIdType id, double cost )
+{
+  if ( id >= (vtkIdType)this->positions_.size() )
+  {
+    this->positions_.resize( std::max( id + 1, 2 * (vtkIdType)this->positions_.size() ), -1 );
+  }
+
+  vtkIdType position = this->positions_[id];
+  if ( position >= 0 )
+  {
+    double old_cost = this->heap_[position].cost;
+    this->heap_[position].cost = cost;
+    if ( cost < old_cost )
+    {
+      this->move_up( position );
+    }
+    else
+    {
+      this->move_down( position );
+    }
+    return;
+  }
+
+  Entry entry;
+  entry.cost = cost;
+  entry.id = id;
+  this->heap_.push_back( entry );
+  this->positions_[id] = this->heap_.size() - 1;
+  this->move_up( this->heap_.size() - 1 );
+}
+
+//-----------------------------------------------------------------------------
+void EdgeHeap::remove( vtkIdType id )
+{
+  if ( !this->contains( id ) )
+  {
+    return;
+  }
+
+  vtkIdType position = this->positions_[id];
+  vtkIdType last = this->heap_.size() - 1;
+  this->positions_[id] = -1;
+
+  if ( position != last )
+  {
+    double old_cost = this->heap_[position].cost;
+    this->heap_[position] = this->heap_[last];
+    this->positions_[this->heap_[position].id] = position;
+    this->heap_.pop_back();
+
+    if ( this->heap_[position].cost < old_cost )
+    {
+      this->move_up( position );
+    }
+    else
+    {
+      this->move_down( position );
+    }
+  }
+  else
+  {
+    this->heap_.pop_back();
+  }
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType EdgeHeap::pop( double &cost )
+{
+  if ( this->heap_.empty() )
+  {
+    return -1;
+  }
+
+  vtkIdType id = this->heap_[0].id;
+  cost = this->heap_[0].cost;
+  this->remove( id );
+  return id;
+}
+
+//-----------------------------------------------------------------------------
+void EdgeHeap::move_up( vtkIdType position )
+{
+  Entry entry = this->heap_[position];
+
+  while ( position > 0 )
+  {
+    vtkIdType parent = ( position - 1 ) / 2;
+    if ( !( entry.cost < this->heap_[parent].cost ) )
+    {
+      break;
+    }
+    this->heap_[position] = this->heap_[parent];
+    this->positions_[this->heap_[position].id] = position;
+    position = parent;
+  }
+
+  this->heap_[position] = entry;
+  this->positions_[entry.id] = position;
+}
+
+//-----------------------------------------------------------------------------
+void EdgeHeap::move_down( vtkIdType position )
+{
+  Entry entry = this->heap_[position];
+  vtkIdType size = this->heap_.size();
+
+  while ( true )
+  {
+    vtkIdType child = 2 * position + 1;
+    if ( child >= size )
+    {
+      break;
+    }
+    if ( child + 1 < size && this->heap_[child + 1].cost < this->heap_[child].cost )
+    {
+      child++;
+    }
+    if ( !( this->heap_[child].cost < entry.cost ) )
+    {
+      break;
+    }
+    this->heap_[position] = this->heap_[child];
+    this->positions_[this->heap_[position].id] = position;
+    position = child;
+  }
+
+  this->heap_[position] = entry;
+  this->positions_[entry.id] = position;
+}
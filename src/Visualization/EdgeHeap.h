@@ -0,0 +1,54 @@
+#ifndef VIKING_VISUALIZATION_EDGEHEAP_H
+#define VIKING_VISUALIZATION_EDGEHEAP_H
+
+#include <vector>
+
+#include <vtkType.h>
+
+//! Indexed binary min-heap of edge collapse costs
+/*!
+ * Every edge id is in the heap at most once, and its position is tracked so
+ * the cost of an edge can be changed (in either direction) or the edge
+ * removed in O(log n) without searching. Edges that are taken out (e.g. a
+ * rejected collapse) simply stay out until their cost is set again.
+ */
+class EdgeHeap
+{
+
+public:
+  EdgeHeap();
+
+  /// empty the heap and reserve room for the given number of edge ids
+  void initialize( vtkIdType capacity );
+
+  /// add an edge, or change its cost if it is already in the heap
+  void insert( vtkIdType id, double cost );
+
+  /// take an edge out of the heap, nothing happens if it is not in it
+  void remove( vtkIdType id );
+
+  /// remove the edge with the lowest cost, -1 if the heap is empty
+  vtkIdType pop( double &cost );
+
+  bool contains( vtkIdType id ) const;
+
+  vtkIdType size() const { return (vtkIdType)this->heap_.size(); }
+
+private:
+
+  struct Entry
+  {
+    double cost;
+    vtkIdType id;
+  };
+
+  void move_up( vtkIdType position );
+  void move_down( vtkIdType position );
+
+  std::vector<Entry> heap_;
+
+  /// heap position of every edge id, -1 if it is not in the heap
+  std::vector<vtkIdType> positions_;
+};
+
+#endif /* VIKING_VISUALIZATION_EDGEHEAP_H */
@@ -0,0 +1,128 @@
+#include <algorithm>
+
+#include <QRunnable>
+#include <QMetaObject>
+
+#include <Data/Structure.h>
+
+#include <Visualization/MeshQueue.h>
+
+//! Builds one structure's mesh on a worker thread
+class MeshJob : public QRunnable
+{
+public:
+  MeshJob( MeshQueue* queue, QSharedPointer<Structure> structure, int generation, int index )
+    : queue_( queue ), structure_( structure ), generation_( generation ), index_( index )
+  {}
+
+  void run()
+  {
+    // the meshes are cached on the structure, the viewer converts them to VTK when it adds them
+    this->structure_->get_mesh_lines();
+    this->structure_->build_meshes();
+
+    QMetaObject::invokeMethod( this->queue_, "job_finished", Qt::QueuedConnection,
+                               Q_ARG( int, this->generation_ ), Q_ARG( int, this->index_ ) );
+  }
+
+private:
+  MeshQueue* queue_;
+  QSharedPointer<Structure> structure_;
+  int generation_;
+  int index_;
+};
+
+//-----------------------------------------------------------------------------
+MeshQueue::MeshQueue( QObject* parent )
+  : QObject( parent )
+{
+  this->next_ = 0;
+  this->in_flight_ = 0;
+  this->remaining_ = 0;
+  this->max_in_flight_ = 64;
+  this->generation_ = 0;
+}
+
+//-----------------------------------------------------------------------------
+MeshQueue::~MeshQueue()
+{
+  this->cancel();
+  this->pool_.waitForDone();
+}
+
+//-----------------------------------------------------------------------------
+void MeshQueue::set_max_threads( int threads )
+{
+  this->pool_.setMaxThreadCount( std::max( 1, threads ) );
+}
+
+//-----------------------------------------------------------------------------
+void MeshQueue::set_max_in_flight( int count )
+{
+  this->max_in_flight_ = std::max( 1, count );
+}
+
+//-----------------------------------------------------------------------------
+void MeshQueue::start( QList< QSharedPointer<Structure> > structures )
+{
+  this->cancel();
+
+  this->structures_ = structures;
+  this->next_ = 0;
+  this->remaining_ = structures.size();
+
+  if ( this->remaining_ == 0 )
+  {
+    emit finished();
+    return;
+  }
+
+  this->submit_jobs();
+}
+
+//-----------------------------------------------------------------------------
+void MeshQueue::cancel()
+{
+  this->generation_++;
+  this->structures_.clear();
+  this->next_ = 0;
+  this->remaining_ = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool MeshQueue::is_running() const
+{
+  return this->remaining_ > 0;
+}
+
+//-----------------------------------------------------------------------------
+void MeshQueue::submit_jobs()
+{
+  while ( this->in_flight_ < this->max_in_flight_ && this->next_ < this->structures_.size() )
+  {
+    MeshJob* job = new MeshJob( this, this->structures_[this->next_], this->generation_, this->next_ );
+    job->setAutoDelete( true );
+    this->pool_.start( job );
+    this->next_++;
+    this->in_flight_++;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void MeshQueue::job_finished( int generation, int index )
+{
+  this->in_flight_--;
+
+  if ( generation == this->generation_ )
+  {
+    this->remaining_--;
+    emit mesh_ready( this->structures_[index] );
+  }
+
+  this->submit_jobs();
+
+  if ( generation == this->generation_ && this->remaining_ == 0 )
+  {
+    emit finished();
+  }
+}
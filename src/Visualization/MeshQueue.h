@@ -0,0 +1,70 @@
+#ifndef VIKING_VISUALIZATION_MESHQUEUE_H
+#define VIKING_VISUALIZATION_MESHQUEUE_H
+
+#include <QObject>
+#include <QList>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+class Structure;
+
+//! Generates structure meshes on a pool of worker threads
+/*!
+ * Structures are handed out to the pool a few at a time so that no more
+ * than 'max in flight' meshes are being built at once, no matter how many
+ * structures are queued.  Each finished mesh is announced on the GUI thread
+ * with mesh_ready().  Starting a new batch drops whatever has not been
+ * started from the previous one.
+ */
+class MeshQueue : public QObject
+{
+  Q_OBJECT
+
+public:
+  MeshQueue( QObject* parent = 0 );
+  ~MeshQueue();
+
+  /// number of worker threads
+  void set_max_threads( int threads );
+
+  /// maximum number of meshes being generated at the same time
+  void set_max_in_flight( int count );
+
+  /// mesh all structures (replaces any batch that is still pending)
+  void start( QList< QSharedPointer<Structure> > structures );
+
+  /// drop the structures that have not been started yet
+  void cancel();
+
+  bool is_running() const;
+
+Q_SIGNALS:
+  void mesh_ready( QSharedPointer<Structure> structure );
+  void finished();
+
+private Q_SLOTS:
+  void job_finished( int generation, int index );
+
+private:
+  void submit_jobs();
+
+  QThreadPool pool_;
+
+  QList< QSharedPointer<Structure> > structures_;
+
+  /// next structure to hand out
+  int next_;
+
+  /// jobs running or queued in the pool, including ones left over from a cancelled batch
+  int in_flight_;
+
+  /// jobs of the current batch that have not reported back yet
+  int remaining_;
+
+  int max_in_flight_;
+
+  /// incremented for every batch so late results of an old batch are ignored
+  int generation_;
+};
+
+#endif /* VIKING_VISUALIZATION_MESHQUEUE_H */
@@ -4,8 +4,6 @@
 #include <vtkGlyph3D.h>
 #include <vtkProperty.h>
 #include <vtkLookupTable.h>
-#include <vtkTransformPolyDataFilter.h>
-#include <vtkTransform.h>
 #include <vtkRenderer.h>
 #include <vtkImageActor.h>
 #include <vtkImageData.h>
@@ -29,13 +27,18 @@
 #include <vtkOrientationMarkerWidget.h>
 #include <vtkRenderWindowInteractor.h>
 #include <vtkCamera.h>
+#include <vtkLODProp3D.h>
 
 #include <QKeyEvent>
 
+#include <algorithm>
+#include <iostream>
+
 #include <Data/Structure.h>
 #include <Application/Preferences.h>
 
 #include <Visualization/Viewer.h>
+#include <Visualization/MeshQueue.h>
 
 // Callback for the interaction
 // This does the actual work: updates the vtkPlane implicit function.
@@ -154,6 +157,24 @@ Viewer::Viewer()
 
   this->orientation_controller_ = vtkSmartPointer<OrientationController>::New();
   this->orientation_controller_->viewer_ = this;
+
+  this->reset_camera_pending_ = false;
+  this->opacity_ = 1.0;
+  this->clipping_ = false;
+  this->mesh_tolerance_ = Preferences::Instance().get_mesh_tolerance();
+  this->triangle_budget_ = Preferences::Instance().get_triangle_budget();
+  this->union_surface_ = Preferences::Instance().get_union_surface();
+  this->union_voxel_size_ = Preferences::Instance().get_union_voxel_size();
+  this->union_extraction_ = Preferences::Instance().get_union_extraction();
+
+  this->mesh_queue_ = new MeshQueue( this );
+  QObject::connect( this->mesh_queue_, SIGNAL( mesh_ready( QSharedPointer<Structure> ) ),
+                    this, SLOT( add_structure( QSharedPointer<Structure> ) ) );
+  QObject::connect( this->mesh_queue_, SIGNAL( finished() ), this, SLOT( meshes_finished() ) );
+
+  this->render_timer_.setSingleShot( true );
+  this->render_timer_.setInterval( 250 );
+  QObject::connect( &this->render_timer_, SIGNAL( timeout() ), this, SLOT( render_timeout() ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -212,60 +233,240 @@ void Viewer::display_cells( QList< QSharedPointer<Cell> > cells, bool reset_came
     return;
   }
 
-  this->surface_actors_.clear();
+  this->mesh_queue_->cancel();
+
+  this->surface_props_.clear();
+  this->surface_properties_.clear();
   this->surface_mappers_.clear();
+  this->structure_props_.clear();
+  this->structure_mappers_.clear();
   this->renderer_->RemoveAllViewProps();
 
-  foreach( QSharedPointer<Cell> cell, cells ) {
+  this->mesh_tolerance_ = Preferences::Instance().get_mesh_tolerance();
+  this->union_surface_ = Preferences::Instance().get_union_surface();
+  this->union_voxel_size_ = Preferences::Instance().get_union_voxel_size();
+  this->union_extraction_ = Preferences::Instance().get_union_extraction();
 
+  QList< QSharedPointer<Structure> > structures;
+  foreach( QSharedPointer<Cell> cell, cells ) {
     foreach( QSharedPointer<Structure> s, cell->structures->values() ) {
-      vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
-      vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+      s->set_mesh_tolerance( this->mesh_tolerance_ );
+      s->set_union_surface( this->union_surface_ );
+      s->set_union_voxel_size( this->union_voxel_size_ );
+      s->set_union_extraction( this->union_extraction_ );
+      structures.append( s );
+    }
+  }
 
-      vtkSmartPointer<vtkPolyData> mesh = s->get_mesh_tubes();
+  this->triangle_budget_ = Preferences::Instance().get_triangle_budget();
+  Structure::split_triangle_budget( structures, this->triangle_budget_ );
+  this->structures_ = structures;
 
-      if ( mesh )
-      {
+  this->reset_camera_pending_ = reset_camera;
 
-        mesh = this->scale_mesh( s );
+  this->mesh_queue_->set_max_threads( Preferences::Instance().get_mesh_threads() );
+  this->mesh_queue_->set_max_in_flight( Preferences::Instance().get_meshes_in_flight() );
+  this->mesh_queue_->start( structures );
+}
 
-        mapper->SetInputData( mesh );
-        actor->SetMapper( mapper );
+//-----------------------------------------------------------------------------
+void Viewer::add_structure( QSharedPointer<Structure> s )
+{
+  vtkSmartPointer<vtkPolyData> mesh = s->get_mesh();
 
-        QColor color = this->get_color( s );
+  if ( !mesh )
+  {
+    return;
+  }
 
-        actor->GetProperty()->SetDiffuseColor( color.red() / 255.0, color.green() / 255.0, color.blue() / 255.0 );
-        actor->GetProperty()->SetSpecular( 0.2 );
-        actor->GetProperty()->SetSpecularPower( 15 );
-        actor->GetProperty()->BackfaceCullingOn();
+  QColor color = this->get_color( s );
 
-        //actor->GetProperty()->SetRepresentationToWireframe();
+  vtkSmartPointer<vtkProperty> property = vtkSmartPointer<vtkProperty>::New();
+  property->SetDiffuseColor( color.red() / 255.0, color.green() / 255.0, color.blue() / 255.0 );
+  property->SetSpecular( 0.2 );
+  property->SetSpecularPower( 15 );
+  property->BackfaceCullingOn();
+  property->SetOpacity( this->opacity_ );
 
-        mapper->ScalarVisibilityOff();
-        //mapper->ScalarVisibilityOn();
+  //property->SetRepresentationToWireframe();
 
-        this->renderer_->AddActor( actor );
+  // lines, coarse tubes and full tubes (or the union surface); vtkLODProp3D picks the best one that fits the
+  // frame time, so interaction uses the cheap levels and still renders get full detail
+  QList<vtkSmartPointer<vtkPolyData> > levels;
+  levels << s->get_mesh_lines() << s->get_mesh_coarse_tubes() << mesh;
 
-        this->surface_actors_.append( actor );
-        this->surface_mappers_.append( mapper );
-      }
+  vtkSmartPointer<vtkLODProp3D> prop = vtkSmartPointer<vtkLODProp3D>::New();
+  QList<vtkSmartPointer<vtkPolyDataMapper> > mappers;
+
+  for ( int i = 0; i < levels.size(); i++ )
+  {
+    if ( !levels[i] || levels[i]->GetNumberOfPoints() == 0 )
+    {
+      continue;
+    }
+
+    vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper->SetInputData( levels[i] );
+    mapper->ScalarVisibilityOff();
+    //mapper->ScalarVisibilityOn();
+
+    if ( this->clipping_ && this->plane )
+    {
+      mapper->AddClippingPlane( this->plane );
     }
+
+    // initial render time estimate, refined by vtkLODProp3D as it renders
+    prop->AddLOD( mapper, property, 1e-8 * ( levels[i]->GetNumberOfPoints() + levels[i]->GetNumberOfCells() ) );
+
+    this->surface_mappers_.append( mapper );
+    mappers.append( mapper );
+  }
+
+  this->scale_prop( s, prop );
+
+  this->renderer_->AddViewProp( prop );
+
+  this->surface_props_.append( prop );
+  this->surface_properties_.append( property );
+  this->structure_props_[s->get_id()] = prop;
+  this->structure_mappers_[s->get_id()] = mappers;
+
+  if ( !this->render_timer_.isActive() )
+  {
+    this->render_timer_.start();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Viewer::update_structure( QSharedPointer<Structure> s )
+{
+  if ( !this->renderer_ )
+  {
+    return;
   }
 
-  if ( reset_camera )
+  // the lower levels of detail were dropped by the edit, so the prop is rebuilt around the patched mesh
+  vtkSmartPointer<vtkLODProp3D> prop = this->structure_props_.take( s->get_id() );
+  if ( prop )
+  {
+    int index = this->surface_props_.indexOf( prop );
+    this->surface_props_.removeAt( index );
+    this->surface_properties_.removeAt( index );
+    this->renderer_->RemoveViewProp( prop );
+  }
+
+  foreach( vtkSmartPointer<vtkPolyDataMapper> mapper, this->structure_mappers_.take( s->get_id() ) ) {
+    this->surface_mappers_.removeAll( mapper );
+  }
+
+  this->add_structure( s );
+  this->redraw();
+}
+
+//-----------------------------------------------------------------------------
+void Viewer::render_timeout()
+{
+  if ( this->reset_camera_pending_ )
   {
     this->renderer_->ResetCamera();
   }
+  this->redraw();
+}
 
-  this->renderer_->Render();
-  this->renderer_->GetRenderWindow()->Render();
+//-----------------------------------------------------------------------------
+void Viewer::meshes_finished()
+{
+  this->render_timer_.stop();
+
+  if ( this->triangle_budget_ > 0 )
+  {
+    int input_triangles = 0;
+    int output_triangles = 0;
+    int topology_rejections = 0;
+    double max_error = 0;
+    foreach( QSharedPointer<Structure> s, this->structures_ ) {
+      const DecimationStats &stats = s->get_decimation_stats();
+      input_triangles += stats.input_triangles;
+      output_triangles += stats.output_triangles;
+      topology_rejections += stats.topology_rejections;
+      max_error = std::max( max_error, stats.max_error );
+    }
+    std::cerr << "decimated " << input_triangles << " to " << output_triangles
+              << " triangles (budget " << this->triangle_budget_ << "), max error " << max_error
+              << ", " << topology_rejections << " collapses refused by the link condition\n";
+  }
+
+  // what the meshes take now, compact arrays and the VTK copies the mappers hold, against caching every mesh
+  // as a vtkPolyData, with the structure that saves the most
+  double megabyte = 1024.0 * 1024.0;
+  size_t compact_bytes = 0;
+  size_t live_bytes = 0;
+  size_t old_bytes = 0;
+  double largest_saving = 0;
+  int largest_id = -1;
+  foreach( QSharedPointer<Structure> s, this->structures_ ) {
+    MeshMemoryStats memory = s->get_mesh_memory();
+    compact_bytes += memory.compact_bytes;
+    live_bytes += memory.live_vtk_bytes;
+    old_bytes += memory.old_vtk_bytes;
+    double saving = (double)memory.old_vtk_bytes - (double)( memory.compact_bytes + memory.live_vtk_bytes );
+    if ( saving > largest_saving )
+    {
+      largest_saving = saving;
+      largest_id = s->get_id();
+    }
+  }
+  std::cerr << "meshes: " << ( compact_bytes + live_bytes ) / megabyte << " MB (" << compact_bytes / megabyte
+            << " MB compact, " << live_bytes / megabyte << " MB of VTK copies for rendering), "
+            << old_bytes / megabyte << " MB if cached as vtkPolyData";
+  if ( largest_id >= 0 )
+  {
+    std::cerr << ", structure " << largest_id << " saves the most (" << largest_saving / megabyte << " MB)";
+  }
+  std::cerr << "\n";
+
+  if ( this->union_surface_ )
+  {
+    double index_time = 0;
+    double sample_time = 0;
+    double extract_time = 0;
+    double grid_memory = 0;
+    double dense_memory = 0;
+    int triangles = 0;
+    int non_manifold_edges = 0;
+    int non_manifold_vertices = 0;
+    foreach( QSharedPointer<Structure> s, this->structures_ ) {
+      const UnionMeshStats &stats = s->get_union_stats();
+      index_time += stats.index_time;
+      sample_time += stats.sample_time;
+      extract_time += stats.extract_time;
+      grid_memory = std::max( grid_memory, stats.grid_memory );
+      dense_memory = std::max( dense_memory, stats.dense_memory );
+      triangles += stats.num_triangles;
+      non_manifold_edges += stats.non_manifold_edges;
+      non_manifold_vertices += stats.non_manifold_vertices;
+    }
+    std::cerr << "union surfaces: " << triangles << " triangles, index " << index_time
+              << "s, sampling " << sample_time << "s, extraction " << extract_time << "s, largest grid "
+              << grid_memory / ( 1024 * 1024 ) << " MB (dense " << dense_memory / ( 1024 * 1024 ) << " MB), split "
+              << non_manifold_edges << " non-manifold edges and " << non_manifold_vertices << " vertices\n";
+  }
+
+  if ( this->reset_camera_pending_ )
+  {
+    this->renderer_->ResetCamera();
+    this->reset_camera_pending_ = false;
+  }
+
+  this->redraw();
 }
 
 //-----------------------------------------------------------------------------
 void Viewer::set_opacity( float opacity )
 {
-  foreach( vtkSmartPointer<vtkActor> actor, this->surface_actors_ ) {
-    actor->GetProperty()->SetOpacity( opacity );
+  this->opacity_ = opacity;
+  foreach( vtkSmartPointer<vtkProperty> property, this->surface_properties_ ) {
+    property->SetOpacity( opacity );
   }
   this->renderer_->GetRenderWindow()->Render();
 }
@@ -280,6 +481,8 @@ void Viewer::redraw()
 //-----------------------------------------------------------------------------
 void Viewer::set_clipping_plane( bool clip )
 {
+  this->clipping_ = clip;
+
   if ( !clip )
   {
 
@@ -332,6 +535,36 @@ void Viewer::set_clipping_plane( bool clip )
   this->redraw();
 }
 
+//-----------------------------------------------------------------------------
+double Viewer::get_mesh_tolerance()
+{
+  return this->mesh_tolerance_;
+}
+
+//-----------------------------------------------------------------------------
+int Viewer::get_triangle_budget()
+{
+  return this->triangle_budget_;
+}
+
+//-----------------------------------------------------------------------------
+bool Viewer::get_union_surface()
+{
+  return this->union_surface_;
+}
+
+//-----------------------------------------------------------------------------
+double Viewer::get_union_voxel_size()
+{
+  return this->union_voxel_size_;
+}
+
+//-----------------------------------------------------------------------------
+int Viewer::get_union_extraction()
+{
+  return this->union_extraction_;
+}
+
 //-----------------------------------------------------------------------------
 QColor Viewer::get_color( QSharedPointer<Structure> s )
 {
@@ -359,35 +592,23 @@ QColor Viewer::get_color( QSharedPointer<Structure> s )
 }
 
 //-----------------------------------------------------------------------------
-vtkSmartPointer<vtkPolyData> Viewer::scale_mesh( QSharedPointer<Structure> s )
+void Viewer::scale_prop( QSharedPointer<Structure> s, vtkProp3D* prop )
 {
-  vtkSmartPointer<vtkPolyData> mesh = s->get_mesh_tubes();
-
   if ( s->get_type() == 1 )
   {
-    return mesh;
+    return;
   }
 
-// else it's a child structure, scale it
+// else it's a child structure, scale it about its center
   double scale = Preferences::Instance().get_child_scale();
   if ( scale == 1.0 )
   {
-    return mesh;
+    return;
   }
 
   double center[3];
-  mesh->GetCenter( center );
-
-  vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
-  transform->Translate( center[0], center[1], center[2] );
-  transform->Scale( scale, scale, scale );
-  transform->Translate( -center[0], -center[1], -center[2] );
-
-  vtkSmartPointer<vtkTransformPolyDataFilter> transform_filter =
-    vtkSmartPointer<vtkTransformPolyDataFilter>::New();
-  transform_filter->SetInputData( mesh );
-  transform_filter->SetTransform( transform );
-  transform_filter->Update();
-  mesh = transform_filter->GetOutput();
-  return mesh;
+  s->get_mesh()->GetCenter( center );
+
+  prop->SetOrigin( center );
+  prop->SetScale( scale, scale, scale );
 }
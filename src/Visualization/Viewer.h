@@ -1,10 +1,15 @@
 #ifndef STUDIO_VISUALIZATION_VIEWER_H
 #define STUDIO_VISUALIZATION_VIEWER_H
 
+#include <QObject>
 #include <QSharedPointer>
+#include <QTimer>
 #include <vtkSmartPointer.h>
 
+#include <Data/Structure.h>
+
 class vtkRenderer;
+class vtkRenderWindow;
 class vtkLookupTable;
 class vtkRenderWindowInteractor;
 class vtkImageData;
@@ -15,12 +20,16 @@ class vtkImageActor;
 class vtkPlane;
 class vtkPolyDataMapper;
 class vtkActor;
+class vtkProp3D;
+class vtkLODProp3D;
+class vtkProperty;
 class vtkImplicitPlaneWidget2;
 class vtkImplicitPlaneRepresentation;
 class vtkIPWCallback;
 class vtkOrientationMarkerWidget;
 
 class OrientationController;
+class MeshQueue;
 
 class Viewer;
 class Structure;
@@ -33,8 +42,9 @@ typedef QVector< ViewerHandle > ViewerList;
  * The Viewer class encapsulates all the functionality for visualizing a single DisplayObject
  *
  */
-class Viewer
+class Viewer : public QObject
 {
+  Q_OBJECT
 
 public:
 
@@ -47,10 +57,15 @@ public:
   vtkSmartPointer<vtkRenderer> get_renderer();
 
 
+  /// meshes are generated in the background and appear as they finish
   void display_cells( QList< QSharedPointer<Cell> > cells, bool reset_camera );
 
   void clear_viewer();
 
+  /// redisplay a structure after an edit (see Structure::move_node), its tube mesh is patched rather than remeshed;
+  /// not called yet, there is no editor
+  void update_structure( QSharedPointer<Structure> s );
+
   void reset_camera();
 
   void redraw();
@@ -59,6 +74,21 @@ public:
 
   void set_clipping_plane( bool clip );
 
+  /// tolerance the displayed meshes were generated with
+  double get_mesh_tolerance();
+  int get_triangle_budget();
+  bool get_union_surface();
+  double get_union_voxel_size();
+  int get_union_extraction();
+
+private Q_SLOTS:
+
+  void add_structure( QSharedPointer<Structure> s );
+
+  void meshes_finished();
+
+  void render_timeout();
+
 private:
 
   bool visible_;
@@ -70,11 +100,15 @@ private:
 
   QColor get_color(QSharedPointer<Structure> s);
 
-  vtkSmartPointer<vtkPolyData> scale_mesh(QSharedPointer<Structure> s);
+  /// child structures are drawn scaled about their center (see Preferences)
+  void scale_prop( QSharedPointer<Structure> s, vtkProp3D* prop );
 
   vtkSmartPointer<vtkRenderer>               renderer_;
   QList<vtkSmartPointer<vtkPolyDataMapper> > surface_mappers_;
-  QList<vtkSmartPointer<vtkActor> >          surface_actors_;
+  QList<vtkSmartPointer<vtkLODProp3D> >      surface_props_;
+  QList<vtkSmartPointer<vtkProperty> >       surface_properties_;
+  QHash<int, vtkSmartPointer<vtkLODProp3D> > structure_props_;
+  QHash<int, QList<vtkSmartPointer<vtkPolyDataMapper> > > structure_mappers_;
   vtkSmartPointer<vtkLookupTable>            lut_;
 
   vtkSmartPointer<vtkImplicitPlaneWidget2>        plane_widget_;
@@ -89,6 +123,22 @@ private:
   QHash<int, QColor> type_colors_;
   QHash<int, QColor> cell_colors_;
 
+  MeshQueue* mesh_queue_;
+
+  /// redraws are batched while meshes arrive
+  QTimer render_timer_;
+
+  bool reset_camera_pending_;
+
+  float opacity_;
+  bool clipping_;
+  double mesh_tolerance_;
+  int triangle_budget_;
+  bool union_surface_;
+  double union_voxel_size_;
+  int union_extraction_;
+  QList< QSharedPointer<Structure> > structures_;
+
 };
 
 #endif /* STUDIO_VISUALIZATION_VIEWER_H */
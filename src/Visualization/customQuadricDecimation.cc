@@ -42,7 +42,6 @@
 #include "customQuadricDecimation.h"
 #include "vtkCellArray.h"
 #include "vtkCellData.h"
-#include "vtkEdgeTable.h"
 #include "vtkDoubleArray.h"
 #include "vtkGenericCell.h"
 #include "vtkIdList.h"
@@ -52,23 +51,43 @@
 #include "vtkObjectFactory.h"
 #include "vtkPolyData.h"
 #include "vtkPointData.h"
-#include "vtkPriorityQueue.h"
 #include "vtkTriangle.h"
+#include "vtkTimerLog.h"
 #include <vtkSmartPointer.h>
 
+#include <algorithm>
+#include <vector>
+
+#include <QThread>
+#include <QtConcurrentMap>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <Data/EdgeTable.h>
+#include <Visualization/EdgeHeap.h>
+
 vtkStandardNewMacro( customQuadricDecimation );
 
 //----------------------------------------------------------------------------
 customQuadricDecimation::customQuadricDecimation()
 {
-  this->Edges = vtkEdgeTable::New();
-  this->EdgeCosts = vtkPriorityQueue::New();
-  this->EndPoint1List = vtkIdList::New();
-  this->EndPoint2List = vtkIdList::New();
-  this->ErrorQuadrics = NULL;
+  this->Edges = new EdgeTable();
+  this->EdgeCosts = new EdgeHeap();
+  this->QuadricBuffer = NULL;
+  this->Quadrics = NULL;
+  this->QuadricStride = 0;
+  this->QuadricSize = 0;
   this->TargetPoints = vtkDoubleArray::New();
 
   this->TargetReduction = 0.9;
+  this->NumberOfPartitions = 1;
+  this->ParallelCosts = 1;
+  this->VectorizedCosts = 1;
+  this->PreserveTopology = 1;
+  this->NumberOfTopologyRejections = 0;
+  this->LockedPoints = NULL;
   this->NumberOfEdgeCollapses = 0;
   this->NumberOfComponents = 0;
 
@@ -86,16 +105,20 @@ customQuadricDecimation::customQuadricDecimation()
   this->TensorsWeight = 0.1;
 
   this->ActualReduction = 0.0;
+  this->MaximumError = 0.0;
+  this->QuadricTime = 0.0;
+  this->CostTime = 0.0;
+  this->CollapseTime = 0.0;
+  this->CollapseRate = 0.0;
 }
 
 //----------------------------------------------------------------------------
 customQuadricDecimation::~customQuadricDecimation()
 {
-  this->Edges->Delete();
-  this->EdgeCosts->Delete();
-  this->EndPoint1List->Delete();
-  this->EndPoint2List->Delete();
+  delete this->Edges;
+  delete this->EdgeCosts;
   this->TargetPoints->Delete();
+  this->FreeQuadrics();
 }
 
 void customQuadricDecimation::SetPointAttributeArray( vtkIdType ptId,
@@ -214,6 +237,14 @@ int customQuadricDecimation::RequestData(
     return 1;
   }
 
+  // each partition should keep enough interior to be worth a thread
+  if ( this->NumberOfPartitions > 1 && !this->AttributeErrorMetric &&
+       numTris >= 10000 * (vtkIdType)this->NumberOfPartitions )
+  {
+    this->DecimatePartitioned( input, output );
+    return 1;
+  }
+
   polys = vtkCellArray::New();
   points = vtkPoints::New();
   pointData = vtkPointData::New();
@@ -236,27 +267,21 @@ int customQuadricDecimation::RequestData(
   this->Mesh->BuildCells();
   this->Mesh->BuildLinks();
 
-  this->ErrorQuadrics =
-    new customQuadricDecimation::ErrorQuadric[numPts];
-
   vtkDebugMacro( << "Computing Edges" );
-  this->Edges->InitEdgeInsertion( numPts, 1 ); // storing edge id as attribute
-  this->EdgeCosts->Allocate( this->Mesh->GetPolys()->GetNumberOfCells() * 3 );
+  // a closed triangle mesh has 3/2 edges per triangle
+  this->Edges->initialize( 3 * numTris / 2 + 1 );
+  this->EdgeCosts->initialize( 3 * numTris / 2 + 1 );
   for ( i = 0; i < this->Mesh->GetNumberOfCells(); i++ )
   {
     this->Mesh->GetCellPoints( i, npts, pts );
 
     for ( j = 0; j < 3; j++ )
     {
-      if ( this->Edges->IsEdge( pts[j], pts[( j + 1 ) % 3] ) == -1 )
+      if ( this->Edges->find_edge( pts[j], pts[( j + 1 ) % 3] ) == -1 )
       {
-        // If this edge has not been processed, get an id for it, add it to
-        // the edge list (Edges), and add its endpoints to the EndPoint1List
-        // and EndPoint2List (the 2 endpoints to different lists).
-        edgeId = this->Edges->GetNumberOfEdges();
-        this->Edges->InsertEdge( pts[j], pts[( j + 1 ) % 3], edgeId );
-        this->EndPoint1List->InsertId( edgeId, pts[j] );
-        this->EndPoint2List->InsertId( edgeId, pts[( j + 1 ) % 3] );
+        // If this edge has not been processed, add it to the edge table,
+        // which numbers the edges and keeps their endpoints.
+        this->Edges->insert_edge( pts[j], pts[( j + 1 ) % 3] );
       }
     }
   }
@@ -283,31 +308,57 @@ int customQuadricDecimation::RequestData(
   this->TargetPoints->SetNumberOfComponents( 3 + this->NumberOfComponents );
 
   vtkDebugMacro( << "Computing Quadrics" );
+  double startTime = vtkTimerLog::GetUniversalTime();
   this->InitializeQuadrics( numPts );
   this->AddBoundaryConstraints();
+  this->QuadricTime = vtkTimerLog::GetUniversalTime() - startTime;
   this->UpdateProgress( 0.15 );
 
   vtkDebugMacro( << "Computing Costs" );
+  startTime = vtkTimerLog::GetUniversalTime();
   // Compute the cost of and target point for collapsing each edge.
-  for ( i = 0; i < this->Edges->GetNumberOfEdges(); i++ )
+  if ( this->AttributeErrorMetric )
   {
-    if ( this->AttributeErrorMetric )
+    for ( i = 0; i < this->Edges->get_num_edges(); i++ )
     {
       cost = this->ComputeCost2( i, x );
+      if ( !this->IsLockedEdge( i ) )
+      {
+        this->EdgeCosts->insert( i, cost );
+      }
+      this->TargetPoints->InsertTuple( i, x );
     }
-    else
+  }
+  else
+  {
+    vtkIdType numEdges = this->Edges->get_num_edges();
+    std::vector<double> costs( numEdges );
+    std::vector<double> targets( 3 * numEdges );
+    if ( numEdges > 0 )
+    {
+      this->ComputeInitialCosts( numEdges, &costs[0], &targets[0] );
+    }
+
+    this->TargetPoints->SetNumberOfTuples( numEdges );
+    for ( i = 0; i < numEdges; i++ )
     {
-      cost = this->ComputeCost( i, x );
+      if ( !this->IsLockedEdge( i ) )
+      {
+        this->EdgeCosts->insert( i, costs[i] );
+      }
+      this->TargetPoints->SetTuple( i, &targets[3 * i] );
     }
-    this->EdgeCosts->Insert( cost, i );
-    this->TargetPoints->InsertTuple( i, x );
   }
+  this->CostTime = vtkTimerLog::GetUniversalTime() - startTime;
   this->UpdateProgress( 0.20 );
 
   // Okay collapse edges until desired reduction is reached
+  startTime = vtkTimerLog::GetUniversalTime();
   this->ActualReduction = 0.0;
+  this->MaximumError = 0.0;
   this->NumberOfEdgeCollapses = 0;
-  edgeId = this->EdgeCosts->Pop( 0, cost );
+  this->NumberOfTopologyRejections = 0;
+  edgeId = this->EdgeCosts->pop( cost );
 
   int abort = 0;
   while ( !abort && edgeId >= 0 && cost < VTK_DOUBLE_MAX &&
@@ -320,37 +371,49 @@ int customQuadricDecimation::RequestData(
       abort = this->GetAbortExecute();
     }
 
-    endPtIds[0] = this->EndPoint1List->GetId( edgeId );
-    endPtIds[1] = this->EndPoint2List->GetId( edgeId );
+    endPtIds[0] = this->Edges->get_end_point( edgeId, 0 );
+    endPtIds[1] = this->Edges->get_end_point( edgeId, 1 );
     this->TargetPoints->GetTuple( edgeId, x );
 
+    // edges on locked points can come back through a cost update, drop them
+    if ( this->IsLockedEdge( edgeId ) )
+    {
+      edgeId = this->EdgeCosts->pop( cost );
+      continue;
+    }
+
     // check for a poorly placed point
     if ( !this->IsGoodPlacement( endPtIds[0], endPtIds[1], x ) )
     {
       vtkDebugMacro( << "Poor placement detected " << edgeId << " " << cost );
-      // return the point to the queue but with the max cost so that
-      // when it is recomputed it will be reconsidered
-      this->EdgeCosts->Insert( VTK_DOUBLE_MAX, edgeId );
+      // leave the edge out of the queue, it is reconsidered when a
+      // neighboring collapse recomputes its cost
 
-      edgeId = this->EdgeCosts->Pop( 0, cost );
+      edgeId = this->EdgeCosts->pop( cost );
       continue;
     }
-/*
-    // check for a poorly placed point
-    if ( !this->IsGoodIdea( endPtIds[0], endPtIds[1] ) )
+
+    // check for a change of topology
+    if ( this->PreserveTopology && !this->IsGoodIdea( endPtIds[0], endPtIds[1] ) )
     {
-      //std::cerr << "bad idea detected!\n";
       vtkDebugMacro( << "Bad idea detected " << edgeId << " " << cost );
-      // return the point to the queue but with the max cost so that
-      // when it is recomputed it will be reconsidered
-      this->EdgeCosts->Insert( VTK_DOUBLE_MAX, edgeId );
+      // leave the edge out of the queue, it is reconsidered when a
+      // neighboring collapse recomputes its cost
+      this->NumberOfTopologyRejections++;
 
-      edgeId = this->EdgeCosts->Pop( 0, cost );
+      edgeId = this->EdgeCosts->pop( cost );
       continue;
     }
-*/
+
     this->NumberOfEdgeCollapses++;
 
+    // the last quadric entry accumulates the area of the planes
+    double area = this->GetQuadric( endPtIds[0], 10 ) + this->GetQuadric( endPtIds[1], 10 );
+    if ( area > 0 && cost > 0 )
+    {
+      this->MaximumError = std::max( this->MaximumError, sqrt( cost / area ) );
+    }
+
     // Set the new coordinates of point0.
     this->SetPointAttributeArray( endPtIds[0], x );
     vtkDebugMacro( << "Cost: " << cost << " Edge: "
@@ -364,18 +427,24 @@ int customQuadricDecimation::RequestData(
     // Update the output triangles.
     numDeletedTris += this->CollapseEdge( endPtIds[0], endPtIds[1] );
     this->ActualReduction = (double) numDeletedTris / numTris;
-    edgeId = this->EdgeCosts->Pop( 0, cost );
+    edgeId = this->EdgeCosts->pop( cost );
+  }
+
+  this->CollapseTime = vtkTimerLog::GetUniversalTime() - startTime;
+  this->CollapseRate = 0.0;
+  if ( this->CollapseTime > 0 )
+  {
+    this->CollapseRate = this->NumberOfEdgeCollapses / this->CollapseTime;
   }
 
   vtkDebugMacro( << "Number Of Edge Collapses: "
                  << this->NumberOfEdgeCollapses << " Cost: " << cost );
+  vtkDebugMacro( << "Quadrics: " << this->QuadricTime << "s Costs: " << this->CostTime
+                 << "s Collapses: " << this->CollapseTime << "s ("
+                 << this->CollapseRate << "/s)" );
 
   // clean up working data
-  for ( i = 0; i < numPts; i++ )
-  {
-    delete [] this->ErrorQuadrics[i].Quadric;
-  }
-  delete [] this->ErrorQuadrics;
+  this->FreeQuadrics();
   delete [] x;
   this->CollapseCellIds->Delete();
   delete [] this->TempX;
@@ -393,10 +462,39 @@ int customQuadricDecimation::RequestData(
     }
   }
 
+  // copy the cells and the points they use, remembering the input id of
+  // every output point
+  std::vector<vtkIdType> pointMap( numPts, -1 );
+  vtkPoints* outputPoints = vtkPoints::New();
+  outputPoints->SetDataType( input->GetPoints()->GetDataType() );
+  vtkCellArray* outputPolys = vtkCellArray::New();
+  outputPolys->Allocate( outputPolys->EstimateSize( outputCellList->GetNumberOfIds(), 3 ) );
+
   output->Reset();
-  output->Allocate( this->Mesh, outputCellList->GetNumberOfIds() );
-  output->GetPointData()->CopyAllocate( this->Mesh->GetPointData(), 1 );
-  output->CopyCells( this->Mesh, outputCellList );
+  output->GetPointData()->CopyAllocate( this->Mesh->GetPointData(), numPts );
+  this->OutputPointIds.clear();
+
+  for ( i = 0; i < outputCellList->GetNumberOfIds(); i++ )
+  {
+    vtkIdType newPts[3];
+    this->Mesh->GetCellPoints( outputCellList->GetId( i ), npts, pts );
+    for ( j = 0; j < npts; j++ )
+    {
+      if ( pointMap[pts[j]] < 0 )
+      {
+        pointMap[pts[j]] = outputPoints->InsertNextPoint( this->Mesh->GetPoint( pts[j] ) );
+        output->GetPointData()->CopyData( this->Mesh->GetPointData(), pts[j], pointMap[pts[j]] );
+        this->OutputPointIds.push_back( pts[j] );
+      }
+      newPts[j] = pointMap[pts[j]];
+    }
+    outputPolys->InsertNextCell( npts, newPts );
+  }
+
+  output->SetPoints( outputPoints );
+  output->SetPolys( outputPolys );
+  outputPoints->Delete();
+  outputPolys->Delete();
 
   this->Mesh->DeleteLinks();
   this->Mesh->Delete();
@@ -414,16 +512,41 @@ int customQuadricDecimation::RequestData(
     }
     // might want to add clamping texture coordinates??
   }
+  else
+  {
+    this->CopyInputPointData( input, output );
+  }
 
   return 1;
 }
 
+//----------------------------------------------------------------------------
+// The working mesh carries no point data without the attribute metric, and
+// the partitions decimate bare geometry, so the output takes the point data
+// of the input points it was kept from.
+void customQuadricDecimation::CopyInputPointData( vtkPolyData* input, vtkPolyData* output )
+{
+  vtkIdType numPts = (vtkIdType)this->OutputPointIds.size();
+  if ( numPts != output->GetNumberOfPoints() )
+  {
+    return;
+  }
+
+  vtkPointData* outputPD = vtkPointData::New();
+  outputPD->CopyAllocate( input->GetPointData(), numPts );
+  for ( vtkIdType i = 0; i < numPts; i++ )
+  {
+    outputPD->CopyData( input->GetPointData(), this->OutputPointIds[i], i );
+  }
+  output->GetPointData()->ShallowCopy( outputPD );
+  outputPD->Delete();
+}
+
 //----------------------------------------------------------------------------
 void customQuadricDecimation::InitializeQuadrics( vtkIdType numPts )
 {
   vtkPolyData* input = this->Mesh;
   double* QEM;
-  vtkIdType ptId;
   int i, j;
   vtkCellArray* polys;
   vtkIdType npts, * pts = NULL;
@@ -442,15 +565,7 @@ void customQuadricDecimation::InitializeQuadrics( vtkIdType numPts )
   QEM = new double[11 + 4 * this->NumberOfComponents];
 
   // clear and allocate global QEM array
-  for ( ptId = 0; ptId < numPts; ptId++ )
-  {
-    this->ErrorQuadrics[ptId].Quadric =
-      new double[11 + 4 * this->NumberOfComponents];
-    for ( i = 0; i < 11 + 4 * this->NumberOfComponents; i++ )
-    {
-      this->ErrorQuadrics[ptId].Quadric[i] = 0.0;
-    }
-  }
+  this->AllocateQuadrics( numPts );
 
   polys = input->GetPolys();
   // compute the QEM for each face
@@ -570,7 +685,7 @@ void customQuadricDecimation::InitializeQuadrics( vtkIdType numPts )
     {
       for ( j = 0; j < 11 + 4 * this->NumberOfComponents; j++ )
       {
-        this->ErrorQuadrics[pts[i]].Quadric[j] += QEM[j] * triArea2;
+        this->GetQuadric( pts[i], j ) += QEM[j] * triArea2;
       }
     }
   }  //for all triangles
@@ -652,8 +767,8 @@ void customQuadricDecimation::AddBoundaryConstraints( void )
         // check to interaction with attribute data
         for ( j = 0; j < 11; j++ )
         {
-          this->ErrorQuadrics[pts[i]].Quadric[j] += QEM[j] * w;
-          this->ErrorQuadrics[pts[( i + 1 ) % 3]].Quadric[j] += QEM[j] * w;
+          this->GetQuadric( pts[i], j ) += QEM[j] * w;
+          this->GetQuadric( pts[( i + 1 ) % 3], j ) += QEM[j] * w;
         }
       }
     }
@@ -667,10 +782,9 @@ void customQuadricDecimation::AddQuadric( vtkIdType oldPtId, vtkIdType newPtId )
 {
   int i;
 
-  for ( i = 0; i < 11 + 4 * this->NumberOfComponents; i++ )
+  for ( i = 0; i < this->QuadricSize; i++ )
   {
-    this->ErrorQuadrics[newPtId].Quadric[i] +=
-      this->ErrorQuadrics[oldPtId].Quadric[i];
+    this->GetQuadric( newPtId, i ) += this->GetQuadric( oldPtId, i );
   }
 }
 
@@ -690,7 +804,7 @@ void customQuadricDecimation::FindAffectedEdges( vtkIdType p1Id, vtkIdType p2Id,
     for ( j = 0; j < 3; j++ )
     {
       if ( pts[j] != p1Id && pts[j] != p2Id &&
-           ( edgeId = this->Edges->IsEdge( pts[j], p2Id ) ) >= 0 &&
+           ( edgeId = this->Edges->find_edge( pts[j], p2Id ) ) >= 0 &&
            edges->IsId( edgeId ) == -1 )
       {
         edges->InsertNextId( edgeId );
@@ -705,7 +819,7 @@ void customQuadricDecimation::FindAffectedEdges( vtkIdType p1Id, vtkIdType p2Id,
     for ( j = 0; j < 3; j++ )
     {
       if ( pts[j] != p1Id && pts[j] != p2Id &&
-           ( edgeId = this->Edges->IsEdge( pts[j], p1Id ) ) >= 0 &&
+           ( edgeId = this->Edges->find_edge( pts[j], p1Id ) ) >= 0 &&
            edges->IsId( edgeId ) == -1 )
       {
         edges->InsertNextId( edgeId );
@@ -727,25 +841,22 @@ void customQuadricDecimation::UpdateEdgeData( vtkIdType pt0Id, vtkIdType pt1Id )
   // Reset the endpoints for these edges to reflect the new point from the
   // collapsed edge.
   // Add these new edges to the edge table.
-  // Remove the the changed edges from the priority queue.
+  // Edges to the deleted point leave the priority queue, the others get
+  // their cost updated.
   for ( i = 0; i < changedEdges->GetNumberOfIds(); i++ )
   {
-    edge[0] = this->EndPoint1List->GetId( changedEdges->GetId( i ) );
-    edge[1] = this->EndPoint2List->GetId( changedEdges->GetId( i ) );
-
-    // Remove all affected edges from the priority queue.
-    // This does not include collapsed edge.
-    this->EdgeCosts->DeleteId( changedEdges->GetId( i ) );
+    edge[0] = this->Edges->get_end_point( changedEdges->GetId( i ), 0 );
+    edge[1] = this->Edges->get_end_point( changedEdges->GetId( i ), 1 );
 
     // Determine the new set of edges
     if ( edge[0] == pt1Id )
     {
-      if ( this->Edges->IsEdge( edge[1], pt0Id ) == -1 )
+      // Remove the edge to the deleted point from the priority queue.
+      this->EdgeCosts->remove( changedEdges->GetId( i ) );
+
+      if ( this->Edges->find_edge( edge[1], pt0Id ) == -1 )
       {   // The edge will be completely new, add it.
-        edgeId = this->Edges->GetNumberOfEdges();
-        this->Edges->InsertEdge( edge[1], pt0Id, edgeId );
-        this->EndPoint1List->InsertId( edgeId, edge[1] );
-        this->EndPoint2List->InsertId( edgeId, pt0Id );
+        edgeId = this->Edges->insert_edge( edge[1], pt0Id );
         // Compute cost (target point/data) and add to priority cue.
         if ( this->AttributeErrorMetric )
         {
@@ -755,18 +866,17 @@ void customQuadricDecimation::UpdateEdgeData( vtkIdType pt0Id, vtkIdType pt1Id )
         {
           cost = this->ComputeCost( edgeId, this->TempX );
         }
-        this->EdgeCosts->Insert( cost, edgeId );
+        this->EdgeCosts->insert( edgeId, cost );
         this->TargetPoints->InsertTuple( edgeId, this->TempX );
       }
     }
     else if ( edge[1] == pt1Id )
     {   // The edge will be completely new, add it.
-      if ( this->Edges->IsEdge( edge[0], pt0Id ) == -1 )
+      this->EdgeCosts->remove( changedEdges->GetId( i ) );
+
+      if ( this->Edges->find_edge( edge[0], pt0Id ) == -1 )
       {
-        edgeId = this->Edges->GetNumberOfEdges();
-        this->Edges->InsertEdge( edge[0], pt0Id, edgeId );
-        this->EndPoint1List->InsertId( edgeId, edge[0] );
-        this->EndPoint2List->InsertId( edgeId, pt0Id );
+        edgeId = this->Edges->insert_edge( edge[0], pt0Id );
         // Compute cost (target point/data) and add to priority cue.
         if ( this->AttributeErrorMetric )
         {
@@ -776,12 +886,13 @@ void customQuadricDecimation::UpdateEdgeData( vtkIdType pt0Id, vtkIdType pt1Id )
         {
           cost = this->ComputeCost( edgeId, this->TempX );
         }
-        this->EdgeCosts->Insert( cost, edgeId );
+        this->EdgeCosts->insert( edgeId, cost );
         this->TargetPoints->InsertTuple( edgeId, this->TempX );
       }
     }
     else
-    {   // This edge already has one point as the merged point.
+    {   // This edge already has one point as the merged point, update its
+        // cost in place.
       if ( this->AttributeErrorMetric )
       {
         cost = this->ComputeCost2( changedEdges->GetId( i ), this->TempX );
@@ -790,7 +901,7 @@ void customQuadricDecimation::UpdateEdgeData( vtkIdType pt0Id, vtkIdType pt1Id )
       {
         cost = this->ComputeCost( changedEdges->GetId( i ), this->TempX );
       }
-      this->EdgeCosts->Insert( cost, changedEdges->GetId( i ) );
+      this->EdgeCosts->insert( changedEdges->GetId( i ), cost );
       this->TargetPoints->InsertTuple( changedEdges->GetId( i ), this->TempX );
     }
   }
@@ -802,54 +913,67 @@ void customQuadricDecimation::UpdateEdgeData( vtkIdType pt0Id, vtkIdType pt1Id )
 //----------------------------------------------------------------------------
 double customQuadricDecimation::ComputeCost( vtkIdType edgeId, double* x )
 {
-  static const double errorNumber = 1e-10;
-  double temp[3], A[3][3], b[3];
-  vtkIdType pointIds[2];
-  double cost = 0.0;
-  double* index;
-  int i, j;
-  double newPoint [4];
-  double v[3], c, norm, normTemp, temp2[3];
+  double quad[10];
   double pt1[3], pt2[3];
+  vtkIdType pointIds[2];
+  int i;
 
-  pointIds[0] = this->EndPoint1List->GetId( edgeId );
-  pointIds[1] = this->EndPoint2List->GetId( edgeId );
+  pointIds[0] = this->Edges->get_end_point( edgeId, 0 );
+  pointIds[1] = this->Edges->get_end_point( edgeId, 1 );
 
-  for ( i = 0; i < 11 + 4 * this->NumberOfComponents; i++ )
+  for ( i = 0; i < 10; i++ )
   {
-    this->TempQuad[i] = this->ErrorQuadrics[pointIds[0]].Quadric[i] +
-                        this->ErrorQuadrics[pointIds[1]].Quadric[i];
+    quad[i] = this->GetQuadric( pointIds[0], i ) + this->GetQuadric( pointIds[1], i );
   }
 
-  A[0][0] = this->TempQuad[0];
-  A[0][1] = A[1][0] = this->TempQuad[1];
-  A[0][2] = A[2][0] = this->TempQuad[2];
-  A[1][1] = this->TempQuad[4];
-  A[1][2] = A[2][1] = this->TempQuad[5];
-  A[2][2] = this->TempQuad[7];
+  this->Mesh->GetPoints()->GetPoint( pointIds[0], pt1 );
+  this->Mesh->GetPoints()->GetPoint( pointIds[1], pt2 );
 
-  b[0] = -this->TempQuad[3];
-  b[1] = -this->TempQuad[6];
-  b[2] = -this->TempQuad[8];
+  return customQuadricDecimation::EvaluateQuadric( quad, pt1, pt2, x );
+}
 
-  norm = vtkMath::Norm( A[0] );
-  normTemp = vtkMath::Norm( A[1] );
-  norm = norm > normTemp ? norm : normTemp;
-  normTemp = vtkMath::Norm( A[2] );
-  norm = norm > normTemp ? norm : normTemp;
+//----------------------------------------------------------------------------
+double customQuadricDecimation::EvaluateQuadric( const double* quad, const double* pt1,
+                                                 const double* pt2, double* x )
+{
+  static const double errorNumber = 1e-10;
+  double A[3][3], b[3];
+  double temp[3], temp2[3], v[3], c;
+  int i;
 
-  if ( fabs( vtkMath::Determinant3x3( A ) ) / ( norm * norm * norm ) > errorNumber )
+  A[0][0] = quad[0];
+  A[0][1] = A[1][0] = quad[1];
+  A[0][2] = A[2][0] = quad[2];
+  A[1][1] = quad[4];
+  A[1][2] = A[2][1] = quad[5];
+  A[2][2] = quad[7];
+
+  b[0] = -quad[3];
+  b[1] = -quad[6];
+  b[2] = -quad[8];
+
+  // A is symmetric, so is its adjugate
+  double c00 = quad[4] * quad[7] - quad[5] * quad[5];
+  double c01 = quad[2] * quad[5] - quad[1] * quad[7];
+  double c02 = quad[1] * quad[5] - quad[2] * quad[4];
+  double c11 = quad[0] * quad[7] - quad[2] * quad[2];
+  double c12 = quad[1] * quad[2] - quad[0] * quad[5];
+  double c22 = quad[0] * quad[4] - quad[1] * quad[1];
+  double det = quad[0] * c00 + quad[1] * c01 + quad[2] * c02;
+
+  double norm = std::max( vtkMath::Dot( A[0], A[0] ),
+                          std::max( vtkMath::Dot( A[1], A[1] ), vtkMath::Dot( A[2], A[2] ) ) );
+  norm = sqrt( norm );
+
+  if ( fabs( det ) > errorNumber * norm * norm * norm )
   {
-    // it would be better to use the normal of the matrix to test singularity??
-    vtkMath::LinearSolve3x3( A, b, x );
-    vtkMath::Multiply3x3( A, x, temp );
-    // error too high, backup plans
+    x[0] = ( c00 * b[0] + c01 * b[1] + c02 * b[2] ) / det;
+    x[1] = ( c01 * b[0] + c11 * b[1] + c12 * b[2] ) / det;
+    x[2] = ( c02 * b[0] + c12 * b[1] + c22 * b[2] ) / det;
   }
   else
   {
     // cheapest point along the edge
-    this->Mesh->GetPoints()->GetPoint( pointIds[0], pt1 );
-    this->Mesh->GetPoints()->GetPoint( pointIds[1], pt2 );
     v[0] = pt2[0] - pt1[0];
     v[1] = pt2[1] - pt1[1];
     v[2] = pt2[2] - pt1[2];
@@ -881,24 +1005,488 @@ double customQuadricDecimation::ComputeCost( vtkIdType edgeId, double* x )
     }
   }
 
-  newPoint[0] = x[0];
-  newPoint[1] = x[1];
-  newPoint[2] = x[2];
-  newPoint[3] = 1;
-
   // Compute the cost
-  // x'*quad*x
-  index = this->TempQuad;
-  for ( i = 0; i < 4; i++ )
+  // x'*quad*x with x = (x0, x1, x2, 1)
+  return quad[9]
+         + x[0] * ( quad[0] * x[0] + 2.0 * ( quad[1] * x[1] + quad[2] * x[2] + quad[3] ) )
+         + x[1] * ( quad[4] * x[1] + 2.0 * ( quad[5] * x[2] + quad[6] ) )
+         + x[2] * ( quad[7] * x[2] + 2.0 * quad[8] );
+}
+
+//----------------------------------------------------------------------------
+void customQuadricDecimation::ComputeInitialCosts( vtkIdType numEdges, double* costs, double* targets )
+{
+  if ( !this->ParallelCosts )
   {
-    cost += ( *index++ ) * newPoint[i] * newPoint[i];
-    for ( j = i + 1; j < 4; j++ )
+    CostRange range;
+    range.Filter = this;
+    range.Begin = 0;
+    range.End = numEdges;
+    range.Costs = costs;
+    range.Targets = targets;
+    customQuadricDecimation::ComputeCostRange( range );
+    return;
+  }
+
+  // a few ranges per thread to balance the load
+  const vtkIdType minRange = 4096;
+  vtkIdType numRanges = std::max( (vtkIdType)1, std::min( numEdges / minRange,
+                                                          (vtkIdType)( 4 * QThread::idealThreadCount() ) ) );
+  vtkIdType rangeSize = ( numEdges + numRanges - 1 ) / numRanges;
+  rangeSize = ( rangeSize + 3 ) & ~(vtkIdType)3;
+
+  std::vector<CostRange> ranges;
+  for ( vtkIdType begin = 0; begin < numEdges; begin += rangeSize )
+  {
+    CostRange range;
+    range.Filter = this;
+    range.Begin = begin;
+    range.End = std::min( numEdges, begin + rangeSize );
+    range.Costs = costs;
+    range.Targets = targets;
+    ranges.push_back( range );
+  }
+
+  QtConcurrent::blockingMap( ranges, customQuadricDecimation::ComputeCostRange );
+}
+
+//----------------------------------------------------------------------------
+void customQuadricDecimation::ComputeCostRange( CostRange &range )
+{
+  customQuadricDecimation* self = range.Filter;
+  vtkIdType edgeId = range.Begin;
+
+#ifdef __AVX2__
+  static const double errorNumber = 1e-10;
+  const vtkIdType* endPoints = self->Edges->get_end_points();
+  const __m256d two = _mm256_set1_pd( 2.0 );
+  const __m256d signMask = _mm256_set1_pd( -0.0 );
+  const __m256d epsilon = _mm256_set1_pd( errorNumber );
+
+  // four edges at a time, gathering each quadric component from the
+  // component major buffer
+  for ( ; self->VectorizedCosts && edgeId + 4 <= range.End; edgeId += 4 )
+  {
+    long long ids1[4], ids2[4];
+    for ( int lane = 0; lane < 4; lane++ )
     {
-      cost += 2.0 * ( *index++ ) * newPoint[i] * newPoint[j];
+      ids1[lane] = endPoints[2 * ( edgeId + lane )];
+      ids2[lane] = endPoints[2 * ( edgeId + lane ) + 1];
+    }
+    __m256i index1 = _mm256_loadu_si256( (const __m256i*)ids1 );
+    __m256i index2 = _mm256_loadu_si256( (const __m256i*)ids2 );
+
+    __m256d q[10];
+    for ( int i = 0; i < 10; i++ )
+    {
+      const double* component = self->Quadrics + i * self->QuadricStride;
+      q[i] = _mm256_add_pd( _mm256_i64gather_pd( component, index1, 8 ),
+                            _mm256_i64gather_pd( component, index2, 8 ) );
+    }
+
+    __m256d c00 = _mm256_sub_pd( _mm256_mul_pd( q[4], q[7] ), _mm256_mul_pd( q[5], q[5] ) );
+    __m256d c01 = _mm256_sub_pd( _mm256_mul_pd( q[2], q[5] ), _mm256_mul_pd( q[1], q[7] ) );
+    __m256d c02 = _mm256_sub_pd( _mm256_mul_pd( q[1], q[5] ), _mm256_mul_pd( q[2], q[4] ) );
+    __m256d c11 = _mm256_sub_pd( _mm256_mul_pd( q[0], q[7] ), _mm256_mul_pd( q[2], q[2] ) );
+    __m256d c12 = _mm256_sub_pd( _mm256_mul_pd( q[1], q[2] ), _mm256_mul_pd( q[0], q[5] ) );
+    __m256d c22 = _mm256_sub_pd( _mm256_mul_pd( q[0], q[4] ), _mm256_mul_pd( q[1], q[1] ) );
+    __m256d det = _mm256_add_pd( _mm256_mul_pd( q[0], c00 ),
+                                 _mm256_add_pd( _mm256_mul_pd( q[1], c01 ), _mm256_mul_pd( q[2], c02 ) ) );
+
+    // largest row norm of A for the singularity test
+    __m256d row0 = _mm256_add_pd( _mm256_mul_pd( q[0], q[0] ),
+                                  _mm256_add_pd( _mm256_mul_pd( q[1], q[1] ), _mm256_mul_pd( q[2], q[2] ) ) );
+    __m256d row1 = _mm256_add_pd( _mm256_mul_pd( q[1], q[1] ),
+                                  _mm256_add_pd( _mm256_mul_pd( q[4], q[4] ), _mm256_mul_pd( q[5], q[5] ) ) );
+    __m256d row2 = _mm256_add_pd( _mm256_mul_pd( q[2], q[2] ),
+                                  _mm256_add_pd( _mm256_mul_pd( q[5], q[5] ), _mm256_mul_pd( q[7], q[7] ) ) );
+    __m256d norm = _mm256_sqrt_pd( _mm256_max_pd( row0, _mm256_max_pd( row1, row2 ) ) );
+    __m256d limit = _mm256_mul_pd( epsilon, _mm256_mul_pd( norm, _mm256_mul_pd( norm, norm ) ) );
+    __m256d solvable = _mm256_cmp_pd( _mm256_andnot_pd( signMask, det ), limit, _CMP_GT_OQ );
+
+    __m256d inverse = _mm256_div_pd( _mm256_set1_pd( -1.0 ), det ); // b = -(q3, q6, q8)
+    __m256d x0 = _mm256_mul_pd( inverse, _mm256_add_pd( _mm256_mul_pd( c00, q[3] ),
+                                                        _mm256_add_pd( _mm256_mul_pd( c01, q[6] ), _mm256_mul_pd( c02, q[8] ) ) ) );
+    __m256d x1 = _mm256_mul_pd( inverse, _mm256_add_pd( _mm256_mul_pd( c01, q[3] ),
+                                                        _mm256_add_pd( _mm256_mul_pd( c11, q[6] ), _mm256_mul_pd( c12, q[8] ) ) ) );
+    __m256d x2 = _mm256_mul_pd( inverse, _mm256_add_pd( _mm256_mul_pd( c02, q[3] ),
+                                                        _mm256_add_pd( _mm256_mul_pd( c12, q[6] ), _mm256_mul_pd( c22, q[8] ) ) ) );
+
+    // x'*quad*x, same association as EvaluateQuadric
+    __m256d t0 = _mm256_add_pd( _mm256_mul_pd( q[0], x0 ),
+                                _mm256_mul_pd( two, _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( q[1], x1 ),
+                                                                                  _mm256_mul_pd( q[2], x2 ) ), q[3] ) ) );
+    __m256d t1 = _mm256_add_pd( _mm256_mul_pd( q[4], x1 ),
+                                _mm256_mul_pd( two, _mm256_add_pd( _mm256_mul_pd( q[5], x2 ), q[6] ) ) );
+    __m256d t2 = _mm256_add_pd( _mm256_mul_pd( q[7], x2 ), _mm256_mul_pd( two, q[8] ) );
+    __m256d cost = _mm256_add_pd( q[9], _mm256_add_pd( _mm256_mul_pd( x0, t0 ),
+                                                       _mm256_add_pd( _mm256_mul_pd( x1, t1 ), _mm256_mul_pd( x2, t2 ) ) ) );
+
+    double laneCosts[4], xs[3][4];
+    _mm256_storeu_pd( laneCosts, cost );
+    _mm256_storeu_pd( xs[0], x0 );
+    _mm256_storeu_pd( xs[1], x1 );
+    _mm256_storeu_pd( xs[2], x2 );
+    int mask = _mm256_movemask_pd( solvable );
+
+    for ( int lane = 0; lane < 4; lane++ )
+    {
+      double* target = range.Targets + 3 * ( edgeId + lane );
+      if ( mask & ( 1 << lane ) )
+      {
+        range.Costs[edgeId + lane] = laneCosts[lane];
+        target[0] = xs[0][lane];
+        target[1] = xs[1][lane];
+        target[2] = xs[2][lane];
+      }
+      else
+      {
+        // nearly singular, place the point along the edge
+        range.Costs[edgeId + lane] = self->ComputeCost( edgeId + lane, target );
+      }
     }
   }
+#endif
 
-  return cost;
+  for ( ; edgeId < range.End; edgeId++ )
+  {
+    range.Costs[edgeId] = self->ComputeCost( edgeId, range.Targets + 3 * edgeId );
+  }
+}
+
+//----------------------------------------------------------------------------
+int customQuadricDecimation::IsLockedEdge( vtkIdType edgeId )
+{
+  return this->LockedPoints &&
+         ( this->LockedPoints[this->Edges->get_end_point( edgeId, 0 )] ||
+           this->LockedPoints[this->Edges->get_end_point( edgeId, 1 )] );
+}
+
+//----------------------------------------------------------------------------
+void customQuadricDecimation::DecimatePartitioned( vtkPolyData* input, vtkPolyData* output )
+{
+  vtkIdType numPts = input->GetNumberOfPoints();
+  vtkIdType numTris = input->GetNumberOfPolys();
+  int numPartitions = this->NumberOfPartitions;
+  vtkIdType npts, * pts;
+  vtkIdType i;
+  int j;
+
+  double startTime = vtkTimerLog::GetUniversalTime();
+
+  // slabs along the longest axis of the bounds, with equal numbers of
+  // triangles taken from a histogram of the triangle centers
+  double bounds[6];
+  input->GetBounds( bounds );
+  int axis = 0;
+  for ( j = 1; j < 3; j++ )
+  {
+    if ( bounds[2 * j + 1] - bounds[2 * j] > bounds[2 * axis + 1] - bounds[2 * axis] )
+    {
+      axis = j;
+    }
+  }
+  double minimum = bounds[2 * axis];
+  double extent = std::max( bounds[2 * axis + 1] - minimum, 1e-300 );
+
+  const int numBins = 4096;
+  std::vector<vtkIdType> histogram( numBins, 0 );
+  std::vector<int> triangleBins( numTris );
+  vtkCellArray* polys = input->GetPolys();
+  polys->InitTraversal();
+  for ( i = 0; polys->GetNextCell( npts, pts ); i++ )
+  {
+    double center = 0;
+    for ( j = 0; j < npts; j++ )
+    {
+      double point[3];
+      input->GetPoints()->GetPoint( pts[j], point );
+      center += point[axis] / npts;
+    }
+    int bin = (int)( ( center - minimum ) / extent * numBins );
+    bin = std::max( 0, std::min( numBins - 1, bin ) );
+    triangleBins[i] = bin;
+    histogram[bin]++;
+  }
+
+  std::vector<int> binPartitions( numBins );
+  vtkIdType count = 0;
+  for ( j = 0; j < numBins; j++ )
+  {
+    binPartitions[j] = (int)std::min( (vtkIdType)numPartitions - 1, count * numPartitions / numTris );
+    count += histogram[j];
+  }
+
+  // points used by more than one partition are locked
+  std::vector<int> pointPartitions( numPts, -1 );
+  std::vector<unsigned char> shared( numPts, 0 );
+  std::vector<Partition> partitions( numPartitions );
+  for ( j = 0; j < numPartitions; j++ )
+  {
+    partitions[j].Parent = this;
+    partitions[j].Input = input;
+    partitions[j].MaximumError = 0;
+    partitions[j].NumberOfEdgeCollapses = 0;
+    partitions[j].NumberOfTopologyRejections = 0;
+  }
+
+  polys->InitTraversal();
+  for ( i = 0; polys->GetNextCell( npts, pts ); i++ )
+  {
+    int partition = binPartitions[triangleBins[i]];
+    for ( j = 0; j < npts; j++ )
+    {
+      if ( pointPartitions[pts[j]] == -1 )
+      {
+        pointPartitions[pts[j]] = partition;
+      }
+      else if ( pointPartitions[pts[j]] != partition )
+      {
+        shared[pts[j]] = 1;
+      }
+    }
+  }
+
+  polys->InitTraversal();
+  for ( i = 0; polys->GetNextCell( npts, pts ); i++ )
+  {
+    if ( npts != 3 )
+    {
+      continue;
+    }
+    Partition &partition = partitions[binPartitions[triangleBins[i]]];
+    for ( j = 0; j < npts; j++ )
+    {
+      partition.Triangles.push_back( pts[j] );
+    }
+  }
+  triangleBins.clear();
+
+  // number the points of each partition, one map reused for all of them
+  std::vector<vtkIdType> localIds( numPts, -1 );
+  std::vector<int> localOwners( numPts, -1 );
+  for ( j = 0; j < numPartitions; j++ )
+  {
+    Partition &partition = partitions[j];
+    for ( size_t k = 0; k < partition.Triangles.size(); k++ )
+    {
+      vtkIdType pointId = partition.Triangles[k];
+      if ( localOwners[pointId] != j )
+      {
+        localOwners[pointId] = j;
+        localIds[pointId] = partition.PointIds.size();
+        partition.PointIds.push_back( pointId );
+        partition.Locked.push_back( shared[pointId] );
+      }
+      partition.Triangles[k] = localIds[pointId];
+    }
+  }
+
+  QtConcurrent::blockingMap( partitions, customQuadricDecimation::DecimatePartition );
+
+  double partitionTime = vtkTimerLog::GetUniversalTime() - startTime;
+
+  // merge, partition points keep their input ids so the locked borders
+  // join up again
+  std::vector<vtkIdType> mergedIds( numPts, -1 );
+  std::vector<vtkIdType> mergedInputIds;
+  vtkPoints* mergedPoints = vtkPoints::New();
+  mergedPoints->SetDataType( input->GetPoints()->GetDataType() );
+  vtkCellArray* mergedPolys = vtkCellArray::New();
+  this->MaximumError = 0;
+  this->NumberOfEdgeCollapses = 0;
+  this->NumberOfTopologyRejections = 0;
+
+  for ( j = 0; j < numPartitions; j++ )
+  {
+    Partition &partition = partitions[j];
+    for ( size_t k = 0; k < partition.OutputPointIds.size(); k++ )
+    {
+      vtkIdType inputId = partition.OutputPointIds[k];
+      if ( mergedIds[inputId] < 0 )
+      {
+        mergedIds[inputId] = mergedPoints->InsertNextPoint( &partition.OutputPoints[3 * k] );
+        mergedInputIds.push_back( inputId );
+      }
+    }
+    for ( size_t k = 0; k < partition.OutputTriangles.size(); k += 3 )
+    {
+      vtkIdType triangle[3];
+      for ( int m = 0; m < 3; m++ )
+      {
+        triangle[m] = mergedIds[partition.OutputTriangles[k + m]];
+      }
+      mergedPolys->InsertNextCell( 3, triangle );
+    }
+    this->MaximumError = std::max( this->MaximumError, partition.MaximumError );
+    this->NumberOfEdgeCollapses += partition.NumberOfEdgeCollapses;
+    this->NumberOfTopologyRejections += partition.NumberOfTopologyRejections;
+    partition.OutputPoints.clear();
+    partition.OutputTriangles.clear();
+  }
+
+  vtkPolyData* merged = vtkPolyData::New();
+  merged->SetPoints( mergedPoints );
+  merged->SetPolys( mergedPolys );
+  mergedPoints->Delete();
+  mergedPolys->Delete();
+
+  // the last pass only works on a band two rings wide around the borders
+  vtkIdType numMerged = merged->GetNumberOfPoints();
+  std::vector<unsigned char> band( numMerged, 0 );
+  for ( i = 0; i < numMerged; i++ )
+  {
+    band[i] = shared[mergedInputIds[i]];
+  }
+  for ( int ring = 0; ring < 2; ring++ )
+  {
+    std::vector<unsigned char> next = band;
+    for ( mergedPolys->InitTraversal(); mergedPolys->GetNextCell( npts, pts ); )
+    {
+      if ( band[pts[0]] || band[pts[1]] || band[pts[2]] )
+      {
+        next[pts[0]] = next[pts[1]] = next[pts[2]] = 1;
+      }
+    }
+    band.swap( next );
+  }
+  std::vector<unsigned char> locked( numMerged );
+  for ( i = 0; i < numMerged; i++ )
+  {
+    locked[i] = !band[i];
+  }
+
+  vtkIdType targetTris = (vtkIdType)( numTris * ( 1.0 - this->TargetReduction ) );
+  vtkIdType mergedTris = merged->GetNumberOfPolys();
+
+  this->OutputPointIds.clear();
+  if ( mergedTris > targetTris && numMerged > 0 )
+  {
+    vtkSmartPointer<customQuadricDecimation> border = vtkSmartPointer<customQuadricDecimation>::New();
+    border->SetTargetReduction( 1.0 - (double)targetTris / mergedTris );
+    border->SetPreserveTopology( this->PreserveTopology );
+    border->LockedPoints = &locked[0];
+    border->SetInputData( merged );
+    border->Update();
+
+    output->ShallowCopy( border->GetOutput() );
+    for ( i = 0; i < (vtkIdType)border->OutputPointIds.size(); i++ )
+    {
+      this->OutputPointIds.push_back( mergedInputIds[border->OutputPointIds[i]] );
+    }
+    this->MaximumError = std::max( this->MaximumError, border->GetMaximumError() );
+    this->NumberOfEdgeCollapses += border->GetNumberOfEdgeCollapses();
+    this->NumberOfTopologyRejections += border->GetNumberOfTopologyRejections();
+  }
+  else
+  {
+    output->ShallowCopy( merged );
+    this->OutputPointIds = mergedInputIds;
+  }
+  merged->Delete();
+  this->CopyInputPointData( input, output );
+
+  this->ActualReduction = 1.0 - (double)output->GetNumberOfPolys() / numTris;
+  this->QuadricTime = 0;
+  this->CostTime = 0;
+  this->CollapseTime = vtkTimerLog::GetUniversalTime() - startTime;
+  this->CollapseRate = this->NumberOfEdgeCollapses / std::max( this->CollapseTime, 1e-9 );
+
+  vtkDebugMacro( << numPartitions << " partitions: " << partitionTime << "s, border pass: "
+                 << this->CollapseTime - partitionTime << "s" );
+}
+
+//----------------------------------------------------------------------------
+void customQuadricDecimation::DecimatePartition( Partition &partition )
+{
+  vtkIdType numPts = partition.PointIds.size();
+  vtkIdType numTris = partition.Triangles.size() / 3;
+  if ( numTris == 0 )
+  {
+    return;
+  }
+
+  vtkPoints* points = vtkPoints::New();
+  points->SetDataType( partition.Input->GetPoints()->GetDataType() );
+  points->SetNumberOfPoints( numPts );
+  for ( vtkIdType i = 0; i < numPts; i++ )
+  {
+    double point[3];
+    partition.Input->GetPoints()->GetPoint( partition.PointIds[i], point );
+    points->SetPoint( i, point );
+  }
+
+  vtkCellArray* polys = vtkCellArray::New();
+  polys->Allocate( polys->EstimateSize( numTris, 3 ) );
+  for ( vtkIdType i = 0; i < numTris; i++ )
+  {
+    polys->InsertNextCell( 3, &partition.Triangles[3 * i] );
+  }
+  partition.Triangles.clear();
+
+  vtkPolyData* mesh = vtkPolyData::New();
+  mesh->SetPoints( points );
+  mesh->SetPolys( polys );
+  points->Delete();
+  polys->Delete();
+
+  vtkSmartPointer<customQuadricDecimation> filter = vtkSmartPointer<customQuadricDecimation>::New();
+  filter->SetTargetReduction( partition.Parent->GetTargetReduction() );
+  filter->SetPreserveTopology( partition.Parent->GetPreserveTopology() );
+  filter->LockedPoints = &partition.Locked[0];
+  filter->SetInputData( mesh );
+  filter->Update();
+  mesh->Delete();
+
+  vtkPolyData* output = filter->GetOutput();
+  vtkIdType numOutput = output->GetNumberOfPoints();
+  partition.OutputPointIds.resize( numOutput );
+  partition.OutputPoints.resize( 3 * numOutput );
+  for ( vtkIdType i = 0; i < numOutput; i++ )
+  {
+    partition.OutputPointIds[i] = partition.PointIds[filter->OutputPointIds[i]];
+    output->GetPoints()->GetPoint( i, &partition.OutputPoints[3 * i] );
+  }
+
+  vtkIdType npts, * pts;
+  vtkCellArray* outputPolys = output->GetPolys();
+  for ( outputPolys->InitTraversal(); outputPolys->GetNextCell( npts, pts ); )
+  {
+    for ( int j = 0; j < npts; j++ )
+    {
+      partition.OutputTriangles.push_back( partition.OutputPointIds[pts[j]] );
+    }
+  }
+
+  partition.MaximumError = filter->GetMaximumError();
+  partition.NumberOfEdgeCollapses = filter->GetNumberOfEdgeCollapses();
+  partition.NumberOfTopologyRejections = filter->GetNumberOfTopologyRejections();
+}
+
+//----------------------------------------------------------------------------
+void customQuadricDecimation::AllocateQuadrics( vtkIdType numPts )
+{
+  this->FreeQuadrics();
+
+  this->QuadricSize = 11 + 4 * this->NumberOfComponents;
+  this->QuadricStride = ( numPts + 3 ) & ~(vtkIdType)3;
+
+  // one extra row of 4 doubles to align the start to 32 bytes
+  size_t size = (size_t)this->QuadricSize * this->QuadricStride;
+  this->QuadricBuffer = new double[size + 4];
+  size_t offset = ( 32 - ( (size_t)this->QuadricBuffer % 32 ) ) % 32;
+  this->Quadrics = (double*)( (char*)this->QuadricBuffer + offset );
+
+  std::fill( this->Quadrics, this->Quadrics + size, 0.0 );
+}
+
+//----------------------------------------------------------------------------
+void customQuadricDecimation::FreeQuadrics()
+{
+  delete [] this->QuadricBuffer;
+  this->QuadricBuffer = NULL;
+  this->Quadrics = NULL;
+  this->QuadricStride = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -913,13 +1501,12 @@ double customQuadricDecimation::ComputeCost2( vtkIdType edgeId, double* x )
   int i, j;
   int solveOk;
 
-  pointIds[0] = this->EndPoint1List->GetId( edgeId );
-  pointIds[1] = this->EndPoint2List->GetId( edgeId );
+  pointIds[0] = this->Edges->get_end_point( edgeId, 0 );
+  pointIds[1] = this->Edges->get_end_point( edgeId, 1 );
 
   for ( i = 0; i < 11 + 4 * this->NumberOfComponents; i++ )
   {
-    this->TempQuad[i] = this->ErrorQuadrics[pointIds[0]].Quadric[i] +
-                        this->ErrorQuadrics[pointIds[1]].Quadric[i];
+    this->TempQuad[i] = this->GetQuadric( pointIds[0], i ) + this->GetQuadric( pointIds[1], i );
   }
 
   // copy the temp quad into TempA
@@ -1251,83 +1838,87 @@ int customQuadricDecimation::IsGoodPlacement( vtkIdType pt0Id, vtkIdType pt1Id,
 
 int customQuadricDecimation::IsGoodIdea( vtkIdType pt0Id, vtkIdType pt1Id )
 {
-
-  unsigned short ncells, i;
-  vtkIdType npts, * pts, ptId, * cells;
-  double pt1[3], pt2[3], pt3[3];
-
-  unsigned short ncells2;
-  vtkIdType* cells2;
+  // Neighbors of pt0 and the points opposite the edge, in small fixed size
+  // sets. Valences beyond the set size are refused rather than checked.
+  const int maxNeighbors = 64;
+  vtkIdType neighbors[maxNeighbors];
+  vtkIdType opposite[2];
+  int numNeighbors = 0;
+  int numOpposite = 0;
+  unsigned short ncells;
+  vtkIdType npts, * pts, * cells;
+  int i, j, k;
 
   this->Mesh->GetPointCells( pt0Id, ncells, cells );
-  this->Mesh->GetPointCells( pt1Id, ncells2, cells2 );
-
-  vtkSmartPointer<vtkIdList> edge_cells = vtkSmartPointer<vtkIdList>::New();
-
-  for ( int i = 0; i < ncells; i++ )
+  for ( i = 0; i < ncells; i++ )
   {
-    for ( int j = 0; j < ncells2; j++ )
+    this->Mesh->GetCellPoints( cells[i], npts, pts );
+    int onEdge = ( pts[0] == pt1Id || pts[1] == pt1Id || pts[2] == pt1Id );
+
+    for ( j = 0; j < 3; j++ )
     {
-      if ( cells[i] == cells2[j] )
+      if ( pts[j] == pt0Id || pts[j] == pt1Id )
       {
-        edge_cells->InsertNextId( cells[i] );
+        continue;
       }
-    }
-  }
 
-/*
-   // identify base vertices
-   vtkSmartPointer<vtkIdList> base_vertices = vtkSmartPointer<vtkIdList>::New();
+      if ( onEdge )
+      {
+        if ( numOpposite == 2 )
+        {
+          return 0; // more than two triangles on the edge
+        }
+        opposite[numOpposite++] = pts[j];
+      }
 
-   for (i = 0; i < edge_cells->Size(); i++) {
-    this->Mesh->GetCellPoints(edge_cells[i], npts, pts);
-    for (ptId = 0; ptId < 3; ptId++)
-    {
-      base_vertices->InsertNextId(pts[ptId]);
+      for ( k = 0; k < numNeighbors && neighbors[k] != pts[j]; k++ )
+      {
+      }
+      if ( k == numNeighbors )
+      {
+        if ( numNeighbors == maxNeighbors )
+        {
+          return 0;
+        }
+        neighbors[numNeighbors++] = pts[j];
+      }
     }
-   }
- */
-
-  vtkSmartPointer<vtkIdList> far_vertices = vtkSmartPointer<vtkIdList>::New();
+  }
 
-  // for each base cell
-  for ( i = 0; i < edge_cells->GetNumberOfIds(); i++ )
+  // every neighbor of pt1 that is also a neighbor of pt0 must be opposite
+  // the edge
+  this->Mesh->GetPointCells( pt1Id, ncells, cells );
+  for ( i = 0; i < ncells; i++ )
   {
-    vtkIdType base_npts, * base_pts;
-
-    // identify base points
-    this->Mesh->GetCellPoints( edge_cells->GetId(i), base_npts, base_pts );
-
-    for ( ptId = 0; ptId < 3; ptId++ ) // for each vertex in the base cells
+    this->Mesh->GetCellPoints( cells[i], npts, pts );
+    for ( j = 0; j < 3; j++ )
     {
-      unsigned short ncells3;
-      vtkIdType* cells3;
-
-      // find all neighboring cells
-      this->Mesh->GetPointCells( pts[ptId], ncells3, cells3 );
-
-      for ( int c = 0; c < ncells3; c++ ) // for each neighboring cell
+      vtkIdType ptId = pts[j];
+      if ( ptId == pt0Id || ptId == pt1Id ||
+           ( numOpposite > 0 && ptId == opposite[0] ) ||
+           ( numOpposite > 1 && ptId == opposite[1] ) )
       {
-        vtkIdType far_npts, * far_pts;
-
-        // identify base points
-        this->Mesh->GetCellPoints( cells3[c], far_npts, far_pts );
-        for ( int p = 0; p < far_npts; p++ )
+        continue;
+      }
+      for ( k = 0; k < numNeighbors; k++ )
+      {
+        if ( neighbors[k] == ptId )
         {
-
-          for ( int v = 0; v < far_vertices->GetNumberOfIds(); v++ )
-          {
-            if ( far_vertices->GetId(v) == far_pts[p] )
-            {
-              return 0; // not a good idea
-            }
-            far_vertices->InsertNextId( far_pts[p] );
-          }
+          return 0;
         }
       }
     }
   }
 
+  // the links may not share an edge either, which happens when the two
+  // opposite points close a tetrahedron around the edge
+  if ( numOpposite == 2 &&
+       this->Mesh->IsTriangle( pt0Id, opposite[0], opposite[1] ) &&
+       this->Mesh->IsTriangle( pt1Id, opposite[0], opposite[1] ) )
+  {
+    return 0;
+  }
+
   return 1;
 }
 
@@ -1450,6 +2041,11 @@ void customQuadricDecimation::PrintSelf( ostream& os, vtkIndent indent )
 
   os << indent << "Target Reduction: " << this->TargetReduction << "\n";
   os << indent << "Actual Reduction: " << this->ActualReduction << "\n";
+  os << indent << "Maximum Error: " << this->MaximumError << "\n";
+  os << indent << "Parallel Costs: " << ( this->ParallelCosts ? "On\n" : "Off\n" );
+  os << indent << "Vectorized Costs: " << ( this->VectorizedCosts ? "On\n" : "Off\n" );
+  os << indent << "Preserve Topology: " << ( this->PreserveTopology ? "On\n" : "Off\n" );
+  os << indent << "Number Of Topology Rejections: " << this->NumberOfTopologyRejections << "\n";
 
   os << indent << "Attribute Error Metric: "
      << ( this->AttributeErrorMetric ? "On\n" : "Off\n" );
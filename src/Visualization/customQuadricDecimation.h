@@ -56,11 +56,13 @@
 #include "vtkFiltersCoreModule.h" // For export macro
 #include "vtkPolyDataAlgorithm.h"
 
-class vtkEdgeTable;
+#include <vector>
+
 class vtkIdList;
 class vtkPointData;
-class vtkPriorityQueue;
 class vtkDoubleArray;
+class EdgeTable;
+class EdgeHeap;
 
 class VTKFILTERSCORE_EXPORT customQuadricDecimation : public vtkPolyDataAlgorithm
 {
@@ -76,6 +78,38 @@ public:
   vtkSetClampMacro(TargetReduction, double, 0.0, 1.0);
   vtkGetMacro(TargetReduction, double);
 
+  // Description:
+  // Split the mesh into this many slabs along its longest axis, decimate the
+  // slabs on separate threads with the edges on slab borders frozen, then
+  // run one more pass over a band around the borders. 1 (the default)
+  // decimates the whole mesh in one sequential pass. Only used with the
+  // geometric error metric.
+  vtkSetClampMacro(NumberOfPartitions, int, 1, VTK_INT_MAX);
+  vtkGetMacro(NumberOfPartitions, int);
+
+  // Description:
+  // Compute the initial edge costs on all threads (ParallelCosts) and four
+  // edges at a time with AVX2 when built with it (VectorizedCosts). Both on
+  // by default; turned off to benchmark the serial and scalar paths.
+  vtkSetMacro(ParallelCosts, int);
+  vtkGetMacro(ParallelCosts, int);
+  vtkBooleanMacro(ParallelCosts, int);
+  vtkSetMacro(VectorizedCosts, int);
+  vtkGetMacro(VectorizedCosts, int);
+  vtkBooleanMacro(VectorizedCosts, int);
+
+  // Description:
+  // Refuse edge collapses that fail the link condition, i.e. that would
+  // pinch the surface or flatten a thin tube into a fin. On by default.
+  vtkSetMacro(PreserveTopology, int);
+  vtkGetMacro(PreserveTopology, int);
+  vtkBooleanMacro(PreserveTopology, int);
+
+  // Description:
+  // Number of collapses refused by the link condition during the last
+  // execution.
+  vtkGetMacro(NumberOfTopologyRejections, int);
+
   // Description:
   // Decide whether to include data attributes in the error metric. If off,
   // then only geometric error is used to control the decimation. By default
@@ -125,6 +159,28 @@ public:
   // filter has executed.
   vtkGetMacro(ActualReduction, double);
 
+  // Description:
+  // Get the largest error of any collapse that was performed, as the root
+  // mean square distance of the collapse point to the planes of its merged
+  // quadric (area weighted, in the units of the input). Only valid after the
+  // filter has executed.
+  vtkGetMacro(MaximumError, double);
+
+  // Description:
+  // Get the number of edges collapsed by the last execution.
+  vtkGetMacro(NumberOfEdgeCollapses, int);
+
+  // Description:
+  // Wall clock seconds spent by the last execution computing the quadrics,
+  // the initial edge costs and collapsing edges.
+  vtkGetMacro(QuadricTime, double);
+  vtkGetMacro(CostTime, double);
+  vtkGetMacro(CollapseTime, double);
+
+  // Description:
+  // Edge collapses per second of the last execution.
+  vtkGetMacro(CollapseRate, double);
+
 protected:
   customQuadricDecimation();
   ~customQuadricDecimation();
@@ -159,6 +215,39 @@ protected:
   double ComputeCost(vtkIdType edgeId, double *x);
   double ComputeCost2(vtkIdType edgeId, double *x);
 
+  // Description:
+  // Cost and collapse point for the 10 geometric terms of a summed quadric
+  // and the end points of its edge. Thread safe.
+  static double EvaluateQuadric(const double *quad, const double *pt1,
+                                const double *pt2, double *x);
+
+  // Description:
+  // Compute the cost and target point of every edge (geometric error only),
+  // in parallel over ranges of edges, vectorized with AVX2 when available.
+  void ComputeInitialCosts(vtkIdType numEdges, double *costs, double *targets);
+
+  //BTX
+  struct CostRange
+  {
+    customQuadricDecimation *Filter;
+    vtkIdType Begin;
+    vtkIdType End;
+    double *Costs;
+    double *Targets;
+  };
+  //ETX
+  static void ComputeCostRange(CostRange &range);
+
+  // Description:
+  // Allocate (zeroed) and free the quadric buffer
+  void AllocateQuadrics(vtkIdType numPts);
+  void FreeQuadrics();
+
+  // Description:
+  // Component i of the quadric of a point
+  double &GetQuadric(vtkIdType ptId, int i)
+    {return this->Quadrics[i * this->QuadricStride + ptId];}
+
   // Description:
   // Find all edges that will have an endpoint change ids because of an edge
   // collapse.  p1Id and p2Id are the endpoints of the edge.  p2Id is the
@@ -175,8 +264,46 @@ protected:
   void ComputeNumberOfComponents(void);
   void UpdateEdgeData(vtkIdType ptoId, vtkIdType pt1Id);
 
+  // Description:
+  // Link condition for collapsing the edge: the points adjacent to both end
+  // points must be exactly the points opposite the edge.
   int IsGoodIdea(vtkIdType pt0Id, vtkIdType pt1Id);
 
+  // Description:
+  // True if either end point of the edge is locked (see LockedPoints)
+  int IsLockedEdge(vtkIdType edgeId);
+
+  // Description:
+  // Give the output the point data of the input points it kept (see
+  // OutputPointIds)
+  void CopyInputPointData(vtkPolyData *input, vtkPolyData *output);
+
+  // Description:
+  // Partitioned mode (see NumberOfPartitions)
+  void DecimatePartitioned(vtkPolyData *input, vtkPolyData *output);
+
+  //BTX
+  struct Partition
+  {
+    customQuadricDecimation *Parent;
+    vtkPolyData *Input;
+    // input point id of every partition point, and whether it is shared
+    // with another partition
+    std::vector<vtkIdType> PointIds;
+    std::vector<unsigned char> Locked;
+    // triangles in partition point ids
+    std::vector<vtkIdType> Triangles;
+    // decimated result, triangles in input point ids
+    std::vector<vtkIdType> OutputPointIds;
+    std::vector<double> OutputPoints;
+    std::vector<vtkIdType> OutputTriangles;
+    double MaximumError;
+    int NumberOfEdgeCollapses;
+    int NumberOfTopologyRejections;
+  };
+  //ETX
+  static void DecimatePartition(Partition &partition);
+
 
   // Description:
   // Helper function to set and get the point and it's attributes as an array
@@ -189,7 +316,17 @@ protected:
   void GetAttributeComponents();
 
   double TargetReduction;
+  int    NumberOfPartitions;
+  int    ParallelCosts;
+  int    VectorizedCosts;
+  int    PreserveTopology;
+  int    NumberOfTopologyRejections;
   double ActualReduction;
+  double MaximumError;
+  double QuadricTime;
+  double CostTime;
+  double CollapseTime;
+  double CollapseRate;
   int   AttributeErrorMetric;
 
   int ScalarsAttribute;
@@ -205,25 +342,29 @@ protected:
   double TensorsWeight;
 
   int               NumberOfEdgeCollapses;
-  vtkEdgeTable     *Edges;
-  vtkIdList        *EndPoint1List;
-  vtkIdList        *EndPoint2List;
-  vtkPriorityQueue *EdgeCosts;
+  EdgeTable        *Edges;
+  EdgeHeap         *EdgeCosts;
   vtkDoubleArray   *TargetPoints;
   int               NumberOfComponents;
   vtkPolyData      *Mesh;
 
-  //BTX
-  struct ErrorQuadric
-  {
-    double *Quadric;
-  };
-  //ETX
-
-  ErrorQuadric *ErrorQuadrics;
+  // Quadrics of all points in one aligned buffer, stored component major:
+  // component i of point p is Quadrics[i * QuadricStride + p]. QuadricStride
+  // is the number of points rounded up to a multiple of 4.
+  double       *QuadricBuffer;
+  double       *Quadrics;
+  vtkIdType     QuadricStride;
+  int           QuadricSize;
   int           AttributeComponents[6];
   double        AttributeScale[6];
 
+  // Points whose edges are never collapsed (NULL for none), set by the
+  // partitioned mode on the filters it runs
+  const unsigned char *LockedPoints;
+
+  // Input point id of every output point, filled by RequestData
+  std::vector<vtkIdType> OutputPointIds;
+
   // Temporary variables for performance
   vtkIdList *CollapseCellIds;
   double *TempX;
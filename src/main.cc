@@ -115,6 +115,25 @@ int main( int argc, char** argv )
         studio_app->export_dae( filename );
         return 0;
       }
+      else if ( arg == "-csv" )
+      {
+        QString filename = argv[argidx++];
+        studio_app->export_csv( filename );
+        return 0;
+      }
+      else if ( arg == "-benchmark" )
+      {
+        studio_app->benchmark_meshers();
+        studio_app->benchmark_decimation();
+        return 0;
+      }
+      else if ( arg == "-contacts" )
+      {
+        double distance = QString( argv[argidx++] ).toDouble();
+        QString filename = argv[argidx++];
+        studio_app->export_contacts( filename, distance );
+        return 0;
+      }
       else
       {
         std::cerr << "unrecognized option: " << arg.toStdString() << "\n";